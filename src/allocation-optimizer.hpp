@@ -0,0 +1,307 @@
+//  allocation-optimizer.hpp
+//
+//  Choose the allocation with the shortest links among the bases of the
+//  integer nullspace of the projection.
+//
+//  The rows of any basis U A, with U unimodular, are an equally valid
+//  allocation: the PEs are the same up to a relabelling, and so are the PE
+//  count and the change of basis determinant with the schedule (which is
+//  +-\lambda u for rank 1, so unimodular exactly when the utilization is 1).
+//  The links of dependency d are A d, so the rows of the link matrix A D
+//  are reduced with LLL (NTL), carrying the unimodular transform over to
+//  A.  The reduced basis is then improved by hill climbing over elementary
+//  row operations a_i +- a_j, by the largest link length and then the total
+//  (or by the total and then the largest).
+//
+//  The result is checked to still be a basis of the integer nullspace: its
+//  maximal minors have gcd 1, so it extends to a unimodular matrix.
+
+#ifndef __ALLOCATION_OPTIMIZER_H__
+#   define __ALLOCATION_OPTIMIZER_H__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <utility>
+using namespace std;
+
+#include <NTL/LLL.h>
+
+#include <boost/math/common_factor.hpp>
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+
+class AllocationOptimizer
+{
+
+ public:
+
+   // objectives
+   enum Objective {
+     NONE = 0,       // keep the integer kernel basis
+     MAX_LENGTH,     // longest link, then total length
+     TOTAL_LENGTH    // total length, then longest link
+   };
+
+   // constructor
+   AllocationOptimizer(unsigned int _dimensions, unsigned int _rank,
+                       PipMatrix *dependencies) :
+     dimensions (_dimensions),
+     rank (_rank),
+     deps (dependencies->NbRows, vector< long long >(_dimensions))
+   {
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         deps[k][j] = VALUE_TO_INT( dependencies->p[k][j] );
+       }
+     }
+   }
+
+   // destructor
+   ~AllocationOptimizer()
+   {
+   }
+
+   // objective of a name, or -1 if unknown
+   static int objectiveOf(const string &name)
+   {
+     if (name == "none")
+       return NONE;
+     if (name == "max")
+       return MAX_LENGTH;
+     if (name == "total")
+       return TOTAL_LENGTH;
+
+     return -1;
+   }
+
+   //
+   // replace the allocation of a solution by a basis with shorter links.
+   // throws DSEError if the result is not a basis of the integer
+   // nullspace.
+   //
+   void optimize(ProjectionSolution *ps, Objective objective)
+   {
+     unsigned int m = dimensions - rank;
+
+     if (objective == NONE || m == 0)
+       return;
+
+     vector< vector< long long > > A(m, vector< long long >(dimensions));
+     for (unsigned int i = 0; i < m; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         A[i][j] = ps->allocationElement(i, j);
+       }
+     }
+
+     reduce(A);
+     climb(A, objective);
+
+     if (minorsGCD(A) != 1) {
+       throw DSEError("Allocation is not a basis of the integer nullspace");
+     }
+
+     for (unsigned int i = 0; i < m; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         ps->allocationElement(i, j) = (int) A[i][j];
+       }
+     }
+   }
+
+ private:
+
+   // link lengths of an allocation row:  a d for every dependency
+   void links(const vector< long long > &a, vector< long long > &l)
+   {
+     l.resize(deps.size());
+
+     for (unsigned int k = 0; k < deps.size(); k++) {
+       l[k] = 0;
+       for (unsigned int j = 0; j < dimensions; j++) {
+         l[k] += a[j] * deps[k][j];
+       }
+     }
+   }
+
+   // cost of an allocation, compared lexicographically
+   pair< long long, long long > cost(const vector< vector< long long > > &A,
+                                     Objective objective)
+   {
+     long long longest = 0, total = 0;
+     vector< long long > l;
+
+     for (unsigned int i = 0; i < A.size(); i++) {
+       links(A[i], l);
+
+       for (unsigned int k = 0; k < l.size(); k++) {
+         longest = max(longest, llabs (l[k]));
+         total += llabs (l[k]);
+       }
+     }
+
+     return objective == MAX_LENGTH ? make_pair(longest, total)
+                                    : make_pair(total, longest);
+   }
+
+   //
+   // LLL reduction of the rows of the link matrix A D.  the transform
+   // found by NTL is unimodular and is applied to A.
+   //
+   void reduce(vector< vector< long long > > &A)
+   {
+     unsigned int m = A.size();
+
+     if (deps.empty())
+       return;
+
+     NTL::mat_ZZ B, U;
+     B.SetDims(m, deps.size());
+
+     vector< long long > l;
+     for (unsigned int i = 0; i < m; i++) {
+       links(A[i], l);
+       for (unsigned int k = 0; k < l.size(); k++) {
+         B[i][k] = NTL::to_ZZ((long) l[k]);
+       }
+     }
+
+     NTL::ZZ det2;
+     NTL::LLL(det2, B, U);
+
+     vector< vector< long long > > reduced(m,
+                                           vector< long long >(dimensions, 0));
+     for (unsigned int i = 0; i < m; i++) {
+       for (unsigned int r = 0; r < m; r++) {
+         long u = NTL::to_long(U[i][r]);
+
+         for (unsigned int j = 0; j < dimensions; j++) {
+           reduced[i][j] += u * A[r][j];
+         }
+       }
+     }
+
+     A = reduced;
+   }
+
+   //
+   // first improvement hill climbing over a_i += a_j and a_i -= a_j
+   //
+   void climb(vector< vector< long long > > &A, Objective objective)
+   {
+     unsigned int m = A.size();
+     pair< long long, long long > best = cost(A, objective);
+
+     for (unsigned int moves = 0; moves < 64 * m * m; moves++) {
+       bool improved = false;
+
+       for (unsigned int i = 0; i < m && !improved; i++) {
+         for (unsigned int j = 0; j < m && !improved; j++) {
+           if (i == j)
+             continue;
+
+           for (int s = -1; s <= 1 && !improved; s += 2) {
+             for (unsigned int c = 0; c < dimensions; c++) {
+               A[i][c] += s * A[j][c];
+             }
+
+             pair< long long, long long > trial = cost(A, objective);
+
+             if (trial < best) {
+               best = trial;
+               improved = true;
+             } else {
+               for (unsigned int c = 0; c < dimensions; c++) {
+                 A[i][c] -= s * A[j][c];
+               }
+             }
+           }
+         }
+       }
+
+       if (!improved)
+         break;
+     }
+   }
+
+   // gcd of the maximal minors of A
+   long long minorsGCD(const vector< vector< long long > > &A)
+   {
+     unsigned int m = A.size();
+     vector< unsigned int > columns(m);
+     for (unsigned int i = 0; i < m; i++) {
+       columns[i] = i;
+     }
+
+     long long g = 0;
+     for (;;) {
+       vector< vector< long long > > M(m, vector< long long >(m));
+       for (unsigned int i = 0; i < m; i++) {
+         for (unsigned int j = 0; j < m; j++) {
+           M[i][j] = A[i][columns[j]];
+         }
+       }
+
+       g = boost::math::gcd(g, llabs (determinant(M)));
+       if (g == 1)
+         return g;
+
+       // next combination of columns
+       int i = m - 1;
+       while (i >= 0 && columns[i] == dimensions - m + i) {
+         i--;
+       }
+       if (i < 0)
+         return g;
+
+       columns[i]++;
+       for (unsigned int j = i + 1; j < m; j++) {
+         columns[j] = columns[j - 1] + 1;
+       }
+     }
+   }
+
+   // determinant by fraction free elimination (Bareiss)
+   static long long determinant(vector< vector< long long > > M)
+   {
+     unsigned int m = M.size();
+     long long sign = 1, previous = 1;
+
+     for (unsigned int k = 0; k < m; k++) {
+       if (M[k][k] == 0) {
+         unsigned int p = k + 1;
+         while (p < m && M[p][k] == 0) {
+           p++;
+         }
+         if (p == m)
+           return 0;
+
+         swap(M[k], M[p]);
+         sign = -sign;
+       }
+
+       for (unsigned int i = k + 1; i < m; i++) {
+         for (unsigned int j = k + 1; j < m; j++) {
+           M[i][j] = (M[i][j] * M[k][k] - M[i][k] * M[k][j]) / previous;
+         }
+       }
+
+       previous = M[k][k];
+     }
+
+     return sign * M[m - 1][m - 1];
+   }
+
+   unsigned int dimensions;
+   unsigned int rank;
+
+   // dependencies
+   vector< vector< long long > > deps;
+
+};
+
+#endif // __ALLOCATION_OPTIMIZER_H__
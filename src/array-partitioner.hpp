@@ -0,0 +1,326 @@
+//  array-partitioner.hpp
+//
+//  Partition the virtual array of a solution onto a device with a fixed
+//  number of PEs.
+//
+//  The virtual array has P PEs at the parameter instance, each executing
+//  up to BPP points, and starts a problem instance every BPP cycles.  A
+//  device of B PEs runs it by:
+//
+//    LSGP  (locally sequential, globally parallel): tiles of c virtual PEs
+//          are each executed sequentially by one physical PE, starting a
+//          problem every c BPP cycles.  the registers of a tile are kept
+//          in the local memory of its PE.
+//    LPGS  (locally parallel, globally sequential): the array is cut into
+//          blocks of at most B virtual PEs, executed one after the other
+//          by the device, starting a problem every (blocks) BPP cycles.
+//          values on links between blocks are held outside the array.
+//
+//  A device larger than the folded array holds several copies of it
+//  working on independent problems; replicating the unfolded array is LSGP
+//  with tiles of one PE.  The throughput is copies / period, in problems
+//  per cycle.
+//
+//  Tiles and blocks are boxes in the PE coordinates (the rows of the
+//  allocation), whose extents are taken over the vertices of the instance
+//  domain.  Boxes are grown greedily from one PE, one side at a time, and
+//  the best partition met on the way is kept.  A virtual PE holds one
+//  register per cycle of delay on its links, the sum of delays.  The link
+//  of dependency d has vector l = A d and leaves a box of sides b from
+//  about min(1, sum_i |l_i| / b_i) of the PEs.
+
+#ifndef __ARRAY_PARTITIONER_H__
+#   define __ARRAY_PARTITIONER_H__
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+using namespace std;
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// local includes
+#include "projection-solution.hpp"
+
+class ArrayPartitioner
+{
+
+ public:
+
+   // constructor
+   //   dependencies - dependency vectors, one per row
+   //   vertices     - vertices of the domain at the parameter instance
+   //   _pes         - PEs of the device
+   ArrayPartitioner(unsigned int _dimensions, unsigned int _rank,
+                    PipMatrix *dependencies,
+                    const vector< vector< double > > &_vertices,
+                    unsigned int _pes) :
+     dimensions (_dimensions),
+     rank (_rank),
+     deps (dependencies->NbRows, vector< int >(_dimensions)),
+     vertices (_vertices),
+     pes (_pes)
+   {
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         deps[k][j] = VALUE_TO_INT( dependencies->p[k][j] );
+       }
+     }
+   }
+
+   // destructor
+   ~ArrayPartitioner()
+   {
+   }
+
+   // PEs of the device
+   unsigned int getPEs()
+   {
+     return pes;
+   }
+
+   //
+   // choose the partition of a solution with the highest throughput on the
+   // device; ties go to less local memory, then fewer links between
+   // partitions, then fewer copies.  failed candidates are not
+   // partitioned.
+   //
+   void partition(ProjectionSolution *ps)
+   {
+     if (ps->status != ProjectionSolution::OK)
+       return;
+
+     unsigned int m = dimensions - rank;
+
+     // extents of the virtual array and vectors of its links
+     vector< long > extent(m);
+     vector< vector< int > > links(deps.size(), vector< int >(m));
+
+     for (unsigned int i = 0; i < m; i++) {
+       double lo = 0, hi = 0;
+
+       for (unsigned int v = 0; v < vertices.size(); v++) {
+         double x = 0;
+         for (unsigned int j = 0; j < dimensions; j++) {
+           x += ps->allocationElement(i, j) * vertices[v][j];
+         }
+
+         if (v == 0 || x < lo) lo = x;
+         if (v == 0 || x > hi) hi = x;
+       }
+
+       extent[i] = (long) (floor (hi) - ceil (lo)) + 1;
+       if (extent[i] < 1)
+         extent[i] = 1;
+
+       for (unsigned int k = 0; k < deps.size(); k++) {
+         links[k][i] = 0;
+         for (unsigned int j = 0; j < dimensions; j++) {
+           links[k][i] += ps->allocationElement(i, j) * deps[k][j];
+         }
+       }
+     }
+
+     // the PE count is exact, boxes of the extents may hold empty PEs
+     unsigned long virtualpes = ps->instance_pe_count;
+     if (virtualpes == 0)
+       virtualpes = volume(extent);
+
+     unsigned long period = ps->instance_bpp + 1;
+
+     Partition best;
+
+     // LSGP, from tiles of one PE (replication)
+     vector< long > tile(m, 1);
+     for (;;) {
+       bool single = volume(tile) == 1;
+       unsigned long tiles = single ? virtualpes : boxes(extent, tile);
+
+       Partition p;
+       p.scheme   = single ? "replicate" : "lsgp " + sides(tile);
+       p.copies   = tiles <= pes ? pes / tiles : 0;
+       p.period   = period * volume(tile);
+       p.memory   = (unsigned long) ps->network_sum_delays * volume(tile);
+       p.crossing = crossing(links, tile, virtualpes);
+       consider(best, p);
+
+       if (!grow(extent, tile, 0))
+         break;
+     }
+
+     // LPGS, with blocks of at most the PEs of the device
+     vector< long > block(m, 1);
+     while (grow(extent, block, pes)) {
+       unsigned long passes = boxes(extent, block);
+
+       Partition p;
+       p.scheme   = "lpgs " + sides(block);
+       p.copies   = pes / volume(block);
+       p.period   = period * passes;
+       p.memory   = ps->network_sum_delays;
+       p.crossing = passes > 1 ? crossing(links, block, virtualpes) : 0;
+       consider(best, p);
+     }
+
+     ps->partition          = best.scheme;
+     ps->partition_copies   = best.copies;
+     ps->partition_period   = best.period;
+     ps->partition_memory   = best.memory;
+     ps->partition_crossing = best.crossing;
+   }
+
+ private:
+
+   // a way to run the virtual array on the device
+   struct Partition
+   {
+     string scheme;
+     unsigned int copies;
+     unsigned long period;
+     unsigned long memory;
+     unsigned long crossing;
+
+     Partition() :
+       copies (0), period (1), memory (0), crossing (0)
+     {
+     }
+   };
+
+   // keep p if it is better than best
+   void consider(Partition &best, const Partition &p)
+   {
+     if (p.copies == 0)
+       return;
+
+     // throughputs copies / period, compared without rounding
+     unsigned long long a = (unsigned long long) p.copies * best.period;
+     unsigned long long b = (unsigned long long) best.copies * p.period;
+
+     if (a != b) {
+       if (a > b)
+         best = p;
+       return;
+     }
+
+     if (p.memory != best.memory) {
+       if (p.memory < best.memory)
+         best = p;
+       return;
+     }
+
+     if (p.crossing != best.crossing) {
+       if (p.crossing < best.crossing)
+         best = p;
+       return;
+     }
+
+     // fewer, larger arrays have fewer problems in flight
+     if (p.copies < best.copies)
+       best = p;
+   }
+
+   //
+   // grow one side of a box by one PE: the side that leaves the fewest
+   // boxes in the extents, then the smallest box.  boxes hold at most
+   // limit PEs, unless limit is 0.  returns false if no side can grow.
+   //
+   bool grow(const vector< long > &extent, vector< long > &box,
+             unsigned long limit)
+   {
+     int side = -1;
+     unsigned long fewest = 0, smallest = 0;
+
+     for (unsigned int i = 0; i < box.size(); i++) {
+       if (box[i] >= extent[i])
+         continue;
+
+       box[i]++;
+
+       if (limit == 0 || volume(box) <= limit) {
+         unsigned long count = boxes(extent, box);
+         unsigned long size  = volume(box);
+
+         if (side < 0 || count < fewest ||
+               (count == fewest && size < smallest)) {
+           side = i;
+           fewest = count;
+           smallest = size;
+         }
+       }
+
+       box[i]--;
+     }
+
+     if (side < 0)
+       return false;
+
+     box[side]++;
+     return true;
+   }
+
+   // boxes covering the extents
+   unsigned long boxes(const vector< long > &extent, const vector< long > &box)
+   {
+     unsigned long count = 1;
+     for (unsigned int i = 0; i < box.size(); i++) {
+       count *= (extent[i] + box[i] - 1) / box[i];
+     }
+
+     return count;
+   }
+
+   // PEs of a box
+   unsigned long volume(const vector< long > &box)
+   {
+     unsigned long count = 1;
+     for (unsigned int i = 0; i < box.size(); i++) {
+       count *= box[i];
+     }
+
+     return count;
+   }
+
+   // links leaving boxes of the virtual array
+   unsigned long crossing(const vector< vector< int > > &links,
+                          const vector< long > &box, unsigned long virtualpes)
+   {
+     double count = 0;
+
+     for (unsigned int k = 0; k < links.size(); k++) {
+       double fraction = 0;
+       for (unsigned int i = 0; i < box.size(); i++) {
+         fraction += (double) abs (links[k][i]) / box[i];
+       }
+
+       count += virtualpes * (fraction < 1 ? fraction : 1);
+     }
+
+     return (unsigned long) (count + 0.5);
+   }
+
+   // sides of a box, as in 4x2
+   string sides(const vector< long > &box)
+   {
+     ostringstream str;
+
+     for (unsigned int i = 0; i < box.size(); i++) {
+       str << (i ? "x" : "") << box[i];
+     }
+
+     return str.str();
+   }
+
+   unsigned int dimensions;
+   unsigned int rank;
+
+   vector< vector< int > > deps;
+   vector< vector< double > > vertices;
+
+   unsigned int pes;
+
+};
+
+#endif // __ARRAY_PARTITIONER_H__
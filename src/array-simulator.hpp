@@ -0,0 +1,631 @@
+//  array-simulator.hpp
+//
+//  Cycle level simulation of the systolic array of a projection solution,
+//  for an instance of the parameters.
+//
+//  Every point x of the domain runs on PE A x at time \lambda x, where A is
+//  the allocation and \lambda the schedule.  The domain is scanned run by
+//  run (see DomainScanner): along a run the PE index and the time grow by
+//  constant increments, so no point is mapped from scratch.  The scan is
+//  done in passes that keep per PE tallies only:
+//
+//    1. points, first and last busy cycle of every PE
+//    2. conflicts (two points on one PE in one cycle) and the shortest
+//       interval between the points of a PE, from a bitmap of the busy
+//       cycles of each PE.  when the bitmaps do not fit in memory the
+//       cycles are taken in windows that fit, one scan per window; a run
+//       only visits its points within the window.
+//    3. for each dependency d, the instances (points x with x + d in the
+//       domain), their timing against the pipeline stages, and the use of
+//       the links between PEs
+//
+//  PE coordinates are bounded by the vertices of the instance domain, and
+//  tallies are held in dense arrays over that box.  Measured values are
+//  reported next to the analytical values of the solution.
+
+#ifndef __ARRAY_SIMULATOR_H__
+#   define __ARRAY_SIMULATOR_H__
+
+#include <climits>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// local includes
+#include "dse-error.hpp"
+#include "domain-scanner.hpp"
+#include "projection-solution.hpp"
+
+class ArraySimulator
+{
+
+ public:
+
+   // largest box of PE coordinates held in dense arrays
+   static const long long MAX_PE_CELLS = 1LL << 24;
+
+   // largest busy cycle bitmap of a window of cycles (bits).  a window of
+   // one cycle takes at most MAX_PE_CELLS bits, so every window fits.
+   static const long long MAX_BUSY_BITS = 1LL << 31;
+
+   // largest histogram of transfers per cycle
+   static const long long MAX_HISTOGRAM = 1LL << 26;
+
+   // constructor
+   // the scanner must scan the instance domain of the solution.  throws
+   // DSEError if the array is too large to simulate.
+   ArraySimulator(DomainScanner &_scanner, PipMatrix *_dependencies,
+                  ProjectionSolution *_ps, unsigned int _dimensions,
+                  int _pepipelinestages) :
+     scanner (_scanner),
+     dependencies (_dependencies),
+     ps (_ps),
+     dimensions (_dimensions),
+     pedimensions (_dimensions - _ps->rank),
+     pepipelinestages (_pepipelinestages),
+     points (0),
+     minT (LLONG_MAX),
+     maxT (LLONG_MIN),
+     conflictsChecked (false),
+     conflicts (0),
+     minStride (0)
+   {
+     //
+     // box of PE coordinates
+     //
+     cells = 1;
+     pelo.resize(pedimensions);
+     stride.resize(pedimensions);
+
+     for (int r = pedimensions - 1; r >= 0; r--) {
+       vector< long long > a(dimensions);
+       for (unsigned int j = 0; j < dimensions; j++) {
+         a[j] = ps->allocationElement(r, j);
+       }
+
+       long long lo, hi;
+       scanner.extremes(a, 0, lo, hi);
+
+       pelo[r] = lo;
+       stride[r] = cells;
+       cells *= hi - lo + 1;
+
+       if (cells > MAX_PE_CELLS) {
+         throw DSEError("Array is too large to simulate");
+       }
+     }
+
+     // change in PE index and time along a run
+     runIndexStep = 0;
+     for (unsigned int r = 0; r < pedimensions; r++) {
+       runIndexStep += ps->allocationElement(r, dimensions - 1) * stride[r];
+     }
+     runTimeStep = ps->schedule[dimensions - 1];
+   }
+
+   // destructor
+   ~ArraySimulator()
+   {
+   }
+
+   // run the simulation
+   void run()
+   {
+     countPoints();
+     checkConflicts();
+
+     for (unsigned int i = 0; i < dependencies->NbRows; i++) {
+       links.push_back(simulateDependency(i));
+     }
+   }
+
+   // print measured and analytical values
+   void report(ostream &os = cout)
+   {
+     unsigned long long active = 0;
+     unsigned int maxpoints = 0;
+     double minbusy = 1, maxbusy = 0, sumbusy = 0;
+
+     for (long long c = 0; c < cells; c++) {
+       if (count[c] == 0)
+         continue;
+
+       double busy = (double) count[c] / (peMaxT[c] - peMinT[c] + 1);
+
+       if (busy < minbusy) minbusy = busy;
+       if (busy > maxbusy) maxbusy = busy;
+       sumbusy += busy;
+
+       if (count[c] > maxpoints) maxpoints = count[c];
+       active++;
+     }
+
+     os << "Points: " << points << endl;
+     os << "Block pipelining period: " << (long long) maxpoints - 1
+        << " (analytical " << ps->instance_bpp << ")" << endl;
+     os << "PEs: " << active
+        << " (analytical " << ps->instance_pe_count << ")" << endl;
+     os << "Latency: " << (points ? maxT - minT : 0)
+        << " (analytical " << ps->latency << ")" << endl;
+
+     os << "Utilization: ";
+     if (conflictsChecked && minStride > 0)
+       os << minStride;
+     else
+       os << "-";
+     os << " (analytical " << ps->utilization << ")" << endl;
+
+     os << "Conflicts: ";
+     if (conflictsChecked)
+       os << conflicts << endl;
+     else
+       os << "not checked" << endl;
+
+     os << setprecision(4)
+        << "PE busy fraction: min " << minbusy
+        << ", avg " << (active ? sumbusy / active : 0.)
+        << ", max " << maxbusy << endl;
+
+     for (unsigned int i = 0; i < links.size(); i++) {
+       const Link &l = links[i];
+
+       os << "Dependency " << i << " [ ";
+       for (unsigned int j = 0; j < dimensions; j++) {
+         os << VALUE_TO_INT( dependencies->p[i][j] ) << " ";
+       }
+       os << "]: displacement [ ";
+       for (unsigned int r = 0; r < pedimensions; r++) {
+         os << l.displacement[r] << " ";
+       }
+       os << "], delay " << l.delay
+          << ", instances " << l.instances
+          << ", violations " << l.violations;
+
+       if (l.links > 0) {
+         os << ", links " << l.links
+            << ", occupancy "
+            << (double) l.instances / (l.links * (maxT - minT + 1));
+
+         if (l.peak >= 0)
+           os << ", peak transfers/cycle " << l.peak;
+       } else {
+         os << ", local";
+       }
+       os << endl;
+     }
+   }
+
+   // number of timing violations over all dependencies
+   unsigned long long violations()
+   {
+     unsigned long long v = 0;
+
+     for (unsigned int i = 0; i < links.size(); i++) {
+       v += links[i].violations;
+     }
+
+     return v;
+   }
+
+   // number of conflicts found, 0 if not checked
+   unsigned long long conflictCount()
+   {
+     return conflicts;
+   }
+
+ private:
+
+   // one dependency mapped onto the array
+   struct Link
+   {
+     vector< long long > displacement;
+     long long delay;
+     unsigned long long instances;
+     unsigned long long violations;
+     unsigned long long links;
+     long long peak;
+   };
+
+   // PE index and time of the first point of a run
+   void runStart(const vector< long long > &x, long long lo,
+                 long long &index, long long &time)
+   {
+     index = 0;
+     for (unsigned int r = 0; r < pedimensions; r++) {
+       long long p = ps->allocationElement(r, dimensions - 1) * lo;
+       for (unsigned int j = 0; j + 1 < dimensions; j++) {
+         p += ps->allocationElement(r, j) * x[j];
+       }
+
+       index += (p - pelo[r]) * stride[r];
+     }
+
+     time = ps->schedule[dimensions - 1] * lo;
+     for (unsigned int j = 0; j + 1 < dimensions; j++) {
+       time += ps->schedule[j] * x[j];
+     }
+   }
+
+   //
+   // pass 1: points, first and last busy cycle of every PE
+   //
+   struct CountVisitor
+   {
+     ArraySimulator &sim;
+
+     CountVisitor(ArraySimulator &_sim) : sim (_sim) { }
+
+     void operator()(const vector< long long > &x, long long lo, long long hi)
+     {
+       long long index, time;
+       sim.runStart(x, lo, index, time);
+
+       unsigned int *count = &sim.count[0];
+       long long *peMinT = &sim.peMinT[0];
+       long long *peMaxT = &sim.peMaxT[0];
+
+       // times of the run lie between its first and last point
+       long long first = time;
+       long long last = time + (hi - lo) * sim.runTimeStep;
+
+       sim.minT = min(sim.minT, min(first, last));
+       sim.maxT = max(sim.maxT, max(first, last));
+
+       for (long long j = lo; j <= hi; j++) {
+         count[index]++;
+         if (time < peMinT[index]) peMinT[index] = time;
+         if (time > peMaxT[index]) peMaxT[index] = time;
+
+         index += sim.runIndexStep;
+         time  += sim.runTimeStep;
+       }
+
+       sim.points += hi - lo + 1;
+     }
+   };
+
+   void countPoints()
+   {
+     count.assign(cells, 0);
+     peMinT.assign(cells, LLONG_MAX);
+     peMaxT.assign(cells, LLONG_MIN);
+
+     CountVisitor visitor(*this);
+     scanner.scan(visitor);
+   }
+
+   //
+   // pass 2: conflicts and shortest interval between the points of a PE,
+   // over the cycles [from, to].  the bit of cycle t of PE c is
+   // offset[c] + t.
+   //
+   struct BusyVisitor
+   {
+     ArraySimulator &sim;
+     long long from;
+     long long to;
+
+     BusyVisitor(ArraySimulator &_sim, long long _from, long long _to) :
+       sim (_sim), from (_from), to (_to) { }
+
+     void operator()(const vector< long long > &x, long long lo, long long hi)
+     {
+       long long index, time;
+       sim.runStart(x, lo, index, time);
+
+       // points k of the run, at time + k * step, within the window
+       long long step = sim.runTimeStep;
+       long long kmin = 0, kmax = hi - lo;
+
+       if (step == 0) {
+         if (time < from || time > to)
+           return;
+       } else if (step > 0) {
+         kmin = max(kmin, ceilDiv(from - time, step));
+         kmax = min(kmax, floorDiv(to - time, step));
+       } else {
+         kmin = max(kmin, ceilDiv(to - time, step));
+         kmax = min(kmax, floorDiv(from - time, step));
+       }
+
+       index += kmin * sim.runIndexStep;
+       time  += kmin * step;
+
+       unsigned long long *busy = &sim.busy[0];
+
+       for (long long k = kmin; k <= kmax; k++) {
+         long long bit = sim.offset[index] + time;
+         unsigned long long mask = 1ULL << (bit & 63);
+
+         if (busy[bit >> 6] & mask)
+           sim.conflicts++;
+         busy[bit >> 6] |= mask;
+
+         index += sim.runIndexStep;
+         time  += step;
+       }
+     }
+   };
+
+   static long long floorDiv(long long a, long long b)
+   {
+     long long q = a / b;
+     if (a % b != 0 && (a < 0) != (b < 0))
+       q--;
+     return q;
+   }
+
+   static long long ceilDiv(long long a, long long b)
+   {
+     return - floorDiv(- a, b);
+   }
+
+   // busy cycles of a PE within the window [from, to]
+   long long windowCycles(long long c, long long from, long long to)
+   {
+     if (count[c] == 0)
+       return 0;
+
+     long long first = max(from, peMinT[c]);
+     long long last = min(to, peMaxT[c]);
+
+     return first <= last ? last - first + 1 : 0;
+   }
+
+   // bits of the busy cycle bitmaps of the window [from, to]
+   long long windowBits(long long from, long long to)
+   {
+     long long bits = 0;
+     for (long long c = 0; c < cells; c++) {
+       bits += windowCycles(c, from, to);
+     }
+
+     return bits;
+   }
+
+   // last cycle of the largest window starting at from that fits
+   long long windowEnd(long long from)
+   {
+     if (windowBits(from, maxT) <= MAX_BUSY_BITS)
+       return maxT;
+
+     // windowBits(from, lo) fits, windowBits(from, hi) does not
+     long long lo = from, hi = maxT;
+     while (hi - lo > 1) {
+       long long mid = lo + (hi - lo) / 2;
+
+       if (windowBits(from, mid) <= MAX_BUSY_BITS)
+         lo = mid;
+       else
+         hi = mid;
+     }
+
+     return lo;
+   }
+
+   void checkConflicts()
+   {
+     minStride = 0;
+
+     // last busy cycle of every PE, carried from window to window
+     vector< long long > previous(cells, LLONG_MIN);
+
+     for (long long from = minT; points > 0 && from <= maxT; ) {
+       long long to = windowEnd(from);
+
+       // bit offset of the busy cycles of every PE
+       long long bits = 0;
+
+       offset.assign(cells, 0);
+       for (long long c = 0; c < cells; c++) {
+         offset[c] = bits - max(from, peMinT[c]);
+         bits += windowCycles(c, from, to);
+       }
+
+       busy.assign((bits + 63) / 64, 0);
+
+       BusyVisitor visitor(*this, from, to);
+       scanner.scan(visitor);
+
+       // shortest interval between consecutive busy cycles of a PE
+       for (long long c = 0; c < cells; c++) {
+         long long cycles = windowCycles(c, from, to);
+         if (cycles == 0)
+           continue;
+
+         long long first = offset[c] + max(from, peMinT[c]);
+         long long last = first + cycles - 1;
+
+         for (long long b = first; b <= last; ) {
+           unsigned long long word = busy[b >> 6] >> (b & 63);
+
+           if (word == 0) {
+             b = (b | 63) + 1;
+             continue;
+           }
+
+           b += __builtin_ctzll (word);
+           if (b > last)
+             break;
+
+           long long t = b - offset[c];
+           if (previous[c] != LLONG_MIN &&
+                 (minStride == 0 || t - previous[c] < minStride))
+             minStride = t - previous[c];
+
+           previous[c] = t;
+           b++;
+         }
+       }
+
+       from = to + 1;
+     }
+
+     conflictsChecked = true;
+     busy.clear();
+     offset.clear();
+   }
+
+   //
+   // pass 3: instances of a dependency.  the value used by point x is
+   // produced by point x + d on PE A (x + d), -\lambda d cycles earlier.
+   //
+   struct DependencyVisitor
+   {
+     ArraySimulator &sim;
+     const vector< long long > &d;
+     long long sourceStep;
+     Link &link;
+     vector< unsigned char > &used;
+     vector< unsigned int > &histogram;
+
+     DependencyVisitor(ArraySimulator &_sim, const vector< long long > &_d,
+                       long long _sourceStep, Link &_link,
+                       vector< unsigned char > &_used,
+                       vector< unsigned int > &_histogram) :
+       sim (_sim), d (_d), sourceStep (_sourceStep), link (_link),
+       used (_used), histogram (_histogram)
+     { }
+
+     void operator()(const vector< long long > &x, long long lo, long long hi)
+     {
+       unsigned int n = sim.dimensions;
+
+       // run of the producers
+       vector< long long > y(x);
+       for (unsigned int j = 0; j + 1 < n; j++) {
+         y[j] += d[j];
+       }
+
+       long long ylo, yhi;
+       if (!sim.scanner.innerRange(y, ylo, yhi))
+         return;
+
+       long long first = max(lo, ylo - d[n - 1]);
+       long long last  = min(hi, yhi - d[n - 1]);
+       if (first > last)
+         return;
+
+       link.instances += last - first + 1;
+
+       // values that stay on their PE use no link
+       if (sourceStep == 0)
+         return;
+
+       long long index, time;
+       sim.runStart(x, first, index, time);
+
+       for (long long j = first; j <= last; j++) {
+         used[index + sourceStep] = 1;
+         if (!histogram.empty())
+           histogram[time - sim.minT]++;
+
+         index += sim.runIndexStep;
+         time  += sim.runTimeStep;
+       }
+     }
+   };
+
+   Link simulateDependency(unsigned int i)
+   {
+     Link link;
+     vector< long long > d(dimensions);
+
+     link.delay = 0;
+     for (unsigned int j = 0; j < dimensions; j++) {
+       d[j] = VALUE_TO_INT( dependencies->p[i][j] );
+       link.delay -= ps->schedule[j] * d[j];
+     }
+
+     // PE index offset from consumer to producer
+     long long sourceStep = 0;
+     link.displacement.resize(pedimensions);
+     for (unsigned int r = 0; r < pedimensions; r++) {
+       link.displacement[r] = 0;
+       for (unsigned int j = 0; j < dimensions; j++) {
+         link.displacement[r] -= ps->allocationElement(r, j) * d[j];
+       }
+       sourceStep -= link.displacement[r] * stride[r];
+     }
+
+     link.instances = 0;
+     link.links = 0;
+     link.peak = -1;
+
+     vector< unsigned char > used;
+     vector< unsigned int > histogram;
+     if (sourceStep != 0) {
+       used.assign(cells, 0);
+       if (points > 0 && maxT - minT + 1 <= MAX_HISTOGRAM)
+         histogram.assign(maxT - minT + 1, 0);
+     }
+
+     DependencyVisitor visitor(*this, d, sourceStep, link, used, histogram);
+     scanner.scan(visitor);
+
+     // every instance arrives too early if the delay is below the pipeline
+     // depth
+     link.violations = link.delay < pepipelinestages ? link.instances : 0;
+
+     for (long long c = 0; c < (long long) used.size(); c++) {
+       link.links += used[c];
+     }
+
+     if (!histogram.empty()) {
+       link.peak = 0;
+       for (unsigned int t = 0; t < histogram.size(); t++) {
+         if ((long long) histogram[t] > link.peak)
+           link.peak = histogram[t];
+       }
+     }
+
+     return link;
+   }
+
+   DomainScanner &scanner;
+   PipMatrix *dependencies;
+   ProjectionSolution *ps;
+
+   unsigned int dimensions;
+   unsigned int pedimensions;
+   int pepipelinestages;
+
+   // box of PE coordinates: lower corner and index strides
+   vector< long long > pelo;
+   vector< long long > stride;
+   long long cells;
+
+   // change in PE index and time between consecutive points of a run
+   long long runIndexStep;
+   long long runTimeStep;
+
+   // per PE tallies
+   vector< unsigned int > count;
+   vector< long long > peMinT;
+   vector< long long > peMaxT;
+
+   // busy cycle bitmaps of a window, and the bit offset of every PE
+   vector< unsigned long long > busy;
+   vector< long long > offset;
+
+   unsigned long long points;
+   long long minT;
+   long long maxT;
+
+   bool conflictsChecked;
+   unsigned long long conflicts;
+   long long minStride;
+
+   vector< Link > links;
+
+   // the simulator refers to the scanner and solution, do not copy
+   ArraySimulator(const ArraySimulator &);
+   ArraySimulator &operator=(const ArraySimulator &);
+
+};
+
+#endif // __ARRAY_SIMULATOR_H__
@@ -0,0 +1,444 @@
+//  candidate-stages.hpp
+//
+//  Graph of the stages of evaluating a candidate, run by the worker pool on
+//  separate PIP and barvinok workers.
+//
+//  The stages of a candidate are
+//    THROUGHPUT - throughput ILPs (PIP)
+//    SCHEDULE   - schedule ILP of one orientation of the projection (PIP),
+//                 one task for each combination of signs of the directions
+//    COUNT      - allocation, networks and PE count (barvinok)
+//  The throughput and schedule ILPs of rank 1 are independent and run
+//  concurrently.  The schedule ILPs of rank k > 1 bound the strides of the
+//  directions by their extents, so they wait for the throughput.  COUNT
+//  uses the schedule of the first orientation in Gray code order that has
+//  one, as ProjectionSolver::evaluate() does, and the tasks of the other
+//  orientations are dropped.
+//
+//  Partial solutions are kept as text saved by ProjectionSolution::save()
+//  and passed to the tasks that need them.  COUNT tasks are queued up to a
+//  bound, and no new candidate is accepted while PIP tasks wait or the
+//  COUNT queue is full, so the PIP stages do not run ahead of the barvinok
+//  workers.
+
+#ifndef __CANDIDATE_STAGES_H__
+#   define __CANDIDATE_STAGES_H__
+
+#include <map>
+#include <list>
+#include <deque>
+#include <string>
+#include <vector>
+#include <sstream>
+using namespace std;
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "projection-solution.hpp"
+#include "projection-solver.hpp"
+
+class CandidateStages
+{
+
+ public:
+
+   // stages.  EVALUATE is a whole candidate, run by workers outside of the
+   // graph
+   enum Stage {
+     EVALUATE = 0,
+     THROUGHPUT,
+     SCHEDULE,
+     COUNT
+   };
+
+   // task handed to a worker
+   struct Task
+   {
+     unsigned long id;
+     unsigned int problem;
+     Stage stage;
+
+     // projection vector, with the orientation of a SCHEDULE task
+     vector< int > index;
+
+     // saved partial solutions the task starts from, or empty
+     string payload;
+   };
+
+   // a candidate that has finished, with the total time of its tasks
+   struct Finished
+   {
+     unsigned int problem;
+     unsigned long ordinal;
+     double seconds;
+   };
+
+   // constructor
+   //   solvers    - solver of each problem
+   //   countbound - number of COUNT tasks that may wait for a worker
+   CandidateStages(const vector< ProjectionSolver * > &_solvers,
+                   unsigned int _countbound) :
+     solvers (_solvers),
+     countbound (_countbound),
+     serial (0)
+   {
+   }
+
+   // destructor
+   ~CandidateStages()
+   {
+   }
+
+   // can a new candidate be accepted?
+   bool accepting()
+   {
+     return pipqueue.empty() && countqueue.size() < countbound;
+   }
+
+   // is any candidate unfinished?
+   bool busy()
+   {
+     return !candidates.empty();
+   }
+
+   // add a candidate of a problem
+   void add(unsigned int problem, ublas::vector<int> *pv,
+            unsigned long ordinal)
+   {
+     unsigned long key = serial++;
+     unsigned int rank = solvers[problem]->getRank();
+
+     Candidate &c = candidates[key];
+     c.problem  = problem;
+     c.ordinal  = ordinal;
+     c.seconds  = 0;
+     c.counting = false;
+     c.orientations.assign(1u << rank, PENDING);
+     c.schedules.assign(1u << rank, string());
+     c.failures.assign(1u << rank, ProjectionSolution::OK);
+
+     c.index.resize(pv->size());
+     for (unsigned int i = 0; i < pv->size(); i++) {
+       c.index[i] = (*pv)(i);
+     }
+
+     enqueue(key, THROUGHPUT, 0, c.index, string());
+
+     if (rank == 1) {
+       enqueueSchedules(key);
+     }
+   }
+
+   // next task for a PIP worker, or for a barvinok worker if counting.
+   // returns false if there is none.
+   bool next(bool counting, Task &task)
+   {
+     deque< unsigned long > &queue = counting ? countqueue : pipqueue;
+
+     while (!queue.empty()) {
+       unsigned long id = queue.front();
+       queue.pop_front();
+
+       // tasks of finished candidates and dropped orientations are gone
+       map< unsigned long, Pending >::iterator t = tasks.find(id);
+       if (t == tasks.end())
+         continue;
+
+       task = t->second.task;
+       return true;
+     }
+
+     return false;
+   }
+
+   //
+   // a task has finished.  saved is the solution of the task, or empty if
+   // an orientation has no schedule.  the solutions of a finished candidate
+   // (with its schedule variants) are appended to the results of its
+   // problem.  returns true if the candidate has finished.
+   //
+   bool finished(unsigned long id, const string &saved, double seconds,
+                 vector< list<ProjectionSolution *> > &results,
+                 Finished &done)
+   {
+     map< unsigned long, Pending >::iterator t = tasks.find(id);
+
+     // dropped task
+     if (t == tasks.end())
+       return false;
+
+     unsigned long key = t->second.candidate;
+     Stage stage = t->second.task.stage;
+     unsigned int attempt = t->second.attempt;
+     tasks.erase(t);
+
+     Candidate &c = candidates[key];
+     c.seconds += seconds;
+
+     switch (stage) {
+       case THROUGHPUT:
+         c.throughput = saved;
+
+         if (solvers[c.problem]->getRank() > 1) {
+           enqueueSchedules(key);
+         }
+         break;
+
+       case SCHEDULE:
+         c.orientations[attempt] = saved.empty() ? NONE : FOUND;
+         c.schedules[attempt] = saved;
+         break;
+
+       case COUNT:
+         {
+           // the solution, then its schedule variants
+           istringstream is(saved);
+
+           do {
+             ProjectionSolution *ps = solvers[c.problem]->newSolution();
+
+             if (!ps->load(is)) {
+               delete ps;
+               throw DSEError("Malformed result from worker process");
+             }
+
+             ps->candidate = c.ordinal;
+             results[c.problem].push_back(ps);
+
+             is >> ws;
+           } while (!is.eof());
+
+           complete(key, done);
+           return true;
+         }
+
+       default:
+         break;
+     }
+
+     return decide(key, results, done);
+   }
+
+   //
+   // a task has failed: its worker timed out, ran out of memory or died.
+   // returns true if the candidate has failed.
+   //
+   bool failed(unsigned long id, ProjectionSolution::Status status,
+               double seconds, vector< list<ProjectionSolution *> > &results,
+               Finished &done)
+   {
+     map< unsigned long, Pending >::iterator t = tasks.find(id);
+
+     if (t == tasks.end())
+       return false;
+
+     unsigned long key = t->second.candidate;
+     Stage stage = t->second.task.stage;
+     unsigned int attempt = t->second.attempt;
+     tasks.erase(t);
+
+     Candidate &c = candidates[key];
+     c.seconds += seconds;
+
+     // an orientation fails the candidate only if no earlier orientation
+     // has a schedule
+     if (stage == SCHEDULE) {
+       c.orientations[attempt] = FAILED;
+       c.failures[attempt] = status;
+
+       return decide(key, results, done);
+     }
+
+     fail(key, status, results, done);
+     return true;
+   }
+
+ private:
+
+   // schedule of an orientation
+   enum Orientation {
+     PENDING,
+     NONE,
+     FOUND,
+     FAILED
+   };
+
+   struct Candidate
+   {
+     unsigned int problem;
+     unsigned long ordinal;
+     vector< int > index;
+
+     // saved throughput, and schedule of each orientation
+     string throughput;
+     vector< Orientation > orientations;
+     vector< string > schedules;
+     vector< ProjectionSolution::Status > failures;
+
+     // COUNT task queued
+     bool counting;
+
+     // total time of the finished tasks
+     double seconds;
+   };
+
+   struct Pending
+   {
+     Task task;
+     unsigned long candidate;
+     unsigned int attempt;
+   };
+
+   // queue a task of a candidate
+   void enqueue(unsigned long key, Stage stage, unsigned int attempt,
+                const vector< int > &index, const string &payload)
+   {
+     unsigned long id = serial++;
+
+     Pending &p = tasks[id];
+     p.task.id      = id;
+     p.task.problem = candidates[key].problem;
+     p.task.stage   = stage;
+     p.task.index   = index;
+     p.task.payload = payload;
+     p.candidate    = key;
+     p.attempt      = attempt;
+
+     (stage == COUNT ? countqueue : pipqueue).push_back(id);
+   }
+
+   //
+   // queue the schedule ILP of every orientation.  the orientation of
+   // attempt a negates the directions of the bits of the Gray code
+   // a ^ (a >> 1), the signs findSchedule() reaches after a attempts.
+   //
+   void enqueueSchedules(unsigned long key)
+   {
+     Candidate &c = candidates[key];
+     unsigned int rank = solvers[c.problem]->getRank();
+     unsigned int dimensions = c.index.size() / rank;
+
+     for (unsigned int attempt = 0; attempt < c.orientations.size();
+          attempt++) {
+       unsigned int signs = attempt ^ (attempt >> 1);
+       vector< int > index = c.index;
+
+       for (unsigned int dir = 0; dir < rank; dir++) {
+         if (signs & (1u << dir)) {
+           for (unsigned int i = 0; i < dimensions; i++) {
+             index[dir * dimensions + i] = -index[dir * dimensions + i];
+           }
+         }
+       }
+
+       enqueue(key, SCHEDULE, attempt, index, c.throughput);
+     }
+   }
+
+   //
+   // once the throughput and the orientations up to the first with a
+   // schedule are known, queue the COUNT task with both.  returns true if
+   // the candidate has failed.
+   //
+   bool decide(unsigned long key, vector< list<ProjectionSolution *> > &results,
+               Finished &done)
+   {
+     Candidate &c = candidates[key];
+
+     if (c.counting)
+       return false;
+
+     for (unsigned int a = 0; a < c.orientations.size(); a++) {
+       switch (c.orientations[a]) {
+         case PENDING:
+           return false;
+
+         case NONE:
+           break;
+
+         case FAILED:
+           fail(key, c.failures[a], results, done);
+           return true;
+
+         case FOUND:
+           if (c.throughput.empty())
+             return false;
+
+           drop(key);
+           c.counting = true;
+           enqueue(key, COUNT, 0, c.index, c.throughput + c.schedules[a]);
+           return false;
+       }
+     }
+
+     // no orientation has a schedule.  the worker evaluating the whole
+     // candidate exits with an error
+     fail(key, ProjectionSolution::ERROR, results, done);
+     return true;
+   }
+
+   // drop the unfinished tasks of a candidate
+   void drop(unsigned long key)
+   {
+     map< unsigned long, Pending >::iterator t = tasks.begin();
+
+     while (t != tasks.end()) {
+       if (t->second.candidate == key)
+         tasks.erase(t++);
+       else
+         t++;
+     }
+   }
+
+   // record a candidate as failed
+   void fail(unsigned long key, ProjectionSolution::Status status,
+             vector< list<ProjectionSolution *> > &results, Finished &done)
+   {
+     Candidate &c = candidates[key];
+
+     ProjectionSolution *ps = solvers[c.problem]->newSolution();
+     ps->candidate = c.ordinal;
+     ps->status    = status;
+     for (unsigned int j = 0; j < c.index.size(); j++) {
+       ps->projection_vector[j] = c.index[j];
+     }
+     results[c.problem].push_back(ps);
+
+     complete(key, done);
+   }
+
+   // forget a finished candidate
+   void complete(unsigned long key, Finished &done)
+   {
+     Candidate &c = candidates[key];
+
+     done.problem = c.problem;
+     done.ordinal = c.ordinal;
+     done.seconds = c.seconds;
+
+     drop(key);
+     candidates.erase(key);
+   }
+
+   // solver of each problem
+   vector< ProjectionSolver * > solvers;
+
+   // bound on the COUNT queue
+   unsigned int countbound;
+
+   // unfinished candidates and their tasks, by key
+   map< unsigned long, Candidate > candidates;
+   map< unsigned long, Pending > tasks;
+
+   // tasks waiting for a PIP worker and for a barvinok worker
+   deque< unsigned long > pipqueue;
+   deque< unsigned long > countqueue;
+
+   // next key of a candidate or task
+   unsigned long serial;
+
+};
+
+#endif // __CANDIDATE_STAGES_H__
@@ -0,0 +1,236 @@
+//  checkpoint.hpp
+//
+//  Checkpoint and resume long enumeration runs.
+//
+//  A checkpoint records the position of the projection vector enumeration,
+//  the set of finished candidates and all solutions found so far.  Every
+//  position of the enumeration is identified by its ordinal; the finished
+//  set is kept as a low water mark (all ordinals below it are finished) plus
+//  the ordinals above it that finished out of order.  Resuming restarts the
+//  enumeration at the low water mark and skips ordinals already finished.
+
+#ifndef __CHECKPOINT_H__
+#   define __CHECKPOINT_H__
+
+#include <cstdio>
+#include <ctime>
+#include <set>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+using namespace std;
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+#include "solutions.hpp"
+#include "projection-solver.hpp"
+
+class Checkpoint
+{
+
+ public:
+
+   // constructor
+   //   checkpointfile - file the checkpoint is written to and resumed from
+   //   interval       - seconds between checkpoints
+   //   signature      - description of the run (polyhedron and options);
+   //                    a checkpoint can only be resumed by the same run
+   Checkpoint(string _checkpointfile, int _interval, string _signature) :
+     checkpointfile (_checkpointfile),
+     interval (_interval),
+     signature (_signature),
+     lowwater (0),
+     candidates (0),
+     lastcheckpoint (time(NULL))
+   {
+   }
+
+   // destructor
+   ~Checkpoint()
+   {
+   }
+
+   // has the candidate at this position of the enumeration finished?
+   bool isFinished(unsigned long ordinal)
+   {
+     return ordinal < lowwater || finished.count(ordinal) > 0;
+   }
+
+   // mark the candidate at this position of the enumeration as finished.
+   // positions that are not candidates (zero vectors, gcd != 1, over bound)
+   // must be marked as well so that the low water mark can advance.
+   void markFinished(unsigned long ordinal)
+   {
+     if (ordinal < lowwater)
+       return;
+
+     finished.insert(ordinal);
+
+     // advance low water mark over contiguous finished positions
+     while (!finished.empty() && *finished.begin() == lowwater) {
+       finished.erase(finished.begin());
+       lowwater++;
+     }
+   }
+
+   // mark the positions [first, last) as finished
+   void markFinished(unsigned long first, unsigned long last)
+   {
+     if (first > lowwater) {
+       for (unsigned long ordinal = first; ordinal < last; ordinal++) {
+         finished.insert(ordinal);
+       }
+       return;
+     }
+
+     if (last <= lowwater)
+       return;
+
+     lowwater = last;
+
+     // advance low water mark over contiguous finished positions
+     while (!finished.empty() && *finished.begin() <= lowwater) {
+       if (*finished.begin() == lowwater)
+         lowwater++;
+       finished.erase(finished.begin());
+     }
+   }
+
+   // first position of the enumeration that has not finished
+   unsigned long lowWaterMark()
+   {
+     return lowwater;
+   }
+
+   // write a checkpoint if the checkpoint interval has elapsed
+   void update(int _candidates, Solutions &projsols)
+   {
+     if (time(NULL) - lastcheckpoint < interval)
+       return;
+
+     save(_candidates, projsols);
+   }
+
+   // write a checkpoint
+   void save(int _candidates, Solutions &projsols)
+   {
+     lastcheckpoint = time(NULL);
+     candidates     = _candidates;
+
+     // write to a temporary file and rename it, so that a crash while
+     // writing leaves the previous checkpoint intact
+     string tmpfile = checkpointfile + ".tmp";
+     ofstream out(tmpfile.c_str(), ios::out | ios::trunc);
+
+     if (!out) {
+       cerr << "Failed to open " << tmpfile << endl;
+       return;
+     }
+
+     out << "enumerate-checkpoint 5" << endl;
+     out << signature << endl;
+     out << lowwater << " " << candidates << endl;
+
+     out << finished.size();
+     for (std::set<unsigned long>::iterator i = finished.begin();
+          i != finished.end(); i++) {
+       out << " " << *i;
+     }
+     out << endl;
+
+     // solutions in list order, so that ties sort identically on resume
+     out << projsols.size() << endl;
+     for (Solutions::iterator i = projsols.begin(); i != projsols.end(); i++) {
+       (*i)->save(out);
+     }
+
+     out.close();
+
+     if (!out || rename (tmpfile.c_str(), checkpointfile.c_str()) != 0) {
+       cerr << "Failed to write checkpoint " << checkpointfile << endl;
+     }
+   }
+
+   // load a checkpoint.  solutions are appended to projsols.  returns the
+   // number of candidates explored before the checkpoint.  throws DSEError
+   // if the checkpoint cannot be resumed.
+   int load(ProjectionSolver &solver, Solutions &projsols)
+   {
+     ifstream in(checkpointfile.c_str());
+
+     if (!in) {
+       throw DSEError("Failed to open checkpoint " + checkpointfile);
+     }
+
+     string line;
+     getline(in, line);
+     if (line.compare(0, 21, "enumerate-checkpoint ") != 0) {
+       throw DSEError("Not a checkpoint file: " + checkpointfile);
+     }
+
+     // solutions saved in another layout cannot be read back
+     if (line != "enumerate-checkpoint 5") {
+       throw DSEError("Checkpoint was written by an incompatible version: "
+                      + checkpointfile);
+     }
+
+     getline(in, line);
+     if (line != signature) {
+       throw DSEError("Checkpoint was written by a run with different options: "
+                      + line);
+     }
+
+     in >> lowwater >> candidates;
+
+     unsigned long nfinished, ordinal;
+     in >> nfinished;
+     finished.clear();
+     for (unsigned long i = 0; i < nfinished; i++) {
+       in >> ordinal;
+       finished.insert(ordinal);
+     }
+
+     unsigned long nsolutions;
+     in >> nsolutions;
+     for (unsigned long i = 0; i < nsolutions; i++) {
+       ProjectionSolution *ps = solver.newSolution();
+
+       if (!ps->load(in)) {
+         delete ps;
+         throw DSEError("Checkpoint is corrupt: " + checkpointfile);
+       }
+
+       projsols.push_back(ps);
+     }
+
+     if (!in) {
+       throw DSEError("Checkpoint is corrupt: " + checkpointfile);
+     }
+
+     return candidates;
+   }
+
+private:
+
+   // checkpoint file and seconds between checkpoints
+   string checkpointfile;
+   int interval;
+
+   // identifies the run that wrote the checkpoint
+   string signature;
+
+   // every position below the low water mark has finished, plus the
+   // positions in the finished set
+   unsigned long lowwater;
+   std::set<unsigned long> finished;
+
+   // number of candidates explored
+   int candidates;
+
+   time_t lastcheckpoint;
+
+};
+
+#endif // __CHECKPOINT_H__
@@ -14,17 +14,147 @@
 namespace po = boost::program_options;
 
 #include <string>
+#include <sstream>
+#include <vector>
 #include <iterator>
 using namespace std;
 
+// local includes
+#include "dse-error.hpp"
+
 class CommandLineOptions
 {
 
  public:
 
-   // constructor
+   // constructor, program command line.  prints usage or errors and exits
    CommandLineOptions(int argc, char **argv)
    {
+     try {
+       parse(vector<string>(argv + 1, argv + argc));
+     }
+     catch(DSEError &err)
+     {
+       cerr << err.what() << endl;
+       exit (-1);
+     }
+
+     if (help) {
+       cout << usage << "\n";
+       exit(-1);
+     }
+   }
+
+   // constructor, arguments of a library or server request.  throws
+   // DSEError on invalid options
+   CommandLineOptions(const vector<string> &args)
+   {
+     parse(args);
+   }
+
+   // destructor
+   ~CommandLineOptions()
+   {
+   }
+
+   // options that determine the solutions of a run, used to check that a
+   // checkpoint is resumed by the same run
+   string signature() const
+   {
+     ostringstream str;
+
+     str << "polyhedron=" << polyhedron
+         << " magnitude-bound=" << magnitudebound
+         << " pe-pipeline-stages=" << pepipelinestages;
+
+     if (rank > 1)
+       str << " rank=" << rank;
+
+     if (allocation != "none")
+       str << " allocation=" << allocation;
+
+     // shell order numbers candidates differently
+     if (shells)
+       str << " shells";
+
+     if (!search.empty())
+       str << " search=" << search << " chains=" << chains
+           << " steps=" << steps << " seed=" << seed;
+
+     // screened solutions are kept at the parameter instance only
+     if (screentop > 0)
+       str << " screen";
+
+     // schedule variants are solutions of their own
+     if (schedulevariants > 1)
+       str << " schedule-variants=" << schedulevariants;
+
+     // solutions carry I/O counts, and those over the bound are dropped
+     if (iometrics)
+       str << " io-metrics";
+     if (maxiopercycle > 0)
+       str << " max-io-per-cycle=" << maxiopercycle;
+     if (storage)
+       str << " storage";
+     if (maxstorage > 0)
+       str << " max-storage=" << maxstorage;
+
+     // only the frontier is kept
+     if (!pareto.empty())
+       str << " pareto=" << pareto << " pe-inefficiency=" << peinefficiency;
+
+     return str.str();
+   }
+
+   // list of options
+   string polyhedron;
+   int    magnitudebound;
+   int    peinefficiency;
+   int    pepipelinestages;
+   int    rank;
+   string allocation;
+   int    schedulevariants;
+   int    pebudget;
+   bool   iometrics;
+   int    maxiopercycle;
+   bool   storage;
+   int    maxstorage;
+   int    top;
+   bool   shells;
+   int    timebudget;
+   string search;
+   int    chains;
+   int    steps;
+   unsigned long seed;
+   bool   lazypecount;
+   int    screentop;
+   string pareto;
+   string streamfile;
+   bool   streamjson;
+   string snapshotfile;
+   int    snapshotinterval;
+   int    snapshottop;
+   string checkpointfile;
+   int    checkpointinterval;
+   bool   resume;
+   int    workers;
+   int    countworkers;
+   int    candidatetimeout;
+   long   candidatememory;
+   string outputfile;
+   string batchfile;
+
+   // help was requested, and the usage text
+   bool   help;
+   string usage;
+
+private:
+
+   // parse options (without the program name)
+   void parse(const vector<string> &args)
+   {
+     help = false;
+
      try {
        // group of config options
        po::options_description commandline("Program Options");
@@ -38,23 +168,67 @@ class CommandLineOptions
          ("magnitude-bound,m", po::value<int>(), "Upper bound on the magnitude of the projection vector")
          ("pe-inefficiency,n", po::value<int>(), "Upper bound on processor inefficiency: (lambda * u) factor")
          ("pe-pipeline-stages,s", po::value<int>(), "Lower bound on number of processor pipeline stages (Minimum delay on each dependency)")
+         ("rank,r", po::value<int>(), "Number of projection directions: map onto an array of n - r dimensions (default 1)")
+         ("allocation-objective", po::value<string>(), "Choose among equivalent allocations by link length: none (default), max or total")
+         ("schedule-variants", po::value<int>(), "Keep up to this many schedules of each projection vector from the utilization/latency Pareto set, each as a solution (default 1)")
+         ("pe-budget", po::value<int>(), "PEs of the device: partition each design onto them (LSGP, LPGS or replication) and rank by throughput on the device")
+         ("io-metrics", "Count the I/O ports of each design and its peak I/O values per cycle with the host")
+         ("max-io-per-cycle", po::value<int>(), "Drop designs with a peak of more I/O values per cycle (implies --io-metrics)")
+         ("storage", "Count the delay registers of each design")
+         ("max-storage", po::value<int>(), "Drop designs with more delay registers at the parameter instance (implies --storage)")
+         ("top,k", po::value<int>(), "Print only the best k solutions")
+         ("shells", "Enumerate projection vectors shell by shell (by largest component) until the best solution is proven optimal; ignores the magnitude bound")
+         ("time-budget", po::value<int>(), "Stop taking new candidates after this many seconds")
+         ("search", po::value<string>(), "Local search instead of enumeration: anneal, tabu or random-restart")
+         ("chains", po::value<int>(), "Number of local search chains (default: number of workers, at least 1)")
+         ("steps", po::value<int>(), "Moves made by each local search chain (default 200)")
+         ("seed", po::value<unsigned long>(), "Seed of the local search (default 1)")
+         ("lazy-pe-count", "Keep only instance PE counts; recompute parametric counts for printed solutions")
+         ("pareto", po::value<string>(), "Print the Pareto frontier over these comma separated metrics: bpp, pe-count, utilization, latency, max-length, avg-length, max-delay, avg-delay, io-ports, io-per-cycle, storage")
+         ("screen", po::value<int>(), "Screen candidates with the parameters fixed at their instance values, then solve only the best k parametrically and print them")
+         ("stream", po::value<string>(), "Write a record for each candidate to this file as soon as it completes")
+         ("stream-format", po::value<string>(), "Format of streamed records: csv (default) or json")
+         ("snapshot", po::value<string>(), "Periodically rewrite this file with the current best solutions")
+         ("snapshot-interval", po::value<int>(), "Seconds between snapshots (default 60)")
+         ("snapshot-top", po::value<int>(), "Number of solutions in a snapshot (default 20)")
+         ("checkpoint", po::value<string>(), "Periodically checkpoint the enumeration to this file")
+         ("checkpoint-interval", po::value<int>(), "Seconds between checkpoints (default 300)")
+         ("resume", "Resume the enumeration from the checkpoint file")
+         ("workers,j", po::value<int>(), "Evaluate candidates in this many worker processes")
+         ("count-workers", po::value<int>(), "Split candidates into stages: PIP ILPs in the workers (-j) and PE counts in this many separate worker processes")
+         ("candidate-timeout", po::value<int>(), "Wall clock limit per candidate in seconds (worker processes)")
+         ("candidate-memory", po::value<long>(), "Resident memory limit per candidate in MB (worker processes)")
+         ("output,o", po::value<string>(), "Write the output to this file instead of standard output")
+         ("batch", po::value<string>(), "Enumerate every problem of this manifest (one polyhedron configuration file plus options per line) in a shared worker pool")
          ;
 
        // read command line
-       store(po::parse_command_line(argc, argv, commandline), vm);
+       store(po::command_line_parser(args).options(commandline).run(), vm);
        notify(vm);
 
        if (vm.count("help")) {
-         cout << commandline << "\n";
-         exit(-1);
+         ostringstream str;
+         str << commandline;
+
+         help  = true;
+         usage = str.str();
+         return;
+       }
+
+       // batch of problems
+       if (vm.count("batch")) {
+         batchfile = vm["batch"].as<string>();
        }
 
        // read parameters into variables
        if (vm.count("polyhedron")) {
          polyhedron = vm["polyhedron"].as<string>();
-       } else {
-         cerr << "Must specify polyhedron configuration file\n";
-         throw "Incomplete options";
+       } else if (batchfile.empty()) {
+         throw "Must specify polyhedron configuration file";
+       }
+
+       if (vm.count("output")) {
+         outputfile = vm["output"].as<string>();
        }
 
        // read bound for the magnitude of the projection vector
@@ -85,32 +259,307 @@ class CommandLineOptions
        } else {
          pepipelinestages = 1;
        }
+
+       // read rank of the projection
+       if (vm.count("rank")) {
+         rank = vm["rank"].as<int>();
+
+         if (rank < 1) {
+           throw "Projection rank must be at least 1";
+         }
+       } else {
+         rank = 1;
+       }
+
+       // choice among the bases of the nullspace
+       if (vm.count("allocation-objective")) {
+         allocation = vm["allocation-objective"].as<string>();
+
+         if (allocation != "none" && allocation != "max" &&
+               allocation != "total") {
+           throw "Allocation objective must be none, max or total";
+         }
+       } else {
+         allocation = "none";
+       }
+
+       // schedules of each projection vector
+       if (vm.count("schedule-variants")) {
+         schedulevariants = vm["schedule-variants"].as<int>();
+
+         if (schedulevariants < 1) {
+           throw "Number of schedule variants must be at least 1";
+         }
+       } else {
+         schedulevariants = 1;
+       }
+
+       // PEs of the device the arrays are partitioned onto
+       if (vm.count("pe-budget")) {
+         pebudget = vm["pe-budget"].as<int>();
+
+         if (pebudget < 1) {
+           throw "PE budget must be at least 1";
+         }
+       } else {
+         pebudget = 0;
+       }
+
+       // read number of solutions to print
+       if (vm.count("top")) {
+         top = vm["top"].as<int>();
+
+         if (top < 1) {
+           throw "Number of solutions to print must be at least 1";
+         }
+       } else {
+         top = 0;
+       }
+
+       // shell by shell search
+       shells = vm.count("shells") > 0;
+
+       if (shells && rank > 1) {
+         throw "Shell search requires a projection of rank 1";
+       }
+
+       if (vm.count("time-budget")) {
+         timebudget = vm["time-budget"].as<int>();
+
+         if (timebudget < 1) {
+           throw "Time budget must be at least 1 second";
+         }
+       } else {
+         timebudget = 0;
+       }
+
+       // local search
+       if (vm.count("search")) {
+         search = vm["search"].as<string>();
+
+         if (search != "anneal" && search != "tabu" &&
+               search != "random-restart") {
+           throw "Search must be anneal, tabu or random-restart";
+         }
+
+         if (shells || rank > 1) {
+           throw "Local search requires a projection of rank 1 and no shell search";
+         }
+       }
+
+       if (vm.count("chains")) {
+         chains = vm["chains"].as<int>();
+
+         if (chains < 1) {
+           throw "Number of chains must be at least 1";
+         }
+       } else {
+         chains = 0;
+       }
+
+       if (vm.count("steps")) {
+         steps = vm["steps"].as<int>();
+
+         if (steps < 1) {
+           throw "Number of steps must be at least 1";
+         }
+       } else {
+         steps = 200;
+       }
+
+       if (vm.count("seed")) {
+         seed = vm["seed"].as<unsigned long>();
+       } else {
+         seed = 1;
+       }
+
+       // drop parametric PE counts during the search?
+       lazypecount = vm.count("lazy-pe-count") > 0;
+
+       // Pareto frontier, metrics are checked by the frontier
+       if (vm.count("pareto")) {
+         pareto = vm["pareto"].as<string>();
+
+         if (!search.empty()) {
+           throw "Pareto frontier requires enumeration, not local search";
+         }
+       }
+
+       // I/O with the host, counted for the filter and the I/O metrics of
+       // the Pareto frontier
+       iometrics = vm.count("io-metrics") > 0 ||
+                     ("," + pareto).find(",io-") != string::npos;
+
+       if (vm.count("max-io-per-cycle")) {
+         maxiopercycle = vm["max-io-per-cycle"].as<int>();
+
+         if (maxiopercycle < 1) {
+           throw "Maximum I/O values per cycle must be at least 1";
+         }
+
+         iometrics = true;
+       } else {
+         maxiopercycle = 0;
+       }
+
+       // delay registers
+       storage = vm.count("storage") > 0 ||
+                   ("," + pareto + ",").find(",storage,") != string::npos;
+
+       if (vm.count("max-storage")) {
+         maxstorage = vm["max-storage"].as<int>();
+
+         if (maxstorage < 1) {
+           throw "Maximum storage must be at least 1";
+         }
+
+         storage = true;
+       } else {
+         maxstorage = 0;
+       }
+
+       // screen at the parameter instance, printing only the finalists
+       if (vm.count("screen")) {
+         screentop = vm["screen"].as<int>();
+
+         if (screentop < 1) {
+           throw "Number of screened solutions to solve must be at least 1";
+         }
+
+         if (top == 0 || top > screentop)
+           top = screentop;
+       } else {
+         screentop = 0;
+       }
+
+       // streaming output
+       if (vm.count("stream")) {
+         streamfile = vm["stream"].as<string>();
+       }
+
+       streamjson = false;
+       if (vm.count("stream-format")) {
+         string format = vm["stream-format"].as<string>();
+
+         if (format == "json") {
+           streamjson = true;
+         } else if (format != "csv") {
+           throw "Stream format must be csv or json";
+         }
+       }
+
+       if (vm.count("snapshot")) {
+         snapshotfile = vm["snapshot"].as<string>();
+       }
+
+       if (vm.count("snapshot-interval")) {
+         snapshotinterval = vm["snapshot-interval"].as<int>();
+
+         if (snapshotinterval < 1) {
+           throw "Snapshot interval must be at least 1 second";
+         }
+       } else {
+         snapshotinterval = 60;
+       }
+
+       if (vm.count("snapshot-top")) {
+         snapshottop = vm["snapshot-top"].as<int>();
+
+         if (snapshottop < 1) {
+           throw "Number of solutions in a snapshot must be at least 1";
+         }
+       } else {
+         snapshottop = 20;
+       }
+
+       // checkpoint and resume
+       if (vm.count("checkpoint")) {
+         checkpointfile = vm["checkpoint"].as<string>();
+       }
+
+       if (vm.count("checkpoint-interval")) {
+         checkpointinterval = vm["checkpoint-interval"].as<int>();
+
+         if (checkpointinterval < 1) {
+           throw "Checkpoint interval must be at least 1 second";
+         }
+       } else {
+         checkpointinterval = 300;
+       }
+
+       resume = vm.count("resume") > 0;
+       if (resume && checkpointfile.empty()) {
+         throw "Must specify checkpoint file to resume from";
+       }
+
+       // worker processes and limits per candidate
+       if (vm.count("candidate-timeout")) {
+         candidatetimeout = vm["candidate-timeout"].as<int>();
+
+         if (candidatetimeout < 1) {
+           throw "Candidate timeout must be at least 1 second";
+         }
+       } else {
+         candidatetimeout = 0;
+       }
+
+       if (vm.count("candidate-memory")) {
+         candidatememory = vm["candidate-memory"].as<long>();
+
+         if (candidatememory < 1) {
+           throw "Candidate memory limit must be at least 1 MB";
+         }
+       } else {
+         candidatememory = 0;
+       }
+
+       if (vm.count("workers")) {
+         workers = vm["workers"].as<int>();
+
+         if (workers < 0) {
+           throw "Number of workers must not be negative";
+         }
+       } else {
+         workers = 0;
+       }
+
+       if (vm.count("count-workers")) {
+         countworkers = vm["count-workers"].as<int>();
+
+         if (countworkers < 0) {
+           throw "Number of count workers must not be negative";
+         }
+       } else {
+         countworkers = 0;
+       }
+
+       // limits are enforced by worker processes, and stages need a PIP
+       // worker
+       if (workers == 0 && (candidatetimeout > 0 || candidatememory > 0 ||
+                            countworkers > 0)) {
+         workers = 1;
+       }
+
+       // one chain per worker
+       if (chains == 0) {
+         chains = workers > 0 ? workers : 1;
+       }
+
+       // local search visits candidates in no fixed order
+       if (!search.empty() && !checkpointfile.empty()) {
+         throw "Local search cannot be checkpointed";
+       }
      }
      catch(exception &err)
      {
-       cerr << "Error parsing options: " << err.what() << endl;
-       exit (-1);
+       throw DSEError(string("Error parsing options: ") + err.what());
      }
      catch(const char *err)
      {
-       cerr << "Error parsing options: " << err << endl;
-       exit (-1);
+       throw DSEError(string("Error parsing options: ") + err);
      }
-
-     return;
    }
 
-   // destructor
-   ~CommandLineOptions()
-   {
-   }
-
-   // list of options
-   string polyhedron;
-   int    magnitudebound;
-   int    peinefficiency;
-   int    pepipelinestages;
-
 };
 
 #endif // __COMMANDLINE_OPTIONS_H__
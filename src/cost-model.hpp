@@ -0,0 +1,119 @@
+//  cost-model.hpp
+//
+//  Predict the evaluation time of a projection vector, used to hand the
+//  most expensive candidates to the worker pool first (longest processing
+//  time first).
+//
+//  Vectors with large or many non-zero elements give deep PIP trees and
+//  large PE count evalues.  The prior cost of a vector is the product of
+//  (1 + |u_i|) over its elements.  Measured times calibrate the prior: the
+//  prediction is the mean time of vectors of the same shape (the sorted
+//  magnitudes of the elements, shared by vectors that differ in the order
+//  and signs of their elements) if one was timed, and otherwise the prior
+//  scaled by the mean ratio of time to prior of all timed vectors.
+
+#ifndef __COST_MODEL_H__
+#   define __COST_MODEL_H__
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+using namespace std;
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+class CostModel
+{
+
+ public:
+
+   // constructor
+   CostModel() :
+     seconds (0),
+     prior (0)
+   {
+   }
+
+   // destructor
+   ~CostModel()
+   {
+   }
+
+   // predicted cost of a vector, in seconds once vectors have been timed
+   double predict(const ublas::vector<int> &v)
+   {
+     map< string, Mean >::iterator s = shapes.find(shapeKey(v));
+
+     if (s != shapes.end())
+       return s->second.total / s->second.count;
+
+     double p = priorCost(v);
+
+     return prior > 0 ? p * seconds / prior : p;
+   }
+
+   // record the measured evaluation time of a vector
+   void observe(const ublas::vector<int> &v, double elapsed)
+   {
+     Mean &m = shapes[shapeKey(v)];
+     m.total += elapsed;
+     m.count++;
+
+     seconds += elapsed;
+     prior   += priorCost(v);
+   }
+
+ private:
+
+   // mean of measured times
+   struct Mean
+   {
+     double total;
+     unsigned int count;
+
+     Mean() : total (0), count (0) { }
+   };
+
+   // cost before any vector is timed
+   static double priorCost(const ublas::vector<int> &v)
+   {
+     double p = 1;
+
+     for (unsigned int i = 0; i < v.size(); i++) {
+       p *= 1 + abs (v(i));
+     }
+
+     return p;
+   }
+
+   // sorted magnitudes of the elements
+   static string shapeKey(const ublas::vector<int> &v)
+   {
+     vector< int > m(v.size());
+     for (unsigned int i = 0; i < v.size(); i++) {
+       m[i] = abs (v(i));
+     }
+     sort(m.begin(), m.end());
+
+     ostringstream key;
+     for (unsigned int i = 0; i < m.size(); i++) {
+       key << m[i] << " ";
+     }
+
+     return key.str();
+   }
+
+   // measured times by shape
+   map< string, Mean > shapes;
+
+   // total measured time and total prior cost of the timed vectors
+   double seconds;
+   double prior;
+
+};
+
+#endif // __COST_MODEL_H__
@@ -0,0 +1,230 @@
+//  dimension-kernels.hpp
+//
+//  Kernels on vectors of the dimension of the polyhedron, specialized for
+//  small dimensions.
+//
+//  The kernels screen projection vectors (gcd, magnitude) and multiply
+//  schedules and allocations with the dependencies.  They run for every
+//  position of the enumeration and every candidate, over vectors of 2 to 6
+//  elements.  DimensionKernel<N> has the dimension as a constant, so its
+//  loops have fixed trip counts and are unrolled by the compiler;
+//  DimensionKernel<0> reads the dimension at run time and handles any
+//  polyhedron.
+//
+//  The screening kernels are inlined into a loop over positions that is
+//  itself instantiated for each dimension (see IndexEnumerator), and picked
+//  once per run.  The network kernels run once per candidate, so
+//  DimensionKernels simply switches on the dimension of the polyhedron.
+
+#ifndef __DIMENSION_KERNELS_H__
+#   define __DIMENSION_KERNELS_H__
+
+#include <cstdlib>
+using namespace std;
+
+#include <boost/math/common_factor.hpp>
+
+// dimensions with specialized kernels
+#define DIMENSION_KERNELS_MIN 2
+#define DIMENSION_KERNELS_MAX 6
+
+//
+// kernels of dimension N, or of the dimension n passed at run time if N is
+// zero.  vectors are arrays of n ints, matrices are stored row major with
+// n columns.
+//
+template <unsigned int N>
+struct DimensionKernel
+{
+   // number of elements of a vector
+   static unsigned int size(unsigned int n)
+   {
+     return N ? N : n;
+   }
+
+   // gcd of the elements of a vector, ignoring 0 elements
+   static int gcd(const int *v, unsigned int n)
+   {
+     int vecgcd = 0;
+     for (unsigned int i = 0; i < size(n); i++) {
+       if (v[i] != 0)
+         vecgcd = boost::math::gcd(vecgcd, v[i]);
+     }
+
+     return vecgcd;
+   }
+
+   // largest magnitude of an element
+   static int largestMagnitude(const int *v, unsigned int n)
+   {
+     int largest = 0;
+     for (unsigned int i = 0; i < size(n); i++) {
+       int m = abs(v[i]);
+       if (m > largest) largest = m;
+     }
+
+     return largest;
+   }
+
+   // squared euclidean magnitude
+   static int squaredMagnitude(const int *v, unsigned int n)
+   {
+     int mag = 0;
+     for (unsigned int i = 0; i < size(n); i++) {
+       mag += v[i] * v[i];
+     }
+
+     return mag;
+   }
+
+   //
+   // delays of the links of a schedule: the longest delay and the sum of
+   // delays.  the delay of a dependency d is -schedule.d
+   //
+   static void delays(const int *schedule, const int *dependencies,
+                      unsigned int count, unsigned int n,
+                      int &maximum, int &sum)
+   {
+     maximum = 0;
+     sum = 0;
+
+     for (unsigned int i = 0; i < count; i++) {
+       const int *d = dependencies + i * size(n);
+
+       int prod = 0;
+       for (unsigned int j = 0; j < size(n); j++) {
+         prod += schedule[j] * d[j];
+       }
+
+       // negate delay
+       prod = -prod;
+
+       if (prod > maximum) maximum = prod;
+       sum += prod;
+     }
+   }
+
+   //
+   // lengths of the links of an allocation with rows rows: the longest
+   // length and the sum of lengths.  the length of a dependency d along
+   // row a is |a.d|
+   //
+   static void lengths(const int *allocation, unsigned int rows,
+                       const int *dependencies, unsigned int count,
+                       unsigned int n, int &maximum, int &sum)
+   {
+     maximum = 0;
+     sum = 0;
+
+     for (unsigned int i = 0; i < rows; i++) {
+       const int *a = allocation + i * size(n);
+
+       for (unsigned int j = 0; j < count; j++) {
+         const int *d = dependencies + j * size(n);
+
+         int prod = 0;
+         for (unsigned int k = 0; k < size(n); k++) {
+           prod += a[k] * d[k];
+         }
+
+         prod = abs (prod);
+
+         if (prod > maximum) maximum = prod;
+         sum += prod;
+       }
+     }
+   }
+};
+
+//
+// network kernels of the dimension of a polyhedron: the specialization of
+// the dimension if there is one, otherwise the generic kernels
+//
+class DimensionKernels
+{
+
+ public:
+
+   // constructor
+   DimensionKernels(unsigned int _dimensions) :
+     dimensions (_dimensions)
+   {
+   }
+
+   // are the kernels specialized for the dimension?
+   bool specialized()
+   {
+     return dimensions >= DIMENSION_KERNELS_MIN &&
+              dimensions <= DIMENSION_KERNELS_MAX;
+   }
+
+   void delays(const int *schedule, const int *dependencies,
+               unsigned int count, int &maximum, int &sum)
+   {
+     switch (dimensions) {
+       case 2:
+         DimensionKernel<2>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+       case 3:
+         DimensionKernel<3>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+       case 4:
+         DimensionKernel<4>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+       case 5:
+         DimensionKernel<5>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+       case 6:
+         DimensionKernel<6>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+       default:
+         DimensionKernel<0>::delays(schedule, dependencies, count,
+                                    dimensions, maximum, sum);
+         break;
+     }
+   }
+
+   void lengths(const int *allocation, unsigned int rows,
+                const int *dependencies, unsigned int count,
+                int &maximum, int &sum)
+   {
+     switch (dimensions) {
+       case 2:
+         DimensionKernel<2>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+       case 3:
+         DimensionKernel<3>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+       case 4:
+         DimensionKernel<4>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+       case 5:
+         DimensionKernel<5>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+       case 6:
+         DimensionKernel<6>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+       default:
+         DimensionKernel<0>::lengths(allocation, rows, dependencies, count,
+                                     dimensions, maximum, sum);
+         break;
+     }
+   }
+
+ private:
+
+   unsigned int dimensions;
+
+};
+
+#endif // __DIMENSION_KERNELS_H__
@@ -0,0 +1,273 @@
+//  domain-scanner.hpp
+//
+//  Scan the integer points of a domain for an instance of its parameters.
+//
+//  The parameters of the PIP domain are replaced by their values and the
+//  domain is split by Polyhedron_Scan into loop bounds, one level per
+//  dimension.  Points are not visited one at a time: for every value of the
+//  outer n-1 coordinates the scan reports the run [lo, hi] of the innermost
+//  coordinate, so callers can process a run with affine increments.  Bounds
+//  are evaluated in 64-bit integers; nothing but the current point is
+//  stored.
+
+#ifndef __DOMAIN_SCANNER_H__
+#   define __DOMAIN_SCANNER_H__
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include <polylib/polylibgmp.h>
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// local includes
+#include "dse-error.hpp"
+
+class DomainScanner
+{
+
+ public:
+
+   // constructor
+   //   domain   - PIP constraints over the unknowns and parameters
+   //   instance - values of the parameters
+   // throws DSEError if the instance domain is empty or unbounded
+   DomainScanner(PipMatrix *domain, unsigned int _dimensions,
+                 unsigned int parameters, const vector< int > &instance) :
+     dimensions (_dimensions),
+     levels (_dimensions)
+   {
+     // domain constraints with the parameters substituted
+     Matrix *constraints = Matrix_Alloc( domain->NbRows, dimensions + 2 );
+
+     for (unsigned int i = 0; i < domain->NbRows; i++) {
+       long long constant = VALUE_TO_INT( domain->p[i][dimensions + parameters + 1] );
+
+       for (unsigned int j = 0; j < parameters; j++) {
+         constant += (long long) VALUE_TO_INT( domain->p[i][1 + dimensions + j] ) *
+                       instance[j];
+       }
+
+       for (unsigned int j = 0; j <= dimensions; j++) {
+         value_assign (constraints->p[i][j], domain->p[i][j]);
+       }
+       value_set_si (constraints->p[i][dimensions + 1], constant);
+     }
+
+     P = Constraints2Polyhedron (constraints, 256);
+     Matrix_Free (constraints);
+
+     if (emptyQ (P)) {
+       Polyhedron_Free (P);
+       throw DSEError("Domain is empty for the parameter instance");
+     }
+
+     for (unsigned int r = 0; r < P->NbRays; r++) {
+       if (value_zero_p (P->Ray[r][0]) ||
+             value_zero_p (P->Ray[r][dimensions + 1])) {
+         Polyhedron_Free (P);
+         throw DSEError("Domain is unbounded for the parameter instance");
+       }
+     }
+
+     //
+     // loop bounds: level i constrains coordinate i given the outer ones
+     //
+     Polyhedron *context = Universe_Polyhedron (0);
+     Polyhedron *scan = Polyhedron_Scan (P, context, 256);
+     Polyhedron_Free (context);
+
+     Polyhedron *level = scan;
+     for (unsigned int i = 0; i < dimensions && level; i++) {
+       for (unsigned int r = 0; r < level->NbConstraints; r++) {
+         Bound b;
+         b.equality = value_zero_p (level->Constraint[r][0]);
+
+         for (unsigned int j = 0; j <= dimensions; j++) {
+           b.coeff.push_back( VALUE_TO_INT( level->Constraint[r][1 + j] ) );
+         }
+
+         levels[i].push_back(b);
+       }
+
+       level = level->next;
+     }
+
+     if (scan)
+       Domain_Free (scan);
+   }
+
+   // destructor
+   ~DomainScanner()
+   {
+     Polyhedron_Free (P);
+   }
+
+   //
+   // visit every run of the domain.  the visitor is called as
+   //   visitor(x, lo, hi)
+   // where x holds the outer n-1 coordinates of the run and lo <= hi are the
+   // bounds of the innermost coordinate.
+   //
+   template< class Visitor >
+   void scan(Visitor &visitor)
+   {
+     vector< long long > x(dimensions, 0);
+     scanLevel(0, x, visitor);
+   }
+
+   //
+   // bounds of the innermost coordinate of the run with outer coordinates
+   // x.  returns false if the outer coordinates are outside the domain.
+   //
+   bool innerRange(const vector< long long > &x, long long &lo, long long &hi)
+   {
+     for (unsigned int i = 0; i + 1 < dimensions; i++) {
+       long long l, h;
+
+       if (!range(i, x, l, h) || x[i] < l || x[i] > h)
+         return false;
+     }
+
+     return range(dimensions - 1, x, lo, hi);
+   }
+
+   //
+   // smallest and largest value of the affine function c x + c0 over the
+   // domain, rounded to integers
+   //
+   void extremes(const vector< long long > &c, long long c0,
+                 long long &lo, long long &hi)
+   {
+     double l = 0, h = 0;
+
+     // the domain is the convex hull of its vertices
+     for (unsigned int r = 0; r < P->NbRays; r++) {
+       Value *ray = P->Ray[r];
+       double denominator = VALUE_TO_INT( ray[dimensions + 1] );
+
+       double v = 0;
+       for (unsigned int i = 0; i < dimensions; i++) {
+         v += (double) c[i] * VALUE_TO_INT( ray[1 + i] );
+       }
+       v /= denominator;
+
+       if (r == 0 || v < l) l = v;
+       if (r == 0 || v > h) h = v;
+     }
+
+     lo = (long long) floor (l) + c0;
+     hi = (long long) ceil (h) + c0;
+   }
+
+   // number of dimensions
+   unsigned int getDimensions()
+   {
+     return dimensions;
+   }
+
+ private:
+
+   // constraint of loop level i:  coeff[0..i-1] x_0..x_{i-1} +
+   // coeff[i] x_i + coeff[n] >= 0 (or = 0).  the coefficients of inner
+   // coordinates are zero.
+   struct Bound
+   {
+     bool equality;
+     vector< long long > coeff;
+   };
+
+   //
+   // bounds of coordinate i given the outer coordinates.  returns false if
+   // there is no integer value.
+   //
+   bool range(unsigned int i, const vector< long long > &x,
+              long long &lo, long long &hi)
+   {
+     bool haslo = false, hashi = false;
+
+     for (unsigned int r = 0; r < levels[i].size(); r++) {
+       const Bound &b = levels[i][r];
+
+       long long rest = b.coeff[dimensions];
+       for (unsigned int j = 0; j < i; j++) {
+         rest += b.coeff[j] * x[j];
+       }
+
+       long long a = b.coeff[i];
+
+       // condition on the outer coordinates only
+       if (a == 0) {
+         if (rest < 0 || (b.equality && rest != 0))
+           return false;
+         continue;
+       }
+
+       //  a x_i + rest >= 0
+       if (a > 0 || b.equality) {
+         long long l = ceilDiv (-rest, a);
+
+         if (!haslo || l > lo) lo = l;
+         haslo = true;
+       }
+
+       if (a < 0 || b.equality) {
+         long long h = floorDiv (-rest, a);
+
+         if (!hashi || h < hi) hi = h;
+         hashi = true;
+       }
+     }
+
+     if (!haslo || !hashi) {
+       throw DSEError("Domain scan has an unbounded loop");
+     }
+
+     return lo <= hi;
+   }
+
+   // scan the loops from level i inwards
+   template< class Visitor >
+   void scanLevel(unsigned int i, vector< long long > &x, Visitor &visitor)
+   {
+     long long lo, hi;
+
+     if (!range(i, x, lo, hi))
+       return;
+
+     if (i == dimensions - 1) {
+       visitor(x, lo, hi);
+       return;
+     }
+
+     for (x[i] = lo; x[i] <= hi; x[i]++) {
+       scanLevel(i + 1, x, visitor);
+     }
+   }
+
+   static long long floorDiv(long long a, long long b)
+   {
+     if (b < 0) { a = -a; b = -b; }
+     return a >= 0 ? a / b : - ((-a + b - 1) / b);
+   }
+
+   static long long ceilDiv(long long a, long long b)
+   {
+     return - floorDiv (-a, b);
+   }
+
+   unsigned int dimensions;
+
+   // instance domain and its loop bounds
+   Polyhedron *P;
+   vector< vector< Bound > > levels;
+
+   // the scanner owns the polyhedron, do not copy
+   DomainScanner(const DomainScanner &);
+   DomainScanner &operator=(const DomainScanner &);
+
+};
+
+#endif // __DOMAIN_SCANNER_H__
@@ -0,0 +1,28 @@
+//  dse-error.hpp
+//
+//  Error raised by the design space exploration library.  Library code never
+//  exits the process; failures (bad options, unreadable input files,
+//  unexpected solver output) are thrown as a DSEError carrying the message
+//  that used to be printed.
+
+#ifndef __DSE_ERROR_H__
+#   define __DSE_ERROR_H__
+
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+class DSEError : public std::runtime_error
+{
+
+ public:
+
+   // constructor
+   DSEError(const string &_what) :
+     std::runtime_error (_what)
+   {
+   }
+
+};
+
+#endif // __DSE_ERROR_H__
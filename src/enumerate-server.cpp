@@ -0,0 +1,218 @@
+//  enumerate-server.cpp
+//
+//  Answer enumeration requests from a long lived process.  Requests are
+//  read one per line from standard input, or from the clients of a local
+//  Unix socket, and take the options of the enumerate program, e.g.
+//
+//    -i input-polyhedrons/bmm/bmm.opt -m 3 -n 10 -s 1
+//
+//  The reply is the output of enumerate followed by a line "END".  A failed
+//  request is answered with "ERROR <message>" followed by "END".  The
+//  request "clear" drops all cached polyhedrons and solutions.
+//
+//  Polyhedron configurations, solvers and the solutions of evaluated
+//  projection vectors are kept across requests.  Clients of the socket are
+//  served one at a time.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <sstream>
+#include <iostream>
+using namespace std;
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+// local includes
+#include "systolic-dse.hpp"
+
+//
+// answer one request
+//
+static void answer(DSESession &session, const string &request, ostream &os)
+{
+  if (request == "clear") {
+    session.clear();
+    os << "END" << endl;
+    return;
+  }
+
+  string error;
+  if (dse_enumerate(session, po::split_unix(request), os, error) < 0) {
+    os << "ERROR " << error << endl;
+  }
+
+  os << "END" << endl;
+}
+
+//
+// write a whole reply to a socket
+//
+static bool writeAll(int fd, const string &msg)
+{
+  const char *p = msg.data();
+  size_t left = msg.size();
+
+  while (left > 0) {
+    ssize_t n = write (fd, p, left);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    p    += n;
+    left -= n;
+  }
+
+  return true;
+}
+
+//
+// answer requests on standard input
+//
+static void serveStdin(DSESession &session)
+{
+  string request;
+
+  while (getline(cin, request)) {
+    if (request.empty())
+      continue;
+
+    answer(session, request, cout);
+  }
+}
+
+//
+// answer requests of clients connecting to a Unix socket
+//
+static void serveSocket(DSESession &session, const string &path)
+{
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof (addr.sun_path)) {
+    cerr << "Socket path is too long: " << path << endl;
+    exit (-1);
+  }
+  strcpy (addr.sun_path, path.c_str());
+
+  int listener = socket (AF_UNIX, SOCK_STREAM, 0);
+
+  if (listener < 0) {
+    cerr << "Failed to create socket" << endl;
+    exit (-1);
+  }
+
+  // remove a stale socket of an earlier server
+  unlink (path.c_str());
+
+  if (bind (listener, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+        listen (listener, 16) < 0) {
+    cerr << "Failed to listen on " << path << endl;
+    exit (-1);
+  }
+
+  cout << "Listening on " << path << endl;
+
+  // clients may disconnect before their reply is written
+  signal (SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    int client = accept (listener, NULL, NULL);
+
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+
+      cerr << "Failed to accept connection" << endl;
+      exit (-1);
+    }
+
+    FILE *in = fdopen (client, "r");
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    while ((length = getline (&line, &size, in)) > 0) {
+      string request(line, length);
+
+      // strip line terminator
+      while (!request.empty() &&
+               (request[request.size() - 1] == '\n' ||
+                request[request.size() - 1] == '\r')) {
+        request.erase(request.size() - 1);
+      }
+
+      if (request.empty())
+        continue;
+
+      ostringstream reply;
+      answer(session, request, reply);
+
+      if (!writeAll (client, reply.str()))
+        break;
+    }
+
+    free (line);
+    fclose (in);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  string socketpath;
+
+  //
+  // parse command line options
+  //
+  try {
+    // group of config options
+    po::options_description commandline("Server Options");
+    // variable map
+    po::variables_map vm;
+
+    commandline.add_options()
+      ("help,?", "This help screen")
+      ("socket", po::value<string>(), "Answer requests on this Unix socket instead of standard input")
+      ;
+
+    // read command line
+    store(po::parse_command_line(argc, argv, commandline), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+      cout << commandline << "\n";
+      exit(-1);
+    }
+
+    if (vm.count("socket")) {
+      socketpath = vm["socket"].as<string>();
+    }
+  }
+  catch(std::exception &err)
+  {
+    cerr << "Error parsing options: " << err.what() << endl;
+    exit (-1);
+  }
+
+  DSESession session;
+
+  if (socketpath.empty()) {
+    serveStdin(session);
+  } else {
+    serveSocket(session, socketpath);
+  }
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+//  generate-kernel.cpp
+//
+//  Generate a multithreaded C++ kernel (OpenMP) that runs a recurrence in
+//  the order of the space-time mapping of one projection vector, e.g.
+//
+//    -i input-polyhedrons/sw/sw.opt --projection "1 1" -o sw-kernel.cpp
+//    g++ -O3 -fopenmp sw-kernel.cpp -o sw-kernel && ./sw-kernel 20000
+//
+//  The schedule and allocation are found by the solver as in enumerate;
+//  --schedule replaces the schedule.  The generated program takes the
+//  parameters as arguments, defaulting to the instantiations of the
+//  configuration file.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+#include <boost/tokenizer.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "dse-error.hpp"
+#include "polyhedron-options.hpp"
+#include "projection-solver.hpp"
+#include "kernel-generator.hpp"
+
+//
+// split a string of integers separated by whitespace
+//
+static vector< int > integers(const string &str)
+{
+  vector< int > v;
+
+  char_separator<char> sep(" \t,");
+  tokenizer< char_separator<char> > tokens(str, sep);
+
+  for (tokenizer< char_separator<char> >::iterator beg=tokens.begin();
+       beg!=tokens.end(); ++beg) {
+    v.push_back( atoi(beg->c_str()) );
+  }
+
+  return v;
+}
+
+int main(int argc, char **argv)
+{
+  string polyhedron;
+  string outputfile;
+  int pepipelinestages = 1;
+  vector< int > projection;
+  vector< int > schedule;
+
+  //
+  // parse command line options
+  //
+  try {
+    // group of config options
+    po::options_description commandline("Kernel Generator Options");
+    // variable map
+    po::variables_map vm;
+
+    commandline.add_options()
+      ("help,?", "This help screen")
+      ("polyhedron,i", po::value<string>(), "Polyhedron configuration file")
+      ("pe-pipeline-stages,s", po::value<int>(), "Number of processor pipeline stages (default 1)")
+      ("projection", po::value<string>(), "Projection vector")
+      ("schedule", po::value<string>(), "Schedule to use instead of the one found by the solver")
+      ("output,o", po::value<string>(), "Write the kernel to this file instead of standard output")
+      ;
+
+    // read command line
+    store(po::parse_command_line(argc, argv, commandline), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+      cout << commandline << "\n";
+      exit(-1);
+    }
+
+    if (vm.count("polyhedron")) {
+      polyhedron = vm["polyhedron"].as<string>();
+    } else {
+      throw "Must specify polyhedron configuration file";
+    }
+
+    if (vm.count("pe-pipeline-stages")) {
+      pepipelinestages = vm["pe-pipeline-stages"].as<int>();
+    }
+
+    if (vm.count("projection")) {
+      projection = integers(vm["projection"].as<string>());
+    } else {
+      throw "Must specify projection vector";
+    }
+
+    if (vm.count("schedule")) {
+      schedule = integers(vm["schedule"].as<string>());
+    }
+
+    if (vm.count("output")) {
+      outputfile = vm["output"].as<string>();
+    }
+  }
+  catch(std::exception &err)
+  {
+    cerr << "Error parsing options: " << err.what() << endl;
+    exit (-1);
+  }
+  catch(const char *err)
+  {
+    cerr << "Error parsing options: " << err << endl;
+    exit (-1);
+  }
+
+  try {
+    PolyhedronOptions polyopt(polyhedron);
+
+    if (projection.size() != polyopt.dimensions) {
+      throw DSEError("Projection vector must have one element per dimension");
+    }
+
+    if (!schedule.empty() && schedule.size() != polyopt.dimensions) {
+      throw DSEError("Schedule must have one element per dimension");
+    }
+
+    ProjectionSolver solver(polyopt.dimensions,
+                            polyopt.parameters,
+                            &polyopt.parameterinstantiations,
+                            &polyopt.parameternames,
+                            pepipelinestages,
+                            polyopt.pipconstraints,
+                            polyopt.dependencies);
+
+    ublas::vector<int> pv(projection.size());
+    for (unsigned int i = 0; i < projection.size(); i++) {
+      pv(i) = projection[i];
+    }
+
+    ProjectionSolution *ps = solver.evaluate(&pv);
+
+    if (!schedule.empty()) {
+      for (unsigned int i = 0; i < polyopt.dimensions; i++) {
+        ps->schedule[i] = schedule[i];
+      }
+    }
+
+    try {
+      KernelGenerator generator(solver.getDomain(), solver.getContext(),
+                                solver.getDependencies(),
+                                polyopt.dimensions, polyopt.parameters,
+                                &polyopt.parameternames,
+                                &polyopt.parameterinstantiations, ps);
+
+      if (outputfile.empty()) {
+        generator.generate(cout);
+      } else {
+        ofstream os(outputfile.c_str());
+
+        if (!os) {
+          throw DSEError("Failed to open " + outputfile);
+        }
+
+        generator.generate(os);
+      }
+    }
+    catch (...) {
+      delete ps;
+      throw;
+    }
+
+    delete ps;
+  }
+  catch (DSEError &err) {
+    cerr << err.what() << endl;
+    exit (-1);
+  }
+
+  return 0;
+}
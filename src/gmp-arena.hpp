@@ -0,0 +1,259 @@
+//  gmp-arena.hpp
+//
+//  Bump allocator for the GMP integers of a PIP solve.
+//
+//  Building an ILP, solving it and reading the QUAST initialize and clear
+//  thousands of GMP integers, each a round trip through the heap allocator.
+//  While a Scope is alive GMP allocates from blocks of the arena instead
+//  (mp_set_memory_functions) and frees nothing; the blocks are rewound,
+//  not freed, when the outermost scope ends.  Integers allocated before the
+//  scope are reallocated and freed by the heap as before, so they may be
+//  read and grown within it.
+//
+//  Every integer initialized within a scope must be cleared before the scope
+//  ends.  Integers that outlive a scope (pooled matrices, the constants of
+//  the PIP session) are allocated while the arena is suspended.
+//
+//  GMP memory functions are global, and so is the arena: each worker
+//  process has its own.
+
+#ifndef __GMP_ARENA_H__
+#   define __GMP_ARENA_H__
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+#include <gmp.h>
+
+class GMPArena
+{
+
+ public:
+
+   // GMP allocates from the arena while a scope is alive.  scopes nest
+   class Scope
+   {
+    public:
+      Scope()
+      {
+        GMPArena::enter();
+      }
+
+      ~Scope()
+      {
+        GMPArena::leave();
+      }
+
+    private:
+      Scope(const Scope &);
+      Scope &operator=(const Scope &);
+   };
+
+   // GMP allocates from the heap while a suspension is alive, within a
+   // scope or not
+   class Suspend
+   {
+    public:
+      Suspend()
+      {
+        GMPArena::suspend(true);
+      }
+
+      ~Suspend()
+      {
+        GMPArena::suspend(false);
+      }
+
+    private:
+      Suspend(const Suspend &);
+      Suspend &operator=(const Suspend &);
+   };
+
+   // bytes held by the arena
+   static size_t bytesReserved()
+   {
+     State &s = state();
+     size_t total = 0;
+
+     for (unsigned int i = 0; i < s.blocks.size(); i++) {
+       total += s.blocks[i].size;
+     }
+
+     return total;
+   }
+
+ private:
+
+   struct Block
+   {
+     char *base;
+     size_t size;
+   };
+
+   struct State
+   {
+     // blocks, the block being carved and the bytes used of it
+     vector< Block > blocks;
+     unsigned int current;
+     size_t used;
+
+     // last allocation, grown in place when reallocated
+     char *last;
+
+     // depth of nested scopes and suspensions
+     unsigned int depth;
+     unsigned int suspended;
+
+     // heap memory functions of GMP
+     void *(*heapallocate)(size_t);
+     void *(*heapreallocate)(void *, size_t, size_t);
+     void (*heapfree)(void *, size_t);
+
+     State() :
+       current (0),
+       used (0),
+       last (NULL),
+       depth (0),
+       suspended (0)
+     {
+       mp_get_memory_functions(&heapallocate, &heapreallocate, &heapfree);
+     }
+   };
+
+   // size of each block requested from the heap
+   static const size_t BLOCK_SIZE = 256 * 1024;
+
+   static State &state()
+   {
+     static State s;
+     return s;
+   }
+
+   // install the arena or the heap memory functions
+   static void install()
+   {
+     State &s = state();
+
+     if (s.depth > 0 && s.suspended == 0)
+       mp_set_memory_functions(allocate, reallocate, release);
+     else
+       mp_set_memory_functions(s.heapallocate, s.heapreallocate,
+                               s.heapfree);
+   }
+
+   static void enter()
+   {
+     State &s = state();
+
+     s.depth++;
+     install();
+   }
+
+   static void leave()
+   {
+     State &s = state();
+
+     // rewind the blocks after the outermost scope
+     if (--s.depth == 0) {
+       s.current = 0;
+       s.used    = 0;
+       s.last    = NULL;
+     }
+
+     install();
+   }
+
+   static void suspend(bool on)
+   {
+     State &s = state();
+
+     if (on)
+       s.suspended++;
+     else
+       s.suspended--;
+
+     install();
+   }
+
+   // was p allocated from the arena?
+   static bool owned(void *p)
+   {
+     State &s = state();
+     char *c = (char *) p;
+
+     for (unsigned int i = 0; i < s.blocks.size(); i++) {
+       if (c >= s.blocks[i].base && c < s.blocks[i].base + s.blocks[i].size)
+         return true;
+     }
+
+     return false;
+   }
+
+   // GMP memory functions
+   static void *allocate(size_t bytes)
+   {
+     State &s = state();
+
+     // align to 16 bytes, enough for limbs
+     bytes = (bytes + 15) & ~(size_t) 15;
+
+     // next block with room, or a new block.  large requests get a block of
+     // their own
+     while (s.current < s.blocks.size() &&
+              s.used + bytes > s.blocks[s.current].size) {
+       s.current++;
+       s.used = 0;
+     }
+
+     if (s.current == s.blocks.size()) {
+       Block b;
+       b.size = BLOCK_SIZE;
+       if (bytes > b.size)
+         b.size = bytes;
+       b.base = (char *) s.heapallocate(b.size);
+
+       s.blocks.push_back(b);
+       s.used = 0;
+     }
+
+     s.last  = s.blocks[s.current].base + s.used;
+     s.used += bytes;
+
+     return s.last;
+   }
+
+   static void *reallocate(void *p, size_t oldbytes, size_t bytes)
+   {
+     State &s = state();
+
+     if (!owned(p))
+       return s.heapreallocate(p, oldbytes, bytes);
+
+     // grow the last allocation in place
+     if ((char *) p == s.last) {
+       size_t start = s.last - s.blocks[s.current].base;
+       size_t end   = start + ((bytes + 15) & ~(size_t) 15);
+
+       if (end <= s.blocks[s.current].size) {
+         s.used = end;
+         return p;
+       }
+     }
+
+     void *q = allocate(bytes);
+     memcpy (q, p, oldbytes < bytes ? oldbytes : bytes);
+
+     return q;
+   }
+
+   static void release(void *p, size_t bytes)
+   {
+     if (!owned(p))
+       state().heapfree(p, bytes);
+   }
+
+};
+
+#endif // __GMP_ARENA_H__
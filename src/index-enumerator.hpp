@@ -6,29 +6,87 @@
 //  May 9 2009
 //
 //  Enumerate indices
+//
+//  For projections of rank k > 1 the index is a k x n projection matrix,
+//  stored row major.  Its rows are a basis of a k dimensional lattice of
+//  projection directions.  Combinations of k primitive directions within
+//  the magnitude bound are stepped through, and each is replaced by a
+//  reduced basis of the lattice it spans, no longer than the directions.
+//  Lattices are told apart by their Hermite normal form: a combination is
+//  a candidate only if it spans a saturated lattice no earlier combination
+//  spanned.  So every saturated lattice with a basis within the bound is
+//  visited exactly once, whatever the magnitude of its HNF basis.
+//
+//  In shell order (rank 1) projection vectors are enumerated by increasing
+//  magnitude: shell r holds the vectors whose largest component has
+//  magnitude r.  Shells are unbounded; the caller decides when to stop.
+//
+//  screen() skips the positions that are not candidates.  For rank 1 it
+//  runs a loop instantiated for the dimension (see DimensionKernel), picked
+//  once when the enumerator is constructed, that steps a local copy of the
+//  index through the positions.
 
 #ifndef __INDEX_ENUMERATOR_H__
 #   define __INDEX_ENUMERATOR_H__
 
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <set>
+#include <algorithm>
+using namespace std;
+
 #include <boost/math/common_factor.hpp>
 
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/io.hpp>
 namespace ublas = boost::numeric::ublas;
 
+// local includes
+#include "dimension-kernels.hpp"
+
 class IndexEnumerator
 {
 
  public:
 
    // constructor
-   IndexEnumerator(int _dimensions, int _maxval) :
-     index ( new ublas::vector<int> (_dimensions) ),
+   //   rank   - number of projection directions (rows of the index)
+   //   shells - enumerate rank 1 vectors shell by shell, ignoring maxval
+   IndexEnumerator(int _dimensions, int _maxval, int _rank = 1,
+                   bool _shells = false) :
+     index (_dimensions * _rank),
      dimensions (_dimensions),
      maxval (_maxval),
-     index_lowerbound ( new ublas::vector<int> (_dimensions) ),
-     index_upperbound ( new ublas::vector<int> (_dimensions) )
+     rank (_rank),
+     shells (_shells)
    {
+     switch (dimensions) {
+       case 2:  screener = &IndexEnumerator::screenDimension<2>; break;
+       case 3:  screener = &IndexEnumerator::screenDimension<3>; break;
+       case 4:  screener = &IndexEnumerator::screenDimension<4>; break;
+       case 5:  screener = &IndexEnumerator::screenDimension<5>; break;
+       case 6:  screener = &IndexEnumerator::screenDimension<6>; break;
+       default: screener = &IndexEnumerator::screenDimension<0>; break;
+     }
+
+     // rank k: projection directions are chosen among the primitive
+     // vectors within the magnitude bound, in the order of the rank 1
+     // enumeration
+     if (rank > 1) {
+       IndexEnumerator directions(dimensions, maxval);
+
+       for (; !directions.end(); directions.incr()) {
+         if (directions.isCandidate()) {
+           vector<int> v(dimensions);
+           for (unsigned int i = 0; i < dimensions; i++) {
+             v[i] = directions.index(i);
+           }
+           vectors.push_back(v);
+         }
+       }
+     }
+
      // initialize indices
      init();
    }
@@ -36,53 +94,89 @@ class IndexEnumerator
    // destructor
    ~IndexEnumerator()
    {
-     delete index;
-     delete index_upperbound;
-     delete index_lowerbound;
    }
    
    // initialize indices
    void init()
    {
-     // initialize upper bound and the first index value
-     for (unsigned int i = 0; i < dimensions; i++) {
-       (*index_lowerbound)(i) = - maxval;
-       (*index_upperbound)(i) = maxval;
+     position = 0;
 
-       (*index)(i) = 0;
+     if (rank > 1) {
+       // first combination of directions
+       combination.resize(rank);
+       for (unsigned int j = 0; j < rank; j++) {
+         combination[j] = j;
+       }
+       exhausted = vectors.size() < rank;
+       lattices.clear();
+
+       setCombinationIndex();
+       return;
      }
-     (*index)(dimensions - 1) = 1;
+
+     if (shells)
+       maxval = 1;
+
+     // initialize the first index value
+     for (unsigned int i = 0; i < dimensions; i++) {
+       index(i) = 0;
+     }
+     index(dimensions - 1) = 1;
    }
 
    // increment index
    void incr()
    {
+     if (rank > 1) {
+       position++;
+       nextCombination();
+       return;
+     }
+
      //
      // increment all indices
      //
 
      // increment last index
-     (*index)(dimensions - 1)++;
+     index(dimensions - 1)++;
+     position++;
 
      // see if we must increment the other indices as well
      for (int i = dimensions-2; i >= 0; i--) {
 
        // if inner index has reached upper bound, reset and increment
        // the next highest index
-       if ((*index)(i + 1) > (*index_upperbound)(i + 1)) {
-         (*index)(i + 1) = (*index_lowerbound)(i + 1);
-         (*index)(i)++;
+       if (index(i + 1) > (int) maxval) {
+         index(i + 1) = - (int) maxval;
+         index(i)++;
        } else {
          break;
        }
      }
+
+     // continue with the next shell
+     if (shells && index(0) > (int) maxval) {
+       maxval++;
+
+       for (unsigned int i = 0; i < dimensions; i++) {
+         index(i) = 0;
+       }
+       index(dimensions - 1) = 1;
+     }
    }
 
    // signal when we've reached the end of index enumeration
    bool end()
    {
+     if (rank > 1)
+       return exhausted;
+
+     // shells never end
+     if (shells)
+       return false;
+
      // done when the first index has reached upper bound
-     if ((*index)(0) > (*index_upperbound)(0))
+     if (index(0) > (int) maxval)
        return true;
      else
        return false;
@@ -91,23 +185,55 @@ class IndexEnumerator
    // return gcd of index elements (ignore 0 elements)
    int gcd()
    {
-     int vecgcd = 0;
-     for (unsigned int i = 0; i < dimensions; i++) {
-       if ((*index)(i) != 0)
-         vecgcd = boost::math::gcd(vecgcd, (*index)(i));
+     return DimensionKernel<0>::gcd(&index(0), dimensions);
+   }
+
+   // is the index a candidate projection?  rank 1: a primitive vector
+   // within the magnitude bound.  rank k: a reduced basis of a saturated
+   // lattice, at the first combination of directions spanning it.
+   bool isCandidate()
+   {
+     if (rank > 1)
+       return firstoflattice;
+
+     // vectors of inner shells were enumerated before
+     if (shells)
+       return gcd() == 1 && shell() == largestMagnitude();
+
+     return gcd() == 1 && !isOverBound();
+   }
+
+   // advance to the next candidate, or to the end of the enumeration.  the
+   // current position is a candidate or is skipped as well.
+   void screen()
+   {
+     if (rank > 1 || shells) {
+       while (!end() && !isCandidate()) {
+         incr();
+       }
+       return;
      }
 
-     return vecgcd;
+     (this->*screener)();
+   }
+
+   // current shell (shell order only)
+   int shell()
+   {
+     return maxval;
+   }
+
+   // largest magnitude of an index element
+   int largestMagnitude()
+   {
+     return DimensionKernel<0>::largestMagnitude(&index(0), dimensions);
    }
 
    // is index magnitude greater than bound?
    bool isOverBound()
    {
      int bound = maxval * maxval;
-     int mag = 0;
-     for (unsigned int i = 0; i < dimensions; i++) {
-       mag += (*index)(i) * (*index)(i);
-     }
+     int mag = DimensionKernel<0>::squaredMagnitude(&index(0), dimensions);
 
      if (mag > bound)
        return true;
@@ -115,14 +241,383 @@ class IndexEnumerator
        return false;
    }
 
-   ublas::vector<int> *index;
+   // move the index to the given position, i.e. the index reached after
+   // position calls to incr() following init()
+   //
+   // indices are digits of a mixed radix number.  the first index ranges
+   // over [0, maxval] and all others over [-maxval, maxval].  rank k
+   // combinations and shells are stepped through.
+   void seek(unsigned long _position)
+   {
+     init();
+
+     if (rank > 1 || shells) {
+       while (position < _position && !end()) {
+         incr();
+       }
+       return;
+     }
+
+     unsigned long base = 2 * maxval + 1;
+
+     // number represented by the initial index, plus the position
+     unsigned long number = 0;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       number = number * base + index(i) + (i ? maxval : 0);
+     }
+     number += _position;
+
+     // convert back to indices
+     for (int i = dimensions - 1; i > 0; i--) {
+       index(i) = (int) (number % base) - (int) maxval;
+       number /= base;
+     }
+     index(0) = (int) number;
+
+     position = _position;
+   }
+
+   // position of a rank 1 vector (first element non-negative, all within
+   // the magnitude bound) in the enumeration order: the inverse of seek()
+   unsigned long positionOf(const ublas::vector<int> &v)
+   {
+     unsigned long base = 2 * maxval + 1;
+
+     // numbers represented by the vector and by the initial index
+     unsigned long number = 0, initial = 0;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       long offset = i ? maxval : 0;
+
+       number  = number * base + v(i) + offset;
+       initial = initial * base + (i == dimensions - 1 ? 1 : 0) + offset;
+     }
+
+     return number - initial;
+   }
+
+   ublas::vector<int> index;
+
+   // number of increments since the index was initialized
+   unsigned long position;
 
 private:
 
+  // rank 1 screening with the kernels of dimension N (0: any dimension).
+  // the positions are stepped through as in incr() on a local copy of the
+  // index, which is written back at a candidate or at the end.
+  template <unsigned int N>
+  void screenDimension()
+  {
+    typedef DimensionKernel<N> Kernel;
+
+    const unsigned int n = Kernel::size(dimensions);
+    const int upper = maxval;
+    const int bound = maxval * maxval;
+
+    int local[N ? N : 1];
+    int *digits = N ? local : &index(0);
+    for (unsigned int i = 0; N && i < n; i++) {
+      digits[i] = index(i);
+    }
+
+    unsigned long steps = 0;
+    while (digits[0] <= upper) {
+      // the magnitude is cheaper than the gcd, and rejects most positions
+      if (Kernel::squaredMagnitude(digits, n) <= bound &&
+            Kernel::gcd(digits, n) == 1)
+        break;
+
+      digits[n - 1]++;
+      for (int i = n - 2; i >= 0 && digits[i + 1] > upper; i--) {
+        digits[i + 1] = - upper;
+        digits[i]++;
+      }
+
+      steps++;
+    }
+
+    for (unsigned int i = 0; N && i < n; i++) {
+      index(i) = digits[i];
+    }
+    position += steps;
+  }
+
+  // copy the current combination of directions into the index.  if the
+  // directions span a saturated lattice, replace them by a reduced basis
+  // and note whether the lattice is seen for the first time.
+  void setCombinationIndex()
+  {
+    firstoflattice = false;
+
+    if (exhausted)
+      return;
+
+    for (unsigned int j = 0; j < rank; j++) {
+      for (unsigned int i = 0; i < dimensions; i++) {
+        index(j * dimensions + i) = vectors[combination[j]][i];
+      }
+    }
+
+    if (minorsGCD() != 1)
+      return;
+
+    reduceBasis();
+    firstoflattice = lattices.insert(hermiteNormalForm()).second;
+  }
+
+  // advance to the next combination of directions, in lexicographic order
+  void nextCombination()
+  {
+    int j = rank - 1;
+    while (j >= 0 &&
+             combination[j] == vectors.size() - rank + j) {
+      j--;
+    }
+
+    if (j < 0) {
+      exhausted = true;
+      return;
+    }
+
+    combination[j]++;
+    for (unsigned int l = j + 1; l < rank; l++) {
+      combination[l] = combination[l - 1] + 1;
+    }
+
+    setCombinationIndex();
+  }
+
+  // determinant of a small square matrix, by expansion along the first row
+  static long long determinant(vector< vector<long long> > &m)
+  {
+    unsigned int size = m.size();
+
+    if (size == 1)
+      return m[0][0];
+
+    long long det = 0;
+    for (unsigned int c = 0; c < size; c++) {
+      if (m[0][c] == 0)
+        continue;
+
+      vector< vector<long long> > minor(size - 1,
+                                        vector<long long>(size - 1));
+      for (unsigned int r = 1; r < size; r++) {
+        for (unsigned int cc = 0, mc = 0; cc < size; cc++) {
+          if (cc != c)
+            minor[r - 1][mc++] = m[r][cc];
+        }
+      }
+
+      det += (c % 2 ? -1 : 1) * m[0][c] * determinant(minor);
+    }
+
+    return det;
+  }
+
+  // gcd of all k x k minors of the index.  the rows are a basis of a
+  // saturated lattice (the lattice equals its rational span intersected
+  // with Z^n) iff the gcd is 1.  a gcd of 0 means the rows are dependent.
+  long long minorsGCD()
+  {
+    long long g = 0;
+
+    // enumerate column subsets of size k
+    vector<unsigned int> cols(rank);
+    for (unsigned int j = 0; j < rank; j++) {
+      cols[j] = j;
+    }
+
+    for (;;) {
+      vector< vector<long long> > m(rank, vector<long long>(rank));
+      for (unsigned int r = 0; r < rank; r++) {
+        for (unsigned int c = 0; c < rank; c++) {
+          m[r][c] = index(r * dimensions + cols[c]);
+        }
+      }
+
+      long long det = determinant(m);
+      g = boost::math::gcd(g, det < 0 ? -det : det);
+
+      // next column subset
+      int j = rank - 1;
+      while (j >= 0 && cols[j] == dimensions - rank + j) {
+        j--;
+      }
+      if (j < 0)
+        break;
+
+      cols[j]++;
+      for (unsigned int l = j + 1; l < rank; l++) {
+        cols[l] = cols[l - 1] + 1;
+      }
+    }
+
+    return g;
+  }
+
+  // Hermite normal form of the rows of the index: rows in echelon form
+  // with positive pivots, and entries above a pivot reduced to
+  // [0, pivot).  the HNF basis of a lattice is unique.
+  vector< vector<long long> > hermiteNormalForm()
+  {
+    vector< vector<long long> > h(rank, vector<long long>(dimensions));
+    for (unsigned int r = 0; r < rank; r++) {
+      for (unsigned int c = 0; c < dimensions; c++) {
+        h[r][c] = index(r * dimensions + c);
+      }
+    }
+
+    unsigned int row = 0;
+    for (unsigned int c = 0; c < dimensions && row < rank; c++) {
+      // euclid on column c over the rows not yet in echelon form
+      for (;;) {
+        int pivot = -1;
+        for (unsigned int r = row; r < rank; r++) {
+          if (h[r][c] != 0 &&
+                (pivot < 0 || llabs(h[r][c]) < llabs(h[pivot][c])))
+            pivot = r;
+        }
+
+        if (pivot < 0)
+          break;
+
+        swap(h[row], h[pivot]);
+
+        bool reduced = true;
+        for (unsigned int r = row + 1; r < rank; r++) {
+          long long q = h[r][c] / h[row][c];
+          for (unsigned int cc = 0; cc < dimensions; cc++) {
+            h[r][cc] -= q * h[row][cc];
+          }
+          if (h[r][c] != 0)
+            reduced = false;
+        }
+
+        if (reduced)
+          break;
+      }
+
+      if (h[row][c] == 0)
+        continue;
+
+      // positive pivot
+      if (h[row][c] < 0) {
+        for (unsigned int cc = 0; cc < dimensions; cc++) {
+          h[row][cc] = -h[row][cc];
+        }
+      }
+
+      // reduce entries above the pivot
+      for (unsigned int r = 0; r < row; r++) {
+        long long q = h[r][c] / h[row][c];
+        if (h[r][c] - q * h[row][c] < 0)
+          q--;
+        for (unsigned int cc = 0; cc < dimensions; cc++) {
+          h[r][cc] -= q * h[row][cc];
+        }
+      }
+
+      row++;
+    }
+
+    return h;
+  }
+
+  // reduce the rows of the index: subtract from each row the nearest
+  // integer multiple of another row while that shortens it.  rows never
+  // get longer, so they stay within the magnitude bound, and the lattice
+  // is unchanged.  rows are then signed with a positive leading element
+  // and sorted by length.
+  void reduceBasis()
+  {
+    vector< vector<long long> > b(rank, vector<long long>(dimensions));
+    for (unsigned int r = 0; r < rank; r++) {
+      for (unsigned int c = 0; c < dimensions; c++) {
+        b[r][c] = index(r * dimensions + c);
+      }
+    }
+
+    // each change shortens a row, so this terminates
+    for (bool changed = true; changed; ) {
+      changed = false;
+
+      for (unsigned int r = 0; r < rank; r++) {
+        for (unsigned int o = 0; o < rank; o++) {
+          if (o == r)
+            continue;
+
+          long long dot = 0, norm = 0;
+          for (unsigned int c = 0; c < dimensions; c++) {
+            dot  += b[r][c] * b[o][c];
+            norm += b[o][c] * b[o][c];
+          }
+
+          long long q = (long long) floor((double) dot / norm + 0.5);
+          if (q == 0 || q * q * norm - 2 * q * dot >= 0)
+            continue;
+
+          for (unsigned int c = 0; c < dimensions; c++) {
+            b[r][c] -= q * b[o][c];
+          }
+          changed = true;
+        }
+      }
+    }
+
+    for (unsigned int r = 0; r < rank; r++) {
+      unsigned int c = 0;
+      while (b[r][c] == 0) {
+        c++;
+      }
+      if (b[r][c] < 0) {
+        for (c = 0; c < dimensions; c++) {
+          b[r][c] = -b[r][c];
+        }
+      }
+    }
+
+    sort(b.begin(), b.end(), shorter);
+
+    for (unsigned int r = 0; r < rank; r++) {
+      for (unsigned int c = 0; c < dimensions; c++) {
+        index(r * dimensions + c) = (int) b[r][c];
+      }
+    }
+  }
+
+  // order rows by squared length, then lexicographically
+  static bool shorter(const vector<long long> &a, const vector<long long> &b)
+  {
+    long long na = 0, nb = 0;
+    for (unsigned int c = 0; c < a.size(); c++) {
+      na += a[c] * a[c];
+      nb += b[c] * b[c];
+    }
+
+    if (na != nb)
+      return na < nb;
+
+    return a < b;
+  }
+
   unsigned int dimensions;
   unsigned int maxval;
-  ublas::vector<int> *index_lowerbound;
-  ublas::vector<int> *index_upperbound;
+  unsigned int rank;
+  bool shells;
+
+  // rank 1 screening loop of the dimension
+  void (IndexEnumerator::*screener)();
+
+  // rank k: candidate directions and the current combination of them
+  vector< vector<int> > vectors;
+  vector< unsigned int > combination;
+  bool exhausted;
+
+  // rank k: HNF bases of the lattices spanned so far, and whether the
+  // current combination is the first to span its lattice
+  std::set< vector< vector<long long> > > lattices;
+  bool firstoflattice;
 
 };
 
@@ -0,0 +1,652 @@
+//  kernel-generator.hpp
+//
+//  Generate a multithreaded C++ kernel that executes a recurrence in the
+//  order of a space-time mapping.
+//
+//  For a projection vector u with schedule \lambda and allocation A, the
+//  points of the domain are renumbered y = T x, with T the schedule
+//  followed by the rows of the allocation:  y_0 is the time step and
+//  y_1..y_{n-1} the PE.  The transformed domain (the preimage of the domain
+//  under T^-1) is scanned by polylib (Polyhedron_Scan) into loop bounds that
+//  are affine in the outer loops and the parameters, and written as
+//
+//    #pragma omp parallel
+//    for t                         time steps, run by every thread
+//      #pragma omp for             PEs, shared by the threads; the implicit
+//      for p1                      barrier ends the time step
+//        for p2 ...                remaining PE coordinates, the innermost
+//                                  loop a SIMD loop
+//          x = T^-1 (t, p1, ...)
+//          STATEMENT(x)
+//
+//  Points computed in one time step depend only on earlier steps, since the
+//  schedule gives every dependency a delay of at least one.  If T is not
+//  unimodular, (t, p) points with no integer preimage are skipped.
+//
+//  The kernel comes with a harness that runs a max-plus recurrence with the
+//  dependencies of the polyhedron, e.g. the sw and nussinov recurrences,
+//  checks the threaded result against a single threaded run and reports
+//  cell updates per second.  With KERNEL_NO_HARNESS defined, the includer
+//  defines STATEMENT and runs kernel().
+
+#ifndef __KERNEL_GENERATOR_H__
+#   define __KERNEL_GENERATOR_H__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+using namespace std;
+
+#include <polylib/polylibgmp.h>
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+
+class KernelGenerator
+{
+
+ public:
+
+   // constructor
+   //   domain, context - PIP constraints of the polyhedron
+   //   dependencies    - dependencies of the polyhedron
+   // throws DSEError if the projection is not of rank 1 or its schedule and
+   // allocation are not independent
+   KernelGenerator(PipMatrix *_domain, PipMatrix *_context,
+                   PipMatrix *_dependencies,
+                   unsigned int _dimensions, unsigned int _parameters,
+                   vector< string > *_parameternames,
+                   vector< int > *_parameterinstantiations,
+                   ProjectionSolution *ps) :
+     domain (_domain),
+     context (_context),
+     dependencies (_dependencies),
+     dimensions (_dimensions),
+     parameters (_parameters),
+     parameternames (_parameternames),
+     parameterinstantiations (_parameterinstantiations),
+     T (_dimensions, vector< long long >(_dimensions)),
+     adjugate (_dimensions, vector< long long >(_dimensions))
+   {
+     if (ps->rank != 1) {
+       throw DSEError("Kernels are generated for projections of rank 1 only");
+     }
+
+     // change of basis: schedule, then allocation
+     for (unsigned int j = 0; j < dimensions; j++) {
+       T[0][j] = ps->schedule[j];
+     }
+     for (unsigned int i = 1; i < dimensions; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         T[i][j] = ps->allocationElement(i - 1, j);
+       }
+     }
+
+     det = determinant(T);
+
+     if (det == 0) {
+       throw DSEError("Schedule and allocation are not independent");
+     }
+
+     // adjugate: T^-1 = adjugate / det
+     for (unsigned int i = 0; i < dimensions; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         adjugate[i][j] = ((i + j) % 2 ? -1 : 1) * determinant(minor(T, j, i));
+       }
+     }
+   }
+
+   // destructor
+   ~KernelGenerator()
+   {
+   }
+
+   // write the kernel and harness as a C++ source file
+   void generate(ostream &os)
+   {
+     os << "// space-time kernel" << endl
+        << "//" << endl
+        << "//   time " << affine(T[0], "x") << endl;
+     for (unsigned int i = 1; i < dimensions; i++) {
+       os << "//   PE " << i << "   " << affine(T[i], "x") << endl;
+     }
+     os << endl;
+
+     os << "#include <cstdio>" << endl
+        << "#include <cstdlib>" << endl
+        << "#include <vector>" << endl
+        << "#include <omp.h>" << endl
+        << endl
+        << "static inline long floord(long n, long d)" << endl
+        << "{ return n >= 0 ? n / d : - ((-n + d - 1) / d); }" << endl
+        << "static inline long ceild(long n, long d)" << endl
+        << "{ return - floord(-n, d); }" << endl
+        << "static inline long max(long a, long b) { return a > b ? a : b; }" << endl
+        << "static inline long min(long a, long b) { return a < b ? a : b; }" << endl
+        << endl;
+
+     // parameters
+     for (unsigned int i = 0; i < parameters; i++) {
+       os << "static long " << (*parameternames)[i] << " = "
+          << (*parameterinstantiations)[i] << ";" << endl;
+     }
+     os << endl;
+
+     generateStatement(os);
+     generateKernel(os);
+     generateHarness(os);
+   }
+
+ private:
+
+   //
+   // kernel: scan of the transformed domain, time outermost
+   //
+   void generateKernel(ostream &os)
+   {
+     vector< vector< Row > > levels = transformedLoops();
+
+     os << "#ifndef STATEMENT" << endl
+        << "#  error \"define STATEMENT(" << variables("x") << ")\"" << endl
+        << "#endif" << endl
+        << endl
+        << "void kernel()" << endl
+        << "{" << endl
+        << "#pragma omp parallel" << endl;
+
+     string indent = "  ";
+
+     for (unsigned int i = 0; i < dimensions; i++) {
+       string y = loopVariable(i);
+
+       if (i == 1) {
+         os << indent << "#pragma omp for schedule(static)" << endl;
+       } else if (i == dimensions - 1 && dimensions > 2) {
+         os << indent << "#pragma omp simd" << endl;
+       }
+
+       os << indent << "for (long " << y << " = " << bounds(levels[i], i, true)
+          << "; " << y << " <= " << bounds(levels[i], i, false)
+          << "; " << y << "++) {" << endl;
+
+       indent += "  ";
+     }
+
+     // preimage of the (t, p) point
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << indent << "long x" << i << " = "
+          << affine(adjugate[i], "", true) << ";" << endl;
+     }
+
+     if (llabs (det) != 1) {
+       os << indent << "if (";
+       for (unsigned int i = 0; i < dimensions; i++) {
+         os << (i ? " || " : "") << "x" << i << " % " << llabs (det);
+       }
+       os << ") continue;" << endl;
+     }
+
+     for (unsigned int i = 0; i < dimensions; i++) {
+       if (det != 1)
+         os << indent << "x" << i << " /= " << det << ";" << endl;
+     }
+
+     os << indent << "STATEMENT(" << variables("x") << ");" << endl;
+
+     for (unsigned int i = dimensions; i > 0; i--) {
+       indent.erase(0, 2);
+       os << indent << "}" << endl;
+     }
+
+     os << "}" << endl
+        << endl;
+   }
+
+   //
+   // statement of the harness: max-plus recurrence over the dependencies,
+   // storage over the bounding box of the domain
+   //
+   void generateStatement(ostream &os)
+   {
+     string xs = variables("x");
+
+     os << "#ifndef KERNEL_NO_HARNESS" << endl
+        << endl
+        << "static long lo[" << dimensions << "], extent["
+        << dimensions << "];" << endl
+        << "static std::vector< int > V;" << endl
+        << endl;
+
+     // domain membership
+     os << "static inline bool inDomain(" << variables("long x") << ")" << endl
+        << "{" << endl
+        << "  return ";
+     for (unsigned int r = 0; r < domain->NbRows; r++) {
+       vector< long long > c(dimensions + parameters + 1);
+       for (unsigned int j = 0; j < c.size(); j++) {
+         c[j] = VALUE_TO_INT( domain->p[r][1 + j] );
+       }
+
+       os << (r ? " &&\n         " : "") << "("
+          << domainAffine(c) << (VALUE_TO_INT( domain->p[r][0] ) ? " >= 0" : " == 0")
+          << ")";
+     }
+     os << ";" << endl
+        << "}" << endl
+        << endl;
+
+     // storage index
+     os << "static inline long cell(" << variables("long x") << ")" << endl
+        << "{" << endl
+        << "  return ";
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << (i ? " + extent[" + str(i - 1) + "] * (" : "(")
+          << "x" << i << " - lo[" << i << "]";
+     }
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << ")";
+     }
+     os << ";" << endl
+        << "}" << endl
+        << endl;
+
+     // statement: max-plus over the dependencies with pseudo random weights
+     os << "#define STATEMENT(" << xs << ") update(" << xs << ")" << endl
+        << endl
+        << "static inline void update(" << variables("long x") << ")" << endl
+        << "{" << endl
+        << "  int v = 0;" << endl;
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       ostringstream shifted;
+       for (unsigned int j = 0; j < dimensions; j++) {
+         long long d = VALUE_TO_INT( dependencies->p[k][j] );
+         shifted << (j ? ", " : "") << "x" << j;
+         if (d != 0)
+           shifted << (d > 0 ? " + " : " - ") << llabs (d);
+       }
+
+       os << "  if (inDomain(" << shifted.str() << "))" << endl
+          << "    v = max(v, V[cell(" << shifted.str() << ")] + (int) ((";
+       for (unsigned int j = 0; j < dimensions; j++) {
+         os << (j ? " + " : "") << (2 * j + 3) << " * x" << j;
+       }
+       os << " + " << k << ") % 5) - 2);" << endl;
+     }
+     os << "  V[cell(" << xs << ")] = v;" << endl
+        << "}" << endl
+        << endl
+        << "#endif // KERNEL_NO_HARNESS" << endl
+        << endl;
+   }
+
+   //
+   // harness: bounding box of the domain, a single threaded reference run
+   // and the timed run
+   //
+   void generateHarness(ostream &os)
+   {
+     os << "#ifndef KERNEL_NO_HARNESS" << endl
+        << endl;
+
+     os << "int main(int argc, char **argv)" << endl
+        << "{" << endl;
+     for (unsigned int i = 0; i < parameters; i++) {
+       os << "  if (argc > " << i + 1 << ") "
+          << (*parameternames)[i] << " = atol(argv[" << i + 1 << "]);" << endl;
+     }
+     os << endl;
+
+     // bounding box by scanning the domain
+     os << "  long cells = 0;" << endl
+        << "  long hi[" << dimensions << "];" << endl
+        << "  for (int i = 0; i < " << dimensions << "; i++) { lo[i] = 1L << 62; hi[i] = -(1L << 62); }" << endl;
+
+     vector< vector< Row > > levels = domainLoops();
+     string indent = "  ";
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << indent << "for (long x" << i << " = " << bounds(levels[i], i, true, "x")
+          << "; x" << i << " <= " << bounds(levels[i], i, false, "x")
+          << "; x" << i << "++) {" << endl;
+       indent += "  ";
+     }
+     os << indent << "cells++;" << endl;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << indent << "lo[" << i << "] = min(lo[" << i << "], x" << i
+          << "); hi[" << i << "] = max(hi[" << i << "], x" << i << ");" << endl;
+     }
+     for (unsigned int i = dimensions; i > 0; i--) {
+       indent.erase(0, 2);
+       os << indent << "}" << endl;
+     }
+
+     os << endl
+        << "  long size = 1;" << endl
+        << "  for (int i = 0; i < " << dimensions << "; i++) {" << endl
+        << "    extent[i] = hi[i] - lo[i] + 1;" << endl
+        << "    size *= extent[i];" << endl
+        << "  }" << endl
+        << endl
+        << "  // single threaded reference" << endl
+        << "  int threads = omp_get_max_threads();" << endl
+        << "  omp_set_num_threads(1);" << endl
+        << "  V.assign(size, 0);" << endl
+        << "  kernel();" << endl
+        << "  std::vector< int > reference(V);" << endl
+        << endl
+        << "  omp_set_num_threads(threads);" << endl
+        << "  V.assign(size, 0);" << endl
+        << "  double start = omp_get_wtime();" << endl
+        << "  kernel();" << endl
+        << "  double seconds = omp_get_wtime() - start;" << endl
+        << endl
+        << "  bool match = V == reference;" << endl
+        << "  printf(\"cells %ld threads %d seconds %.3f cell updates/s %.3e %s\\n\"," << endl
+        << "         cells, threads, seconds, cells / seconds," << endl
+        << "         match ? \"ok\" : \"MISMATCH\");" << endl
+        << endl
+        << "  return match ? 0 : 1;" << endl
+        << "}" << endl
+        << endl
+        << "#endif // KERNEL_NO_HARNESS" << endl;
+   }
+
+   // constraint of a loop level over the loop variables, parameters and
+   // constant
+   struct Row
+   {
+     bool equality;
+     vector< long long > coeff;
+   };
+
+   //
+   // loop bounds of the transformed domain.  a constraint a x + b >= 0 of
+   // the domain, with x = adj y / det, becomes sign(det) a adj y + |det| b
+   // >= 0.
+   //
+   vector< vector< Row > > transformedLoops()
+   {
+     unsigned int columns = dimensions + parameters + 2;
+     Matrix *constraints = Matrix_Alloc( domain->NbRows, columns );
+     long long sign = det > 0 ? 1 : -1;
+
+     for (unsigned int r = 0; r < domain->NbRows; r++) {
+       value_assign (constraints->p[r][0], domain->p[r][0]);
+
+       for (unsigned int j = 0; j < dimensions; j++) {
+         long long c = 0;
+         for (unsigned int k = 0; k < dimensions; k++) {
+           c += VALUE_TO_INT( domain->p[r][1 + k] ) * adjugate[k][j];
+         }
+         value_set_si (constraints->p[r][1 + j], sign * c);
+       }
+
+       for (unsigned int j = dimensions + 1; j < columns; j++) {
+         value_set_si (constraints->p[r][j],
+                       llabs (det) * VALUE_TO_INT( domain->p[r][j] ));
+       }
+     }
+
+     vector< vector< Row > > levels = scan(constraints);
+     Matrix_Free (constraints);
+
+     return levels;
+   }
+
+   // loop bounds of the domain
+   vector< vector< Row > > domainLoops()
+   {
+     Matrix *constraints = Matrix_Alloc( domain->NbRows, domain->NbColumns );
+
+     for (unsigned int r = 0; r < domain->NbRows; r++) {
+       for (unsigned int j = 0; j < domain->NbColumns; j++) {
+         value_assign (constraints->p[r][j], domain->p[r][j]);
+       }
+     }
+
+     vector< vector< Row > > levels = scan(constraints);
+     Matrix_Free (constraints);
+
+     return levels;
+   }
+
+   // split constraints into loop levels in the context of the parameters
+   vector< vector< Row > > scan(Matrix *constraints)
+   {
+     Matrix *ctx = Matrix_Alloc( context->NbRows, context->NbColumns );
+     for (unsigned int r = 0; r < context->NbRows; r++) {
+       for (unsigned int j = 0; j < context->NbColumns; j++) {
+         value_assign (ctx->p[r][j], context->p[r][j]);
+       }
+     }
+
+     Polyhedron *D = Constraints2Polyhedron (constraints, 256);
+     Polyhedron *C = Constraints2Polyhedron (ctx, 256);
+     Matrix_Free (ctx);
+
+     Polyhedron *scanned = Polyhedron_Scan (D, C, 256);
+
+     Polyhedron_Free (D);
+     Polyhedron_Free (C);
+
+     if (!scanned) {
+       throw DSEError("Failed to scan the domain");
+     }
+
+     vector< vector< Row > > levels(dimensions);
+     Polyhedron *level = scanned;
+     for (unsigned int i = 0; i < dimensions && level; i++) {
+       for (unsigned int r = 0; r < level->NbConstraints; r++) {
+         Row row;
+         row.equality = value_zero_p (level->Constraint[r][0]);
+
+         for (unsigned int j = 0; j <= dimensions + parameters; j++) {
+           row.coeff.push_back( VALUE_TO_INT( level->Constraint[r][1 + j] ) );
+         }
+
+         levels[i].push_back(row);
+       }
+
+       level = level->next;
+     }
+
+     Domain_Free (scanned);
+
+     return levels;
+   }
+
+   //
+   // lower (or upper) bound of loop i: the largest lower bound (smallest
+   // upper bound) of the constraints on it
+   //
+   string bounds(const vector< Row > &rows, unsigned int i, bool lower,
+                 const string &prefix = "")
+   {
+     vector< string > terms;
+
+     for (unsigned int r = 0; r < rows.size(); r++) {
+       long long a = rows[r].coeff[i];
+
+       if (a == 0 || (!rows[r].equality && (a > 0) != lower))
+         continue;
+
+       // a y_i + rest >= 0:  y_i >= -rest / a  or  y_i <= rest / -a
+       vector< long long > rest(rows[r].coeff);
+       rest[i] = 0;
+
+       if (a > 0) {
+         for (unsigned int j = 0; j < rest.size(); j++) {
+           rest[j] = -rest[j];
+         }
+       } else {
+         a = -a;
+       }
+
+       string e = prefix.empty() ? loopAffine(rest) : domainAffine(rest);
+       if (a != 1)
+         e = string(lower ? "ceild(" : "floord(") + e + ", " + str(a) + ")";
+
+       terms.push_back(e);
+     }
+
+     if (terms.empty()) {
+       throw DSEError("Domain scan has an unbounded loop");
+     }
+
+     string b = terms[0];
+     for (unsigned int t = 1; t < terms.size(); t++) {
+       b = string(lower ? "max(" : "min(") + b + ", " + terms[t] + ")";
+     }
+
+     return b;
+   }
+
+   // affine expression over loop variables, parameters and the constant
+   string loopAffine(const vector< long long > &c)
+   {
+     vector< string > names;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       names.push_back(loopVariable(i));
+     }
+     return combination(c, names);
+   }
+
+   // affine expression over domain coordinates, parameters and the
+   // constant
+   string domainAffine(const vector< long long > &c)
+   {
+     vector< string > names;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       names.push_back("x" + str(i));
+     }
+     return combination(c, names);
+   }
+
+   // linear expression of a row of T or of the adjugate
+   string affine(const vector< long long > &c, const string &prefix,
+                 bool loop = false)
+   {
+     vector< string > names;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       names.push_back(loop ? loopVariable(i) : prefix + str(i));
+     }
+
+     vector< long long > cc(c);
+     cc.resize(dimensions + parameters + 1, 0);
+
+     return combination(cc, names);
+   }
+
+   // text of c_0 v_0 + ... + c_{n-1} v_{n-1} + c_n N_1 + ... + constant
+   string combination(const vector< long long > &c, vector< string > names)
+   {
+     for (unsigned int i = 0; i < parameters; i++) {
+       names.push_back((*parameternames)[i]);
+     }
+
+     ostringstream e;
+     bool first = true;
+
+     for (unsigned int j = 0; j < names.size(); j++) {
+       if (c[j] == 0)
+         continue;
+
+       e << (c[j] < 0 ? (first ? "-" : " - ") : (first ? "" : " + "));
+       if (llabs (c[j]) != 1)
+         e << llabs (c[j]) << "*";
+       e << names[j];
+       first = false;
+     }
+
+     long long constant = c[names.size()];
+     if (constant != 0 || first) {
+       e << (constant < 0 ? (first ? "-" : " - ") : (first ? "" : " + "))
+         << llabs (constant);
+     }
+
+     return e.str();
+   }
+
+   // name of loop variable i: time, then PE coordinates
+   string loopVariable(unsigned int i)
+   {
+     return i == 0 ? string("t") : "p" + str(i);
+   }
+
+   // comma separated x0, x1, ... with a prefix
+   string variables(const string &prefix)
+   {
+     string v;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       v += (i ? ", " : "") + prefix + str(i);
+     }
+     return v;
+   }
+
+   static string str(long long v)
+   {
+     ostringstream s;
+     s << v;
+     return s.str();
+   }
+
+   // matrix without row r and column c
+   static vector< vector< long long > > minor(
+                         const vector< vector< long long > > &m,
+                         unsigned int r, unsigned int c)
+   {
+     vector< vector< long long > > n;
+
+     for (unsigned int i = 0; i < m.size(); i++) {
+       if (i == r)
+         continue;
+
+       vector< long long > row;
+       for (unsigned int j = 0; j < m.size(); j++) {
+         if (j != c)
+           row.push_back(m[i][j]);
+       }
+       n.push_back(row);
+     }
+
+     return n;
+   }
+
+   // determinant by cofactor expansion (small matrices)
+   static long long determinant(const vector< vector< long long > > &m)
+   {
+     if (m.empty())
+       return 1;
+
+     long long d = 0;
+     for (unsigned int j = 0; j < m.size(); j++) {
+       if (m[0][j] != 0)
+         d += (j % 2 ? -1 : 1) * m[0][j] * determinant(minor(m, 0, j));
+     }
+
+     return d;
+   }
+
+   PipMatrix *domain;
+   PipMatrix *context;
+   PipMatrix *dependencies;
+
+   unsigned int dimensions;
+   unsigned int parameters;
+   vector< string > *parameternames;
+   vector< int > *parameterinstantiations;
+
+   // change of basis (schedule and allocation), its adjugate and
+   // determinant
+   vector< vector< long long > > T;
+   vector< vector< long long > > adjugate;
+   long long det;
+
+};
+
+#endif // __KERNEL_GENERATOR_H__
@@ -0,0 +1,465 @@
+//  local-search.hpp
+//
+//  Stochastic local search over primitive projection vectors, for domains
+//  whose enumeration at a useful magnitude bound is out of reach.
+//
+//  Several chains walk between neighboring vectors: a vector is perturbed by
+//  small integer steps and divided by the gcd of its elements.  Each chain
+//  follows one of the methods
+//
+//    anneal          simulated annealing on one random neighbor per step
+//    tabu            move to the best neighbor not visited recently
+//    random-restart  hill climbing, restarting from a random vector at a
+//                    local optimum
+//
+//  The search only proposes vectors; the caller evaluates them and reports
+//  the solutions.  Scores of visited vectors are memoized and shared by all
+//  chains.  Each chain draws from its own generator seeded with the search
+//  seed and its number, so chains follow the same path however their
+//  evaluations are interleaved.
+
+#ifndef __LOCAL_SEARCH_H__
+#   define __LOCAL_SEARCH_H__
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <deque>
+#include <string>
+#include <vector>
+#include <sstream>
+using namespace std;
+
+#include <boost/math/common_factor.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "projection-solution.hpp"
+
+class LocalSearch
+{
+
+ public:
+
+   // search methods
+   enum Method {
+     ANNEAL = 0,
+     TABU,
+     RANDOM_RESTART
+   };
+
+   // constructor
+   //   maxval         - bound on the magnitude of the projection vectors
+   //   chains         - number of chains
+   //   steps          - moves made by each chain
+   //   peinefficiency - solutions above this utilization score as failures
+   LocalSearch(Method _method, unsigned int _dimensions, int _maxval,
+               unsigned int chains, unsigned int _steps, unsigned long seed,
+               int _peinefficiency) :
+     method (_method),
+     dimensions (_dimensions),
+     maxval (_maxval),
+     steps (_steps),
+     peinefficiency (_peinefficiency),
+     chain (chains),
+     evaluated (0)
+   {
+     for (unsigned int c = 0; c < chains; c++) {
+       chain[c].rng.seed ((unsigned int) (seed + c));
+       chain[c].step = 0;
+       chain[c].hasCurrent = false;
+       chain[c].finished = false;
+
+       // final temperature is a hundredth of the initial one
+       chain[c].temperature = 0.1;
+
+       restart(chain[c]);
+     }
+   }
+
+   // destructor
+   ~LocalSearch()
+   {
+   }
+
+   // name of a search method, or -1 if unknown
+   static int methodOf(const string &name)
+   {
+     if (name == "anneal")
+       return ANNEAL;
+     if (name == "tabu")
+       return TABU;
+     if (name == "random-restart")
+       return RANDOM_RESTART;
+
+     return -1;
+   }
+
+   // next vector to evaluate.  returns false if every proposed vector is
+   // evaluated or being evaluated.
+   bool next(ublas::vector<int> &v)
+   {
+     for (unsigned int c = 0; c < chain.size(); c++) {
+       Chain &ch = chain[c];
+
+       while (!ch.request.empty()) {
+         vector< int > u = ch.request.front();
+         ch.request.pop_front();
+
+         string key = vectorKey(u);
+
+         // proposed by another chain in the meantime
+         if (visited.count(key) || inflight.count(key))
+           continue;
+
+         inflight.insert(key);
+
+         v.resize(dimensions);
+         for (unsigned int i = 0; i < dimensions; i++) {
+           v(i) = u[i];
+         }
+
+         return true;
+       }
+     }
+
+     return false;
+   }
+
+   // report the solution of a vector returned by next()
+   void result(const ublas::vector<int> &v, ProjectionSolution *ps)
+   {
+     vector< int > u(v.begin(), v.end());
+     string key = vectorKey(u);
+
+     inflight.erase(key);
+     visited[key] = score(ps);
+     evaluated++;
+
+     // chains waiting for this vector
+     for (unsigned int c = 0; c < chain.size(); c++) {
+       Chain &ch = chain[c];
+
+       if (ch.waiting.erase(key) && ch.waiting.empty())
+         advance(ch);
+     }
+   }
+
+   // all chains made their moves
+   bool done()
+   {
+     for (unsigned int c = 0; c < chain.size(); c++) {
+       if (!chain[c].finished)
+         return false;
+     }
+
+     return true;
+   }
+
+   // number of vectors evaluated
+   unsigned long evaluatedVectors()
+   {
+     return evaluated;
+   }
+
+ private:
+
+   // state of one chain
+   struct Chain
+   {
+     boost::mt19937 rng;
+
+     // current vector and its score
+     vector< int > current;
+     double currentScore;
+     bool hasCurrent;
+
+     // vectors proposed by the current step: not yet handed out, and not
+     // yet scored
+     vector< vector< int > > proposals;
+     deque< vector< int > > request;
+     std::set< string > waiting;
+
+     // recently visited vectors (tabu)
+     deque< string > tabu;
+
+     unsigned int step;
+     double temperature;
+     bool finished;
+   };
+
+   //
+   // score of a solution: larger is better.  ordered as the solutions are
+   // ranked, by instance BPP and then by fewer PEs.  failed candidates and
+   // candidates above the inefficiency bound score -1.
+   //
+   double score(ProjectionSolution *ps)
+   {
+     if (ps->status != ProjectionSolution::OK ||
+           (int) ps->utilization > peinefficiency)
+       return -1;
+
+     return ps->instance_bpp + 1.0 / (2.0 + ps->instance_pe_count);
+   }
+
+   // uniform random number in [0, n)
+   static unsigned int uniform(Chain &ch, unsigned int n)
+   {
+     return ch.rng() % n;
+   }
+
+   // divide by the gcd of the elements and make the first non-zero element
+   // positive.  returns false for the zero vector and vectors over the
+   // magnitude bound.
+   bool normalize(vector< int > &u)
+   {
+     int g = 0;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       if (u[i] != 0)
+         g = boost::math::gcd(g, abs(u[i]));
+     }
+
+     if (g == 0)
+       return false;
+
+     int sign = 0;
+     int mag = 0;
+     for (unsigned int i = 0; i < dimensions; i++) {
+       u[i] /= g;
+
+       if (sign == 0 && u[i] != 0)
+         sign = u[i] > 0 ? 1 : -1;
+
+       u[i] *= sign == 0 ? 1 : sign;
+       mag += u[i] * u[i];
+     }
+
+     return mag <= maxval * maxval;
+   }
+
+   // random primitive vector within the magnitude bound
+   vector< int > randomVector(Chain &ch)
+   {
+     vector< int > u(dimensions);
+
+     do {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         u[i] = (int) uniform(ch, 2 * maxval + 1) - maxval;
+       }
+     } while (!normalize(u));
+
+     return u;
+   }
+
+   // all vectors one unit step away
+   vector< vector< int > > neighbors(const vector< int > &u)
+   {
+     vector< vector< int > > nbrs;
+     std::set< string > seen;
+
+     seen.insert(vectorKey(u));
+
+     for (unsigned int i = 0; i < dimensions; i++) {
+       for (int d = -1; d <= 1; d += 2) {
+         vector< int > w(u);
+         w[i] += d;
+
+         if (normalize(w) && seen.insert(vectorKey(w)).second)
+           nbrs.push_back(w);
+       }
+     }
+
+     return nbrs;
+   }
+
+   // random neighbor: one or two elements perturbed by one unit
+   vector< int > randomNeighbor(Chain &ch, const vector< int > &u)
+   {
+     for (int attempt = 0; attempt < 32; attempt++) {
+       vector< int > w(u);
+
+       unsigned int changes = 1 + uniform(ch, 2);
+       for (unsigned int k = 0; k < changes; k++) {
+         w[uniform(ch, dimensions)] += uniform(ch, 2) ? 1 : -1;
+       }
+
+       if (normalize(w) && w != u)
+         return w;
+     }
+
+     // no neighbor within the bound, jump
+     return randomVector(ch);
+   }
+
+   // propose vectors for the next step of a chain
+   void propose(Chain &ch, const vector< vector< int > > &proposals)
+   {
+     ch.proposals = proposals;
+
+     for (unsigned int p = 0; p < proposals.size(); p++) {
+       string key = vectorKey(proposals[p]);
+
+       if (visited.count(key))
+         continue;
+
+       ch.waiting.insert(key);
+
+       if (!inflight.count(key))
+         ch.request.push_back(proposals[p]);
+     }
+   }
+
+   // restart a chain from a random vector
+   void restart(Chain &ch)
+   {
+     ch.hasCurrent = false;
+     propose(ch, vector< vector< int > >(1, randomVector(ch)));
+   }
+
+   //
+   // all proposals of a chain are scored: move and propose the next step.
+   // steps whose proposals were all visited before are taken at once.
+   //
+   void advance(Chain &ch)
+   {
+     while (!ch.finished && ch.waiting.empty()) {
+       // starting point
+       if (!ch.hasCurrent) {
+         ch.current = ch.proposals[0];
+         ch.currentScore = visited[vectorKey(ch.current)];
+         ch.hasCurrent = true;
+       } else {
+         move(ch);
+       }
+
+       if (++ch.step >= steps) {
+         ch.finished = true;
+         return;
+       }
+
+       if (!ch.hasCurrent) {
+         restart(ch);
+       } else if (method == ANNEAL) {
+         propose(ch,
+                 vector< vector< int > >(1, randomNeighbor(ch, ch.current)));
+       } else {
+         vector< vector< int > > nbrs = neighbors(ch.current);
+
+         if (nbrs.empty())
+           restart(ch);
+         else
+           propose(ch, nbrs);
+       }
+     }
+   }
+
+   // choose the next vector of a chain among its scored proposals
+   void move(Chain &ch)
+   {
+     switch (method) {
+       case ANNEAL: {
+         const vector< int > &w = ch.proposals[0];
+         double s = visited[vectorKey(w)];
+
+         // accept improvements, and worse vectors with a probability that
+         // falls with the temperature
+         double delta = (ch.currentScore - s) /
+                          max(1.0, fabs(ch.currentScore));
+         double r = ch.rng() / 4294967296.0;
+
+         if (delta <= 0 || r < exp(-delta / ch.temperature)) {
+           ch.current = w;
+           ch.currentScore = s;
+         }
+
+         ch.temperature *= pow(0.01, 1.0 / max(1u, steps));
+         break;
+       }
+
+       case TABU: {
+         ch.tabu.push_back(vectorKey(ch.current));
+         if (ch.tabu.size() > 2 * dimensions)
+           ch.tabu.pop_front();
+
+         // best neighbor not visited recently, even if worse
+         int best = -1;
+         double bestScore = 0;
+         for (unsigned int p = 0; p < ch.proposals.size(); p++) {
+           string key = vectorKey(ch.proposals[p]);
+
+           if (find(ch.tabu.begin(), ch.tabu.end(), key) != ch.tabu.end())
+             continue;
+
+           if (best < 0 || visited[key] > bestScore) {
+             best = p;
+             bestScore = visited[key];
+           }
+         }
+
+         if (best < 0) {
+           ch.hasCurrent = false;
+         } else {
+           ch.current = ch.proposals[best];
+           ch.currentScore = bestScore;
+         }
+         break;
+       }
+
+       case RANDOM_RESTART: {
+         // best improving neighbor, or restart at a local optimum
+         int best = -1;
+         double bestScore = ch.currentScore;
+         for (unsigned int p = 0; p < ch.proposals.size(); p++) {
+           double s = visited[vectorKey(ch.proposals[p])];
+
+           if (s > bestScore) {
+             best = p;
+             bestScore = s;
+           }
+         }
+
+         if (best < 0) {
+           ch.hasCurrent = false;
+         } else {
+           ch.current = ch.proposals[best];
+           ch.currentScore = bestScore;
+         }
+         break;
+       }
+     }
+   }
+
+   // key of a vector in the memo
+   static string vectorKey(const vector< int > &u)
+   {
+     ostringstream key;
+
+     for (unsigned int i = 0; i < u.size(); i++) {
+       key << u[i] << " ";
+     }
+
+     return key.str();
+   }
+
+   Method method;
+   unsigned int dimensions;
+   int maxval;
+   unsigned int steps;
+   int peinefficiency;
+
+   vector< Chain > chain;
+
+   // scores of visited vectors, and vectors being evaluated
+   map< string, double > visited;
+   std::set< string > inflight;
+
+   unsigned long evaluated;
+
+};
+
+#endif // __LOCAL_SEARCH_H__
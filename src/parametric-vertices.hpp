@@ -0,0 +1,246 @@
+//  parametric-vertices.hpp
+//
+//  Vertices of a parametric domain as affine functions of the parameters,
+//  computed by PolyLib (Polyhedron2Param_Domain).
+//
+//  The context of the parameters is split into chambers; in each chamber
+//  the domain has a fixed set of vertices, each an affine function of the
+//  parameters.  The vertices of the chamber holding the parameter instance
+//  are kept.  They replace the hand written list of vertices for a single
+//  instance: the schedule ILP is built from their values at the instance,
+//  and the latency of a schedule is an affine function of the parameters.
+//
+//  The latency of schedule \lambda is max \lambda (v_i - v_j) over pairs of
+//  vertices.  The vertex maximizing (minimizing) \lambda x is the same for
+//  all parameters of a chamber: the vertices of a chamber are the same
+//  bases of the constraints, and whether a basis is optimal for \lambda
+//  does not depend on the parameters.  The latency is therefore the affine
+//  function \lambda (v_i(p) - v_j(p)) of the pair maximizing it at the
+//  instance, throughout the chamber.
+
+#ifndef __PARAMETRIC_VERTICES_H__
+#   define __PARAMETRIC_VERTICES_H__
+
+#include <vector>
+using namespace std;
+
+#include <polylib/polylibgmp.h>
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+#include <boost/rational.hpp>
+#include <boost/math/common_factor.hpp>
+
+// local includes
+#include "dse-error.hpp"
+
+class ParametricVertices
+{
+
+ public:
+
+   // constructor
+   //   domain   - PIP constraints over the unknowns and parameters
+   //   context  - PIP constraints over the parameters
+   //   instance - values of the parameters
+   // throws DSEError if the domain is empty or unbounded, or no chamber
+   // holds the instance
+   ParametricVertices(PipMatrix *domain, PipMatrix *context,
+                      unsigned int _dimensions, unsigned int _parameters,
+                      const vector< int > &_instance) :
+     dimensions (_dimensions),
+     parameters (_parameters),
+     instance (_instance),
+     instancevertices (NULL)
+   {
+     Polyhedron *D = Constraints2Polyhedron ( (Matrix *) domain, 256);
+     Polyhedron *C = Constraints2Polyhedron ( (Matrix *) context, 256);
+
+     Param_Polyhedron *PP = Polyhedron2Param_Domain (D, C, 256);
+
+     Polyhedron_Free (D);
+     Polyhedron_Free (C);
+
+     if (!PP) {
+       throw DSEError("Domain has no vertices");
+     }
+
+     if (PP->Rays && PP->Rays->NbRows > 0) {
+       Param_Polyhedron_Free (PP);
+       throw DSEError("Domain is unbounded");
+     }
+
+     Value *values = (Value *) malloc (sizeof (Value) * parameters);
+     for (unsigned int i = 0; i < parameters; i++) {
+       value_init (values[i]);
+       value_set_si (values[i], instance[i]);
+     }
+
+     // chamber of the instance.  on the boundary of chambers the vertices
+     // of either have the same values
+     Param_Domain *chamber = PP->D;
+     while (chamber && !in_domain (chamber->Domain, values)) {
+       chamber = chamber->next;
+     }
+
+     for (unsigned int i = 0; i < parameters; i++) {
+       value_clear (values[i]);
+     }
+     free (values);
+
+     if (!chamber) {
+       Param_Polyhedron_Free (PP);
+       throw DSEError("No chamber of the domain holds the parameter instance");
+     }
+
+     // coefficients of the parameters and constant of each coordinate
+     Param_Vertices *V;
+     FORALL_PVertex_in_ParamPolyhedron(V, chamber, PP)
+       Matrix *M = V->Vertex;
+
+       for (unsigned int i = 0; i < dimensions; i++) {
+         int denominator = VALUE_TO_INT( M->p[i][parameters + 1] );
+
+         for (unsigned int j = 0; j <= parameters; j++) {
+           coefficients.push_back(
+             boost::rational<int>(VALUE_TO_INT( M->p[i][j] ), denominator));
+         }
+       }
+     END_FORALL_PVertex_in_ParamPolyhedron;
+
+     Param_Polyhedron_Free (PP);
+
+     if (coefficients.empty()) {
+       throw DSEError("Domain has no vertices");
+     }
+
+     instantiate();
+   }
+
+   // destructor
+   ~ParametricVertices()
+   {
+     pip_matrix_free(instancevertices);
+   }
+
+   // number of vertices
+   unsigned int size()
+   {
+     return coefficients.size() / (dimensions * (parameters + 1));
+   }
+
+   // coefficients of the parameters and constant of coordinate i of
+   // vertex v
+   const boost::rational<int> *coordinate(unsigned int v, unsigned int i)
+   {
+     return &coefficients[(v * dimensions + i) * (parameters + 1)];
+   }
+
+   //
+   // vertices at the parameter instance, one per row, as integers over the
+   // common denominator in the last column
+   //
+   PipMatrix *getInstanceVertices()
+   {
+     return instancevertices;
+   }
+
+   //
+   // latency of a schedule as an affine function of the parameters:
+   // parameters + 1 coefficients, the constant last.  a schedule of least
+   // latency s has s = max \lambda (v_i - v_j), rounded up.
+   //
+   void latencyFunction(const int *schedule, boost::rational<int> *latency)
+   {
+     unsigned int first = 0, last = 0;
+     boost::rational<int> hi, lo;
+
+     // vertices with the largest and smallest time at the instance
+     for (unsigned int v = 0; v < size(); v++) {
+       boost::rational<int> t = instanceTime(schedule, v);
+
+       if (v == 0 || t > hi) {
+         hi = t;
+         last = v;
+       }
+       if (v == 0 || t < lo) {
+         lo = t;
+         first = v;
+       }
+     }
+
+     for (unsigned int j = 0; j <= parameters; j++) {
+       latency[j] = 0;
+
+       for (unsigned int i = 0; i < dimensions; i++) {
+         latency[j] += schedule[i] * (coordinate(last, i)[j] -
+                                      coordinate(first, i)[j]);
+       }
+     }
+   }
+
+ private:
+
+   // value of coordinate i of vertex v at the instance
+   boost::rational<int> instanceValue(unsigned int v, unsigned int i)
+   {
+     const boost::rational<int> *coeff = coordinate(v, i);
+     boost::rational<int> x = coeff[parameters];
+
+     for (unsigned int j = 0; j < parameters; j++) {
+       x += coeff[j] * instance[j];
+     }
+
+     return x;
+   }
+
+   // time of vertex v at the instance
+   boost::rational<int> instanceTime(const int *schedule, unsigned int v)
+   {
+     boost::rational<int> t = 0;
+
+     for (unsigned int i = 0; i < dimensions; i++) {
+       t += schedule[i] * instanceValue(v, i);
+     }
+
+     return t;
+   }
+
+   // build the matrix of the vertices at the instance
+   void instantiate()
+   {
+     int denominator = 1;
+
+     for (unsigned int v = 0; v < size(); v++) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         denominator = boost::math::lcm(denominator,
+                                        instanceValue(v, i).denominator());
+       }
+     }
+
+     instancevertices = pip_matrix_alloc(size(), dimensions + 1);
+
+     for (unsigned int v = 0; v < size(); v++) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         boost::rational<int> x = instanceValue(v, i) * denominator;
+         entier_set_si (instancevertices->p[v][i], x.numerator());
+       }
+
+       entier_set_si (instancevertices->p[v][dimensions], denominator);
+     }
+   }
+
+   unsigned int dimensions;
+   unsigned int parameters;
+   vector< int > instance;
+
+   // coordinates of the vertices of the chamber, parameters + 1
+   // coefficients each, vertex major
+   vector< boost::rational<int> > coefficients;
+
+   PipMatrix *instancevertices;
+
+};
+
+#endif // __PARAMETRIC_VERTICES_H__
@@ -0,0 +1,259 @@
+//  pareto-frontier.hpp
+//
+//  Pareto frontier (skyline) of projection solutions over a choice of
+//  design metrics.  The BPP is maximized, as in the ranking of solutions;
+//  every other metric is minimized.  Metrics are compared as costs, the
+//  BPP negated.
+//
+//  A solution dominates another if it is no worse in every metric and
+//  better in at least one.  The frontier is maintained incrementally as
+//  solutions arrive (block nested loop skyline): a new solution is
+//  discarded if a frontier solution dominates it, otherwise the frontier
+//  solutions it dominates are discarded and it joins the frontier.  Only
+//  frontier solutions are kept, so memory is proportional to the frontier
+//  and not to the number of candidates.
+//
+//  Frontier points are kept sorted by the cost of the first metric.  Only
+//  points with a first cost no greater than that of a new solution can
+//  dominate it, and only points with a first cost no less can be dominated
+//  by it.
+
+#ifndef __PARETO_FRONTIER_H__
+#   define __PARETO_FRONTIER_H__
+
+#include <list>
+#include <string>
+#include <vector>
+#include <sstream>
+using namespace std;
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+#include "solutions.hpp"
+
+class ParetoFrontier
+{
+
+ public:
+
+   // design metrics
+   enum Metric {
+     BPP = 0,       // BPP at the parameter instance, maximized
+     PE_COUNT,      // PEs at the parameter instance
+     UTILIZATION,   // lambda * u
+     LATENCY,
+     MAX_LENGTH,    // longest interconnection link
+     AVG_LENGTH,    // average interconnection link length
+     MAX_DELAY,     // longest link delay
+     AVG_DELAY,     // average link delay
+     IO_PORTS,      // I/O ports at the parameter instance
+     IO_PER_CYCLE,  // peak I/O values per cycle
+     STORAGE        // delay registers at the parameter instance
+   };
+
+   // number of metrics
+   static const unsigned int METRICS = 11;
+
+   // constructor
+   //   metrics        - comma separated metric names (see metricOf)
+   //   peinefficiency - solutions above the processor inefficiency bound
+   //                    are never on the frontier
+   // throws DSEError on an unknown metric
+   ParetoFrontier(const string &_metrics, int _peinefficiency) :
+     peinefficiency (_peinefficiency)
+   {
+     istringstream is(_metrics);
+     string name;
+
+     while (getline(is, name, ',')) {
+       int m = metricOf(name);
+
+       if (m < 0) {
+         throw DSEError("Unknown Pareto metric: " + name);
+       }
+
+       metrics.push_back((Metric) m);
+     }
+
+     if (metrics.empty()) {
+       throw DSEError("No Pareto metrics given");
+     }
+   }
+
+   // destructor.  solutions are owned by the list they were inserted into
+   ~ParetoFrontier()
+   {
+   }
+
+   // name of a metric
+   static const char *metricName(unsigned int m)
+   {
+     static const char *names[] = { "bpp", "pe-count", "utilization",
+                                    "latency", "max-length", "avg-length",
+                                    "max-delay", "avg-delay", "io-ports",
+                                    "io-per-cycle", "storage" };
+
+     return names[m];
+   }
+
+   // metric of a name, or -1 if the name is unknown
+   static int metricOf(const string &name)
+   {
+     for (unsigned int m = 0; m < METRICS; m++) {
+       if (name == metricName(m))
+         return m;
+     }
+
+     return -1;
+   }
+
+   //
+   // add a solution of a candidate to solutions, which holds the frontier
+   // and failed candidates.  returns false if the solution is dominated or
+   // over the processor inefficiency bound, in which case it is deleted.
+   // frontier solutions it dominates are removed from solutions and
+   // deleted.  failed candidates are always added.
+   //
+   bool insert(Solutions &solutions, ProjectionSolution *ps)
+   {
+     if (ps->status != ProjectionSolution::OK) {
+       solutions.push_front(ps);
+       return true;
+     }
+
+     if ((int) ps->utilization > peinefficiency) {
+       delete ps;
+       return false;
+     }
+
+     Point p;
+     p.ps = ps;
+     values(ps, p.value);
+
+     // points with a smaller or equal first cost may dominate p
+     list< Point >::iterator i;
+     for (i = points.begin();
+          i != points.end() && i->value[0] <= p.value[0]; i++) {
+       if (dominates(*i, p)) {
+         delete ps;
+         return false;
+       }
+     }
+
+     // points with an equal or larger first cost may be dominated by p
+     for (i = points.begin();
+          i != points.end() && i->value[0] < p.value[0]; i++) {
+     }
+
+     while (i != points.end()) {
+       if (dominates(p, *i)) {
+         solutions.remove(i->ps);
+         delete i->ps;
+         i = points.erase(i);
+       } else {
+         i++;
+       }
+     }
+
+     // insert p after the points with a smaller or equal first cost
+     for (i = points.begin();
+          i != points.end() && i->value[0] <= p.value[0]; i++) {
+     }
+     points.insert(i, p);
+
+     solutions.push_front(ps);
+
+     return true;
+   }
+
+   // a frontier solution has been evaluated again; the new solution has the
+   // same metrics unless it failed, in which case it leaves the frontier
+   void replace(ProjectionSolution *old, ProjectionSolution *ps)
+   {
+     for (list< Point >::iterator i = points.begin(); i != points.end(); i++) {
+       if (i->ps != old)
+         continue;
+
+       if (ps->status == ProjectionSolution::OK)
+         i->ps = ps;
+       else
+         points.erase(i);
+
+       return;
+     }
+   }
+
+   // number of solutions on the frontier
+   unsigned int size()
+   {
+     return points.size();
+   }
+
+   // names of the metrics, comma separated
+   string names()
+   {
+     string str;
+
+     for (unsigned int m = 0; m < metrics.size(); m++) {
+       str += (m ? ", " : "");
+       str += metricName(metrics[m]);
+     }
+
+     return str;
+   }
+
+ private:
+
+   // a frontier solution and the costs of its metrics, in the order chosen
+   struct Point
+   {
+     ProjectionSolution *ps;
+     double value[METRICS];
+   };
+
+   // costs of the metrics of a solution, in the order chosen: smaller is
+   // better
+   void values(ProjectionSolution *ps, double *value)
+   {
+     for (unsigned int m = 0; m < metrics.size(); m++) {
+       switch (metrics[m]) {
+         case BPP:         value[m] = - (double) ps->instance_bpp; break;
+         case PE_COUNT:    value[m] = ps->instance_pe_count; break;
+         case UTILIZATION: value[m] = ps->utilization; break;
+         case LATENCY:     value[m] = ps->latency; break;
+         case MAX_LENGTH:  value[m] = ps->network_max_length; break;
+         case AVG_LENGTH:  value[m] = ps->network_avg_length; break;
+         case MAX_DELAY:   value[m] = ps->network_max_delay; break;
+         case AVG_DELAY:   value[m] = ps->network_avg_delay; break;
+         case IO_PORTS:    value[m] = ps->instance_io_port_count; break;
+         case IO_PER_CYCLE: value[m] = ps->io_per_cycle; break;
+         case STORAGE:     value[m] = ps->instance_storage; break;
+       }
+     }
+   }
+
+   // does a dominate b?
+   bool dominates(const Point &a, const Point &b)
+   {
+     bool better = false;
+
+     for (unsigned int m = 0; m < metrics.size(); m++) {
+       if (a.value[m] > b.value[m])
+         return false;
+       if (a.value[m] < b.value[m])
+         better = true;
+     }
+
+     return better;
+   }
+
+   vector< Metric > metrics;
+   int peinefficiency;
+
+   // frontier, sorted by the first cost
+   list< Point > points;
+
+};
+
+#endif // __PARETO_FRONTIER_H__
@@ -0,0 +1,183 @@
+//  pip-workspace.hpp
+//
+//  Scratch state for the PIP solves of a solver: the solver options, a pool
+//  of ILP matrices and the PIP session.  The solver also keeps the PolyLib
+//  constraint matrices of its counts here.
+//
+//  PIP keeps its tableau and solution space in globals that pip_solve()
+//  allocates on first use and pip_close() frees, so closing after every
+//  solve allocated them again for the next one.  The session is opened with
+//  the first workspace and closed with the last; pip_solve() rewinds its
+//  storage after each solve.
+//
+//  The ILPs of a problem have the same shape for every candidate.  Their
+//  matrices are taken from the pool, zeroed, and returned to it instead of
+//  being freed.  The integers of pooled matrices and of the session outlive
+//  the GMP arena scope of a solve, so they are allocated from the heap.
+//
+//  The I/O and storage counts build a constraint matrix per slab or link of
+//  every candidate, again of the same few shapes, and pool them the same
+//  way.  The polyhedra PolyLib builds from them are its own and are freed.
+
+#ifndef __PIP_WORKSPACE_H__
+#   define __PIP_WORKSPACE_H__
+
+#include <vector>
+using namespace std;
+
+// pip includes
+#include <piplib/piplibMP.h>
+
+// polylib includes
+#include <polylib/polylibgmp.h>
+
+// local includes
+#include "gmp-arena.hpp"
+
+class PipWorkspace
+{
+
+ public:
+
+   // constructor.  opens the PIP session
+   PipWorkspace()
+   {
+     GMPArena::Suspend heap;
+
+     if (sessions()++ == 0) {
+       pip_init();
+     }
+
+     options = pip_options_init();
+   }
+
+   // destructor.  closes the PIP session with the last workspace
+   ~PipWorkspace()
+   {
+     GMPArena::Suspend heap;
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       pip_matrix_free(pool[i]);
+     }
+
+     for (unsigned int i = 0; i < constraints.size(); i++) {
+       Matrix_Free (constraints[i]);
+     }
+
+     pip_options_free(options);
+
+     if (--sessions() == 0) {
+       pip_close();
+     }
+   }
+
+   // options for pip_solve()
+   PipOptions *getOptions()
+   {
+     return options;
+   }
+
+   // a zero matrix of the given size
+   PipMatrix *allocate(unsigned int rows, unsigned int columns)
+   {
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       PipMatrix *m = pool[i];
+
+       if (m->NbRows != rows || m->NbColumns != columns)
+         continue;
+
+       pool.erase(pool.begin() + i);
+
+       for (unsigned int r = 0; r < rows; r++) {
+         for (unsigned int c = 0; c < columns; c++) {
+           entier_set_si (m->p[r][c], 0);
+         }
+       }
+
+       return m;
+     }
+
+     GMPArena::Suspend heap;
+
+     PipMatrix *m = pip_matrix_alloc(rows, columns);
+
+     // give every integer a limb now, so that ILP coefficients stored
+     // within an arena scope do not allocate from the arena
+     for (unsigned int r = 0; r < rows; r++) {
+       for (unsigned int c = 0; c < columns; c++) {
+         mpz_realloc2 (m->p[r][c], GMP_NUMB_BITS);
+       }
+     }
+
+     return m;
+   }
+
+   // return a matrix to the pool
+   void release(PipMatrix *m)
+   {
+     pool.push_back(m);
+   }
+
+   // a zero PolyLib matrix of the given size
+   Matrix *allocateMatrix(unsigned int rows, unsigned int columns)
+   {
+     for (unsigned int i = 0; i < constraints.size(); i++) {
+       Matrix *m = constraints[i];
+
+       if (m->NbRows != rows || m->NbColumns != columns)
+         continue;
+
+       constraints.erase(constraints.begin() + i);
+
+       for (unsigned int r = 0; r < rows; r++) {
+         for (unsigned int c = 0; c < columns; c++) {
+           value_set_si (m->p[r][c], 0);
+         }
+       }
+
+       return m;
+     }
+
+     GMPArena::Suspend heap;
+
+     Matrix *m = Matrix_Alloc(rows, columns);
+
+     for (unsigned int r = 0; r < rows; r++) {
+       for (unsigned int c = 0; c < columns; c++) {
+         mpz_realloc2 (m->p[r][c], GMP_NUMB_BITS);
+       }
+     }
+
+     return m;
+   }
+
+   // return a PolyLib matrix to the pool
+   void releaseMatrix(Matrix *m)
+   {
+     constraints.push_back(m);
+   }
+
+ private:
+
+   // number of open workspaces, sharing the PIP session
+   static unsigned int &sessions()
+   {
+     static unsigned int count = 0;
+     return count;
+   }
+
+   PipOptions *options;
+
+   // matrices not in use
+   vector< PipMatrix * > pool;
+
+   // PolyLib matrices not in use
+   vector< Matrix * > constraints;
+
+   // the workspace owns matrices, do not copy
+   PipWorkspace(const PipWorkspace &);
+   PipWorkspace &operator=(const PipWorkspace &);
+
+};
+
+#endif // __PIP_WORKSPACE_H__
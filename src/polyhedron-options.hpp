@@ -27,12 +27,16 @@ namespace fs = boost::filesystem;
 #include <cstdlib>
 using namespace std;
 
+// local includes
+#include "dse-error.hpp"
+
 class PolyhedronOptions
 {
 
  public:
 
    // constructor
+   // throws DSEError if the configuration file is incomplete
    PolyhedronOptions(string config_file)
    {
      try {
@@ -52,12 +56,16 @@ class PolyhedronOptions
          ("parameterinstantiations", po::value<string>(), "Parameter instantiations separated by whitespace")
          ("pipconstraints", po::value<string>(), "File with pip constraints of polyhedron")
          ("dependencies", po::value<string>(), "File with dependencies of polyhedron")
-         ("vertices", po::value<string>(), "File with vertices of polyhedron")
+         ("vertices", po::value<string>(), "Obsolete, ignored: vertices are computed from the pip constraints")
          ;
 
        // specify configuration file
        ifstream ifs(config_file.c_str());
 
+       if (!ifs) {
+         throw "Failed to open polyhedron configuration file";
+       }
+
        // read configuration file
        store(parse_config_file(ifs, config), vm);
        notify(vm);
@@ -140,27 +148,14 @@ class PolyhedronOptions
        } else {
          throw "Must specify dependencies of polyhedron";
        }
-
-       if (vm.count("vertices")) {
-         // store vertices file.  path is relative to that of the
-         // configuration file.
-         // note:  branch_path() has changed to parent_path() in the new
-         // release of boost.
-         vertices = config_file_path.branch_path().string() + "/" +
-                    vm["vertices"].as<string>();
-       } else {
-         throw "Must specify vertices of polyhedron";
-       }
      }
      catch(exception &err)
      {
-       cerr << "Error parsing options: " << err.what() << endl;
-       exit (-1);
+       throw DSEError(string("Error parsing options: ") + err.what());
      }
      catch(const char *err)
      {
-       cerr << "Error parsing options: " << err << endl;
-       exit (-1);
+       throw DSEError(string("Error parsing options: ") + err);
      }
 
      return;
@@ -178,7 +173,6 @@ class PolyhedronOptions
    vector< int > parameterinstantiations;
    string pipconstraints;
    string dependencies;
-   string vertices;
 
 };
 
@@ -8,154 +8,595 @@
 //  Projection solution container.  Contains projection vector, best block
 //  pipelining period (BPP) possible (k_max), index points x1, x2 that produce
 //  this BPP.
+//
+//  Solutions use a flat, fixed layout.  Small integer matrices (projection
+//  vector, schedule, allocation) and rational coefficients (BPP, x1, x2) are
+//  each held in one contiguous array carved out of a solution arena.
+//
+//  A projection of rank k has k projection directions u_1..u_k (a k x n
+//  projection matrix) and an n-k x n allocation.  The BPP is kept per
+//  direction: the extent e_j of the projection along u_j.  A PE executes at
+//  most (e_1 + 1) ... (e_k + 1) points.
+//
+//  The latency is also kept as an affine function of the parameters, valid
+//  for the parameters of the chamber of the domain holding the instance
+//  (see ParametricVertices).
+//
+//  When the BPP is piecewise affine over regions of the parameters, the
+//  coefficients hold the piece of the parameter instance and the text of
+//  all pieces is kept for printing.
 
 #ifndef __PROJECTION_SOLUTION_H__
 #   define __PROJECTION_SOLUTION_H__
 
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
 #include <polylib/polylibgmp.h>
 
 #include <barvinok/evalue.h>
 
 #include <boost/rational.hpp>
-#include <boost/numeric/ublas/vector.hpp>
-#include <boost/numeric/ublas/io.hpp>
-namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "solution-arena.hpp"
 
 class ProjectionSolution
 {
 
  public:
 
+   // status of the candidate.  candidates evaluated in worker processes
+   // may fail without producing a solution
+   enum Status {
+     OK = 0,      // solution found
+     TIMEOUT,     // exceeded wall clock limit
+     MEMORY,      // exceeded memory limit
+     CRASHED,     // worker killed by a signal
+     ERROR        // worker exited with an error
+   };
+
    // constructor
+   // storage for the solution is allocated from the arena, which must
+   // outlive the solution.  parameter names and instantiations are shared
+   // by all solutions and are not owned.
    ProjectionSolution(int _dimensions, int _parameters,
                       vector< int > *_parameterinstantiations,
-                      vector< string > *_parameternames) :
-     projection_vector ( Matrix_Alloc (1, _dimensions) ),
-     bpp ( new ublas::vector< boost::rational<int> > (_parameters + 1) ),
+                      vector< string > *_parameternames,
+                      SolutionArena *_arena,
+                      unsigned int _rank = 1) :
+     instance_bpp (0),
      utilization (0),
      latency (0),
-     schedule ( Matrix_Alloc (1, _dimensions) ),
-     allocation ( NULL),
+     network_sum_delays (0),
+     network_max_delay (0),
+     network_avg_delay (0.),
      network_max_length (0),
      network_avg_length (0.),
      pe_count (NULL),
      instance_pe_count (0),
+     pe_count_fingerprint (0),
+     io_port_count (NULL),
+     instance_io_port_count (-1),
+     io_per_cycle (0),
+     storage_count (NULL),
+     instance_storage (-1),
+     partition_copies (0),
+     partition_period (0),
+     partition_memory (0),
+     partition_crossing (0),
+     candidate (0),
+     status (OK),
+     rank (_rank),
+     pieces (_rank),
      dimensions (_dimensions),
      parameters (_parameters),
      parameterinstantiations (_parameterinstantiations),
-     parameternames (_parameternames)
+     parameternames (_parameternames),
+     arena (_arena)
    {
-     // initialize x1, x2
-     x1 = new ublas::vector< boost::rational<int> > * [_dimensions];
-     x2 = new ublas::vector< boost::rational<int> > * [_dimensions];
-     
-     for (unsigned int i = 0; i < dimensions; i++) {
-       x1[i] = new ublas::vector< boost::rational<int> > (_parameters + 1);
-       x2[i] = new ublas::vector< boost::rational<int> > (_parameters + 1);
+     allocateStorage();
+   }
+
+   // copy constructor.  the copy gets its own storage from the same arena
+   // and its own copy of the PE count.
+   ProjectionSolution(const ProjectionSolution &other) :
+     instance_bpp (other.instance_bpp),
+     utilization (other.utilization),
+     latency (other.latency),
+     network_sum_delays (other.network_sum_delays),
+     network_max_delay (other.network_max_delay),
+     network_avg_delay (other.network_avg_delay),
+     network_max_length (other.network_max_length),
+     network_avg_length (other.network_avg_length),
+     pe_count (other.pe_count ? evalue_dup (other.pe_count) : NULL),
+     instance_pe_count (other.instance_pe_count),
+     pe_count_fingerprint (other.pe_count_fingerprint),
+     io_port_count (other.io_port_count ? evalue_dup (other.io_port_count) : NULL),
+     instance_io_port_count (other.instance_io_port_count),
+     io_per_cycle (other.io_per_cycle),
+     storage_count (other.storage_count ? evalue_dup (other.storage_count) : NULL),
+     instance_storage (other.instance_storage),
+     partition (other.partition),
+     partition_copies (other.partition_copies),
+     partition_period (other.partition_period),
+     partition_memory (other.partition_memory),
+     partition_crossing (other.partition_crossing),
+     candidate (other.candidate),
+     status (other.status),
+     rank (other.rank),
+     pieces (other.pieces),
+     dimensions (other.dimensions),
+     parameters (other.parameters),
+     parameterinstantiations (other.parameterinstantiations),
+     parameternames (other.parameternames),
+     arena (other.arena)
+   {
+     allocateStorage();
+
+     memcpy (projection_vector, other.projection_vector,
+             integerCount() * sizeof (int));
+
+     for (unsigned int i = 0; i < rationalCount(); i++) {
+       bpp[i] = other.bpp[i];
      }
    }
 
    // destructor
+   // arena storage is returned to the arena for the next solution
    ~ProjectionSolution()
    {
-     if (parameternames)
-       delete parameternames;
-
-     if (parameterinstantiations)
-       delete parameterinstantiations;
+     arena->deallocate(projection_vector, integerCount());
+     arena->deallocate(bpp, rationalCount());
 
      if (pe_count)
-       free_evalue_refs (pe_count);
+       evalue_free (pe_count);
+     if (io_port_count)
+       evalue_free (io_port_count);
+     if (storage_count)
+       evalue_free (storage_count);
+   }
 
-     if (allocation)
-       Matrix_Free (allocation);
+   // save solution as a single line of text.  the parametric PE, I/O port
+   // and storage counts are not saved, only their instance values and the
+   // fingerprint of the PE count; they are recomputed by the solver when
+   // needed.
+   void save(ostream &os)
+   {
+     os << candidate << " "
+        << instance_bpp << " "
+        << utilization << " "
+        << latency << " "
+        << network_sum_delays << " "
+        << network_max_delay << " "
+        << setprecision(9) << network_avg_delay << " "
+        << network_max_length << " "
+        << network_avg_length << " "
+        << instance_pe_count << " "
+        << hex << pe_count_fingerprint << dec << " "
+        << instance_io_port_count << " "
+        << io_per_cycle << " "
+        << instance_storage << " "
+        << (int) status;
+
+     for (unsigned int i = 0; i < integerCount(); i++) {
+       os << " " << projection_vector[i];
+     }
 
-     if (schedule)
-       Matrix_Free (schedule);
+     for (unsigned int i = 0; i < rationalCount(); i++) {
+       os << " " << bpp[i].numerator() << " " << bpp[i].denominator();
+     }
 
-     for (unsigned int i = 0; i < dimensions; i++) {
-       delete x1[i];
-       delete x2[i];
+     // pieces of a piecewise BPP, as length and text
+     for (unsigned int dir = 0; dir < rank; dir++) {
+       os << " " << pieces[dir].size() << " " << pieces[dir];
      }
-     delete x1;
-     delete x2;
 
-     if (bpp)
-       delete bpp;
+     os << endl;
+   }
 
-     if (projection_vector)
-       Matrix_Free (projection_vector);
+   // load solution saved by save().  returns false if the line is
+   // malformed.
+   bool load(istream &is)
+   {
+     is >> candidate
+        >> instance_bpp
+        >> utilization
+        >> latency
+        >> network_sum_delays
+        >> network_max_delay
+        >> network_avg_delay
+        >> network_max_length
+        >> network_avg_length
+        >> instance_pe_count
+        >> hex >> pe_count_fingerprint >> dec
+        >> instance_io_port_count
+        >> io_per_cycle
+        >> instance_storage;
+
+     int _status;
+     is >> _status;
+     status = (Status) _status;
+
+     for (unsigned int i = 0; i < integerCount(); i++) {
+       is >> projection_vector[i];
+     }
+
+     int numerator, denominator;
+     for (unsigned int i = 0; i < rationalCount(); i++) {
+       is >> numerator >> denominator;
+
+       if (!is || denominator == 0)
+         return false;
+
+       bpp[i].assign(numerator, denominator);
+     }
+
+     for (unsigned int dir = 0; dir < rank; dir++) {
+       unsigned int length;
+       is >> length;
+
+       if (!is)
+         return false;
+
+       pieces[dir].assign(length, ' ');
+       if (length > 0) {
+         is.get();
+         is.read(&pieces[dir][0], length);
+       }
+     }
+
+     if (pe_count) {
+       evalue_free (pe_count);
+       pe_count = NULL;
+     }
+
+     if (io_port_count) {
+       evalue_free (io_port_count);
+       io_port_count = NULL;
+     }
+
+     if (storage_count) {
+       evalue_free (storage_count);
+       storage_count = NULL;
+     }
+
+     return (bool) is;
    }
 
-   // compute BPP for an instance of the parameters
-   void computeInstanceBPP()
+   // coefficients of x1 and x2 for dimension i, of the points realizing
+   // the extent along direction dir
+   boost::rational<int> *x1Coefficients(unsigned int i, unsigned int dir = 0)
    {
-     float bpp_i = 0;
+     return x1 + (dir * dimensions + i) * (parameters + 1);
+   }
+
+   boost::rational<int> *x2Coefficients(unsigned int i, unsigned int dir = 0)
+   {
+     return x2 + (dir * dimensions + i) * (parameters + 1);
+   }
+
+   // coefficients of the extent along direction dir
+   boost::rational<int> *bppCoefficients(unsigned int dir)
+   {
+     return bpp + dir * (parameters + 1);
+   }
+
+   // coefficients of the latency
+   boost::rational<int> *latencyCoefficients()
+   {
+     return latency_function;
+   }
+
+   // element (i, j) of the k x n projection matrix
+   int &projectionElement(unsigned int i, unsigned int j)
+   {
+     return projection_vector[i * dimensions + j];
+   }
+
+   // element (i, j) of the n-k x n allocation matrix
+   int &allocationElement(unsigned int i, unsigned int j)
+   {
+     return allocation[i * dimensions + j];
+   }
+
+   // take the schedule of a solution of the same projection, solved
+   // separately: the orientation of the projection, schedule, utilization
+   // and latency
+   void assignSchedule(const ProjectionSolution &other)
+   {
+     memcpy (projection_vector, other.projection_vector,
+             (rank + 1) * dimensions * sizeof (int));
+
+     utilization = other.utilization;
+     latency     = other.latency;
+
+     for (unsigned int i = 0; i <= parameters; i++) {
+       latency_function[i] = other.latency_function[i];
+     }
+   }
+
+   // extent along direction dir for an instance of the parameters, rounded
+   // up
+   int instanceExtent(unsigned int dir)
+   {
+     boost::rational<int> *coeff = bppCoefficients(dir);
+     float extent = 0;
 
      // multiply instance of each parameter with rational coefficient of BPP
      for (unsigned int i = 0; i < parameters; i++) {
-       bpp_i += (*parameterinstantiations)[i] *
-                (float)  (*bpp)(i).numerator() / (float) (*bpp)(i).denominator();
+       extent += (*parameterinstantiations)[i] *
+                (float)  coeff[i].numerator() / (float) coeff[i].denominator();
      }
      
      // add constant coefficient
-     bpp_i += (float)  (*bpp)(parameters).numerator() /
-                (float) (*bpp)(parameters).denominator();
+     extent += (float)  coeff[parameters].numerator() /
+                (float) coeff[parameters].denominator();
      
-     instance_bpp = (int) bpp_i;
+     int extent_i = (int) extent;
      
      // round up
-     if ((float) instance_bpp != bpp_i)
-       instance_bpp++;
+     if ((float) extent_i != extent)
+       extent_i++;
+
+     return extent_i;
+   }
+
+   // compute BPP for an instance of the parameters
+   void computeInstanceBPP()
+   {
+     if (rank == 1) {
+       instance_bpp = instanceExtent(0);
+       return;
+     }
+
+     // points per PE, less one
+     unsigned int points = 1;
+     for (unsigned int dir = 0; dir < rank; dir++) {
+       points *= instanceExtent(dir) + 1;
+     }
+
+     instance_bpp = points - 1;
+   }
+
+   // print entire solution as a single JSON object, with the same columns
+   // as print()
+   void printJSON(ostream &os = cout)
+   {
+     os << "{\"projection_vector\": [";
+     if (rank == 1) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         os << (i ? ", " : "") << projection_vector[i];
+       }
+     } else {
+       for (unsigned int i = 0; i < rank; i++) {
+         os << (i ? ", " : "") << "[";
+         for (unsigned int j = 0; j < dimensions; j++) {
+           os << (j ? ", " : "") << projectionElement(i, j);
+         }
+         os << "]";
+       }
+     }
+     os << "], ";
+
+     os << "\"bpp\": \"" << bppString() << "\", ";
+     os << "\"instance_bpp\": " << instance_bpp + 1 << ", ";
+
+     os << "\"pe_count\": \"";
+     if (pe_count) {
+       escapeJSON(os, peCountString());
+     } else {
+       os << "#" << hex << pe_count_fingerprint << dec;
+     }
+     os << "\", ";
+     os << "\"instance_pe_count\": " << instance_pe_count << ", ";
+
+     os << "\"schedule\": [";
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << (i ? ", " : "") << schedule[i];
+     }
+     os << "], ";
+
+     os << "\"utilization\": " << utilization << ", ";
+     os << "\"network_sum_delays\": " << network_sum_delays << ", ";
+     os << "\"network_avg_delay\": " << network_avg_delay << ", ";
+     os << "\"network_max_delay\": " << network_max_delay << ", ";
+     os << "\"latency\": " << latency << ", ";
+     os << "\"latency_function\": \"" << latencyString() << "\", ";
+
+     os << "\"allocation\": [";
+     for (unsigned int i = 0; i < dimensions - rank; i++) {
+       os << (i ? ", " : "") << "[";
+       for (unsigned int j = 0; j < dimensions; j++) {
+         os << (j ? ", " : "") << allocationElement(i, j);
+       }
+       os << "]";
+     }
+     os << "], ";
+
+     os << "\"network_avg_length\": " << network_avg_length << ", ";
+     os << "\"network_max_length\": " << network_max_length << ", ";
+
+     if (instance_io_port_count >= 0) {
+       os << "\"io_port_count\": \"";
+       if (io_port_count)
+         escapeJSON(os, evalueString(io_port_count));
+       os << "\", ";
+       os << "\"instance_io_port_count\": " << instance_io_port_count << ", ";
+       os << "\"io_per_cycle\": " << io_per_cycle << ", ";
+     }
+
+     if (instance_storage >= 0) {
+       os << "\"storage_count\": \"";
+       if (storage_count)
+         escapeJSON(os, evalueString(storage_count));
+       os << "\", ";
+       os << "\"instance_storage\": " << instance_storage << ", ";
+     }
+
+     if (!partition.empty()) {
+       os << "\"partition\": \"" << partition << "\", ";
+       os << "\"partition_copies\": " << partition_copies << ", ";
+       os << "\"partition_period\": " << partition_period << ", ";
+       os << "\"partition_throughput\": " << partitionThroughput() << ", ";
+       os << "\"partition_memory\": " << partition_memory << ", ";
+       os << "\"partition_crossing\": " << partition_crossing << ", ";
+     }
+
+     os << "\"status\": \"" << statusString() << "\"}";
    }
 
    // print entire solution
-   void print()
+   void print(ostream &os = cout)
    {
-     printProjectionVector();
-     printBPP();
+     printProjectionVector(os);
+     printBPP(os);
        //printInstanceBPP();
-     printPECount();
-     printInstancePECount();
+     printPECount(os);
+     printInstancePECount(os);
 //     printX1();
 //     printX2();
-     printSchedule();
-     printUtil();
-     printScheduleDelays();
-     printLatency();
-     printAllocation();
-     printNetwork();
+     printSchedule(os);
+     printUtil(os);
+     printScheduleDelays(os);
+     printLatency(os);
+     printAllocation(os);
+     printNetwork(os);
+     printIO(os);
+     printStorage(os);
+     printPartition(os);
    }
 
-   // print projection vector
-   void printProjectionVector()
+   // print a string as the contents of a JSON string
+   static void escapeJSON(ostream &os, const string &str)
    {
-     cout << "\"";
-     for (unsigned int i = 0; i < projection_vector->NbColumns; i++) {
-       cout << VALUE_TO_INT (projection_vector->p[0][i]) << " ";
+     for (unsigned int i = 0; i < str.size(); i++) {
+       if (str[i] == '\n')
+         os << "\\n";
+       else if (str[i] == '"' || str[i] == '\\')
+         os << '\\' << str[i];
+       else
+         os << str[i];
      }
-     cout << "\",";
+   }
+
+   // name of the candidate status
+   const char *statusString()
+   {
+     switch (status) {
+       case OK:      return "ok";
+       case TIMEOUT: return "timeout";
+       case MEMORY:  return "memory";
+       case CRASHED: return "crashed";
+       default:      return "error";
+     }
+   }
+
+   // print projection vector, or the rows of the projection matrix
+   void printProjectionVector(ostream &os = cout)
+   {
+     os << "\"";
+     if (rank == 1) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         os << projection_vector[i] << " ";
+       }
+     } else {
+       for (unsigned int i = 0; i < rank; i++) {
+         os << "[ ";
+         for (unsigned int j = 0; j < dimensions; j++) {
+           os << projectionElement(i, j) << " ";
+         }
+         os << "]";
+       }
+     }
+     os << "\",";
    }
 
    // print BPP
-   void printBPP()
+   void printBPP(ostream &os = cout)
    {
-     cout << "\"";
+     os << "\"" << bppString() << "\",";
+   }
+
+   // BPP as an affine expression of the parameters.  rank k: the product
+   // of the affine expressions of each direction.  a piecewise BPP lists
+   // its pieces in braces.
+   string bppString()
+   {
+     ostringstream str;
+
+     for (unsigned int dir = 0; dir < rank; dir++) {
+       if (rank > 1)
+         str << "(";
+       if (pieces[dir].empty())
+         str << affineString(bppCoefficients(dir));
+       else
+         str << "{ " << pieces[dir] << " }";
+       if (rank > 1)
+         str << ")";
+     }
+
+     return str.str();
+   }
+
+   // an extent, given by its coefficients, as a BPP expression
+   string affineString(boost::rational<int> *coeff)
+   {
+     ostringstream str;
+
      for (unsigned int i = 0; i < parameters; i++) {
-       cout << (*bpp)(i) << (*parameternames)[i] << " + ";
+       str << coeff[i] << (*parameternames)[i] << " + ";
      }
-     cout << (*bpp)(parameters) << " + 1";
-     cout << "\",";
+     str << coeff[parameters] << " + 1";
+
+     return str.str();
+   }
+
+   // latency as an affine expression of the parameters
+   string latencyString()
+   {
+     ostringstream str;
+
+     for (unsigned int i = 0; i < parameters; i++) {
+       str << latency_function[i] << (*parameternames)[i] << " + ";
+     }
+     str << latency_function[parameters];
+
+     return str.str();
    }
 
    // print instance BPP
-   void printInstanceBPP()
+   void printInstanceBPP(ostream &os = cout)
    {
-     cout << instance_bpp + 1 << ",";
+     os << instance_bpp + 1 << ",";
    }
 
    // print number of PEs
-   void printPECount()
+   // solutions whose parametric count has been dropped (lazy mode) print
+   // the fingerprint of the count instead
+   void printPECount(ostream &os = cout)
+   {
+     if (!pe_count) {
+       os << "\"#" << hex << pe_count_fingerprint << dec << "\",";
+       return;
+     }
+
+     os << "\"" << peCountString() << "\",";
+   }
+
+   // parametric PE count as printed by barvinok
+   string peCountString()
+   {
+     return evalueString(pe_count);
+   }
+
+   // a parametric count as printed by barvinok
+   string evalueString(evalue *count)
    {
      const char **param_name;
      // TODO: this is inefficient, but we don't really care much about
@@ -166,113 +607,212 @@ class ProjectionSolution
        param_name[i] = (*parameternames)[i].c_str();
      }
 
-     cout << "\"";
-     print_evalue(stdout, pe_count, param_name);
-     cout << "\",";
-     
+     // barvinok prints to a stdio stream, capture it in memory
+     char  *buffer = NULL;
+     size_t length = 0;
+     FILE  *fp = open_memstream (&buffer, &length);
+
+     print_evalue(fp, count, param_name);
+     fclose (fp);
+
+     string str(buffer, length);
+
+     free (buffer);
      free (param_name);
+
+     return str;
    }
 
    // print number of PEs for 
-   void printInstancePECount()
+   void printInstancePECount(ostream &os = cout)
    {
-     cout << instance_pe_count << ", ";
+     os << instance_pe_count << ", ";
 //     cout << " (maxN=" << maxN << "), ";
    }
 
    // print x1
-   void printX1()
+   void printX1(ostream &os = cout)
    {
-     cout << "X1: \n";
+     os << "X1: \n";
      for (unsigned int i = 0; i < dimensions; i++) {
-       cout << "  " << i << ": ";
+       os << "  " << i << ": ";
+       boost::rational<int> *coeff = x1Coefficients(i);
        for (unsigned int j = 0; j < parameters; j++) {
-         cout << (*parameternames)[j] << (*x1[i])(j) << " + ";
+         os << (*parameternames)[j] << coeff[j] << " + ";
        }
-       cout << (*x1[i])(parameters) << endl;
+       os << coeff[parameters] << endl;
      }
    }
 
    // print x2
-   void printX2()
+   void printX2(ostream &os = cout)
    {
-     cout << "X2: \n";
+     os << "X2: \n";
      for (unsigned int i = 0; i < dimensions; i++) {
-       cout << "  " << i << ": ";
+       os << "  " << i << ": ";
+       boost::rational<int> *coeff = x2Coefficients(i);
        for (unsigned int j = 0; j < parameters; j++) {
-         cout << (*parameternames)[j] << (*x2[i])(j) << " + ";
+         os << (*parameternames)[j] << coeff[j] << " + ";
        }
-       cout << (*x2[i])(parameters) << endl;
+       os << coeff[parameters] << endl;
      }
    }
 
    // print utilization
-   void printUtil()
+   void printUtil(ostream &os = cout)
    {
-     cout << utilization << ",";
+     os << utilization << ",";
    }
 
-   // print latency
-   void printLatency()
+   // print latency, and as a function of the parameters
+   void printLatency(ostream &os = cout)
    {
-     cout << latency << ", ";
+     os << latency << ", \"" << latencyString() << "\", ";
    }
 
    // print schedule
-   void printSchedule()
+   void printSchedule(ostream &os = cout)
    {
-     cout << "\"";
-     for (unsigned int i = 0; i < schedule->NbColumns; i++) {
-       cout << VALUE_TO_INT (schedule->p[0][i]) << " ";
+     os << "\"";
+     for (unsigned int i = 0; i < dimensions; i++) {
+       os << schedule[i] << " ";
      }
-     cout << "\",";
+     os << "\",";
    }
 
    // print network delays
-   void printScheduleDelays()
+   void printScheduleDelays(ostream &os = cout)
    {
-     cout << network_sum_delays << ", " << network_avg_delay << ", " << network_max_delay << ", ";
+     os << network_sum_delays << ", " << network_avg_delay << ", " << network_max_delay << ", ";
    }
 
    // print allocation matrix
-   void printAllocation()
+   void printAllocation(ostream &os = cout)
    {
-     cout << "\"";
-     for (unsigned int i = 0; i < dimensions - 1; i++) {
-       cout << "[ ";
+     os << "\"";
+     for (unsigned int i = 0; i < dimensions - rank; i++) {
+       os << "[ ";
        for (unsigned int j = 0; j < dimensions; j++) {
-         cout << VALUE_TO_INT (allocation->p[i][j]) << " ";
+         os << allocationElement(i, j) << " ";
        }
-       cout << "]";
+       os << "]";
      }
-     cout << "\",";
+     os << "\",";
    }
 
    // print interconnection network info
-   void printNetwork()
+   void printNetwork(ostream &os = cout)
    {
      //cout << network_avg_length;
-     cout << network_avg_length << ", " << network_max_length;
+     os << network_avg_length << ", " << network_max_length;
+   }
+
+   // throughput on the device in problems per cycle, 0 if not partitioned
+   double partitionThroughput()
+   {
+     if (partition_period == 0)
+       return 0;
+
+     return (double) partition_copies / partition_period;
+   }
+
+   // print I/O ports, parametric and for the instance, and the peak I/O
+   // values per cycle, if counted
+   void printIO(ostream &os = cout)
+   {
+     if (instance_io_port_count < 0)
+       return;
+
+     os << ", \"" << (io_port_count ? evalueString(io_port_count) : "")
+        << "\", " << instance_io_port_count << ", " << io_per_cycle;
+   }
+
+   // print delay registers, parametric and for the instance, if counted
+   void printStorage(ostream &os = cout)
+   {
+     if (instance_storage < 0)
+       return;
+
+     os << ", \"" << (storage_count ? evalueString(storage_count) : "")
+        << "\", " << instance_storage;
    }
 
-   Matrix *projection_vector;
-   ublas::vector< boost::rational<int> > *bpp;
-   ublas::vector< boost::rational<int> > **x1;
-   ublas::vector< boost::rational<int> > **x2;
+   // print partition onto the device, if any
+   void printPartition(ostream &os = cout)
+   {
+     if (partition.empty())
+       return;
+
+     os << ", \"" << partition << "\", " << partition_copies << ", "
+        << partition_period << ", " << partitionThroughput() << ", "
+        << partition_memory << ", " << partition_crossing;
+   }
+
+   // integer matrices, contiguous in the arena:
+   //   projection matrix (k x n), schedule (n), allocation (n-k x n), row
+   //   major
+   int *projection_vector;
+   int *schedule;
+   int *allocation;
+
+   // rational coefficients (parameters and constant), contiguous in the
+   // arena: bpp (k rows), x1 (k x n rows), x2 (k x n rows), latency (1 row)
+   boost::rational<int> *bpp;
+   boost::rational<int> *x1;
+   boost::rational<int> *x2;
+   boost::rational<int> *latency_function;
+
    unsigned int instance_bpp;
    unsigned int utilization;
    unsigned int latency;
-   Matrix *schedule;
    unsigned int network_sum_delays;
    unsigned int network_max_delay;
    float network_avg_delay;
-   Matrix *allocation;
    unsigned int network_max_length;
    float network_avg_length;
    evalue *pe_count;
    unsigned int instance_pe_count;
+   unsigned long long pe_count_fingerprint;
+
+   // I/O with the host (see ProjectionSolver::countIOPorts), if counted:
+   // ports receiving inputs or sending outputs, one per PE, dependency and
+   // facet, parametric (NULL if dropped) and for the instance (-1 if not
+   // counted), and the peak I/O values per cycle
+   evalue *io_port_count;
+   int instance_io_port_count;
+   unsigned int io_per_cycle;
+
+   // delay registers of the links (see ProjectionSolver::countStorage), if
+   // counted: parametric (NULL if dropped) and for the instance (-1 if not
+   // counted)
+   evalue *storage_count;
+   int instance_storage;
+
+   // partition onto a device with a fixed number of PEs (see
+   // ArrayPartitioner), empty if not partitioned: copies of the folded
+   // array on the device, cycles between problems on a copy, local memory
+   // of a PE and links between partitions.  not saved, the partition is
+   // computed again from the solution
+   string partition;
+   unsigned int partition_copies;
+   unsigned long partition_period;
+   unsigned long partition_memory;
+   unsigned long partition_crossing;
+
+   // position of the projection vector in the enumeration order
+   unsigned long candidate;
+
+   // status of the candidate
+   Status status;
 //   unsigned int maxN;
 
+   // number of projection directions
+   unsigned int rank;
+
+   // pieces of a piecewise BPP for each direction, empty if the BPP is
+   // affine
+   vector< string > pieces;
+
 private:
 
    unsigned int dimensions;
@@ -280,6 +820,37 @@ private:
    vector< int > *parameterinstantiations;
    vector< string > *parameternames;
 
+   // arena holding the integer and rational arrays
+   SolutionArena *arena;
+
+   // number of integers and rationals in the fixed layout
+   unsigned int integerCount() const
+   {
+     return rank * dimensions + dimensions + (dimensions - rank) * dimensions;
+   }
+
+   unsigned int rationalCount() const
+   {
+     return (parameters + 1) * (rank * (1 + 2 * dimensions) + 1);
+   }
+
+   // carve the integer and rational arrays out of the arena
+   void allocateStorage()
+   {
+     projection_vector = arena->allocate<int> (integerCount());
+     schedule          = projection_vector + rank * dimensions;
+     allocation        = schedule + dimensions;
+
+     bpp = arena->allocate< boost::rational<int> > (rationalCount());
+     x1  = bpp + rank * (parameters + 1);
+     x2  = x1 + rank * dimensions * (parameters + 1);
+
+     latency_function = x2 + rank * dimensions * (parameters + 1);
+   }
+
+   // solutions are copy constructed, never assigned
+   ProjectionSolution &operator=(const ProjectionSolution &);
+
 };
 
 #endif // __PROJECTION_SOLUTION_H__
@@ -6,12 +6,20 @@
 //  May 9 2009
 //
 //  Solve throughput and schedule ILP for given projection vector
+//
+//  A solver of rank k > 1 evaluates projection matrices: k projection
+//  directions, stored row major in the candidate vector, mapping an
+//  n-dimensional recurrence onto an n-k dimensional array.
 
 #ifndef __PROJECTION_SOLVER_H__
 #   define __PROJECTION_SOLVER_H__
 
 #include <cstdio>
+#include <map>
+#include <list>
 #include <string>
+#include <vector>
+#include <sstream>
 #include <cmath>
 
 // pip includes
@@ -25,9 +33,16 @@
 #include <barvinok/basis_reduction.h>
 
 // local includes
+#include "dse-error.hpp"
 #include "projection-solution.hpp"
+#include "solution-arena.hpp"
 #include "throughput-ilp.hpp"
 #include "schedule-ilp.hpp"
+#include "parametric-vertices.hpp"
+#include "allocation-optimizer.hpp"
+#include "gmp-arena.hpp"
+#include "pip-workspace.hpp"
+#include "dimension-kernels.hpp"
 
 class ProjectionSolver
 {
@@ -35,85 +50,105 @@ class ProjectionSolver
  public:
 
    // constructor
+   // throws DSEError if an input file cannot be read, the rank is not less
+   // than the number of dimensions or the domain has no vertices for the
+   // parameter instance
    ProjectionSolver(int _dimensions, int _parameters,
                     vector< int > *_parameterinstantiations,
                     vector< string > *_parameternames,
                     int _pepipelinestages,
                     string polyinputfile, string dependenciesfile,
-                    string verticesfile) :
+                    int _rank = 1) :
      dimensions (_dimensions),
      parameters (_parameters),
      parameterinstantiations (_parameterinstantiations),
      parameternames (_parameternames),
-     pepipelinestages (_pepipelinestages)
+     pepipelinestages (_pepipelinestages),
+     rank (_rank),
+     lazypecount (false),
+     screening (false),
+     iometrics (false),
+     storagecount (false),
+     schedulevariants (1),
+     maxutilization (0),
+     allocationobjective (AllocationOptimizer::NONE),
+     domain (NULL),
+     context (NULL),
+     dependencies (NULL),
+     vertices (NULL),
+     PV (NULL),
+     COB (NULL),
+     COBI (NULL),
+     parameter_inst_pecount (NULL),
+     workspace (NULL),
+     instancedomain (NULL),
+     instancepolyhedron (NULL),
+     COBIinstance (NULL),
+     kernels (_dimensions)
 
    {
-     //
-     // open polyhedron input file
-     //
-     FILE *fp = fopen (polyinputfile.c_str(), "r");
-
-     if (!fp) {
-       cerr << "Failed to open " << polyinputfile << endl;
-       exit (-1);
+     if (_rank < 1 || _rank >= _dimensions) {
+       throw DSEError("Projection rank must be at least 1 and less than the number of dimensions");
      }
 
-     // read in domain (unknowns) and context (parameter inequalities)
-     domain = pip_matrix_read(fp);
-     context = pip_matrix_read(fp);
+     try {
+       //
+       // open polyhedron input file
+       //
+       FILE *fp = openInput (polyinputfile);
 
-     fclose (fp);
+       // read in domain (unknowns) and context (parameter inequalities)
+       domain = pip_matrix_read(fp);
+       context = pip_matrix_read(fp);
 
-     //
-     // open input dependencies file
-     //
-     fp = fopen (dependenciesfile.c_str(), "r");
+       fclose (fp);
 
-     if (!fp) {
-       cerr << "Failed to open " << dependenciesfile << endl;
-       exit (-1);
-     }
+       //
+       // open input dependencies file
+       //
+       fp = openInput (dependenciesfile);
 
-     // read in dependencies matrix
-     // # rows = # dependencies
-     // # columns = # dimensions
-     dependencies = pip_matrix_read(fp);
+       // read in dependencies matrix
+       // # rows = # dependencies
+       // # columns = # dimensions
+       dependencies = pip_matrix_read(fp);
 
-     fclose (fp);
+       fclose (fp);
 
-     if (dependencies->NbColumns != dimensions) {
-       cerr << "Number of columns in dependencies file should equal number of dimensions" << endl;
-       exit(-1);
-     }
+       if (dependencies->NbColumns != dimensions) {
+         throw DSEError("Number of columns in dependencies file should equal number of dimensions");
+       }
 
-     //
-     // open input vertices file
-     //
-     fp = fopen (verticesfile.c_str(), "r");
+       // dependencies as ints, for the network kernels
+       dependencyvalues.resize(dependencies->NbRows * dimensions);
+       for (unsigned int i = 0; i < dependencies->NbRows; i++) {
+         for (unsigned int j = 0; j < dimensions; j++) {
+           dependencyvalues[i * dimensions + j] =
+             VALUE_TO_INT( dependencies->p[i][j] );
+         }
+       }
 
-     if (!fp) {
-       cerr << "Failed to open " << verticesfile << endl;
-       exit (-1);
+       // vertices of the domain in the chamber of the parameter instance
+       vertices = new ParametricVertices(domain, context, dimensions,
+                                         parameters, *parameterinstantiations);
      }
-
-     // read in vertices matrix
-     // # rows = # vertices
-     // # columns = # dimensions
-     vertices = pip_matrix_read(fp);
-
-     fclose (fp);
-
-     if (vertices->NbColumns != dimensions) {
-       cerr << "Number of columns in vertices file should equal number of dimensions" << endl;
-       exit(-1);
+     catch (...) {
+       release();
+       throw;
      }
 
+     // temporary projection matrix used to compute allocations
+     PV = Matrix_Alloc( rank, dimensions );
+
      // temporary variables for counting PEs
      COB = Matrix_Alloc( dimensions + parameters + 1,
                          dimensions + parameters + 1 );
      COBI = Matrix_Alloc( dimensions + parameters + 1,
                           dimensions + parameters + 1 );
 
+     // PIP options, ILP matrices and session
+     workspace = new PipWorkspace();
+
      // parameter instantiations, used to count PEs for an instance of
      // parameters
      parameter_inst_pecount = (Value * ) malloc (sizeof (Value) * _parameters);
@@ -127,53 +162,199 @@ class ProjectionSolver
    // destructor
    ~ProjectionSolver()
    {
-     Matrix_Free (COB);
-     Matrix_Free (COBI);
+     release();
+   }
+   
+   //
+   // evaluate a projection vector: find throughput, schedule, allocation,
+   // interconnection network and number of PEs
+   //
+   ProjectionSolution *evaluate(ublas::vector<int> *pv)
+   {
+     //
+     // Call ILP solver using throughput ILP for this projection vector
+     //
+     ProjectionSolution *ps = findThroughput(pv);
+
+     try {
+       //
+       // Call ILP solver using schedule ILP for this projection vector
+       //
+       findSchedule(ps);
+
+       // networks, allocation and PEs
+       completeSolution(ps);
+     }
+     catch (...) {
+       delete ps;
+       throw;
+     }
+
+     return ps;
+   }
+
+   //
+   // other schedules of the projection of a solution on the utilization /
+   // latency Pareto set: copies of the solution with, in turn, the schedule
+   // of least utilization among those with a lower latency than the last
+   // (epsilon constraint).  at most count schedules with a utilization of
+   // at most maxutilization are found, in the orientation of the solution.
+   // the allocation, its links and the PE count do not depend on the
+   // schedule and are copied.
+   //
+   list<ProjectionSolution *> scheduleVariants(ProjectionSolution *ps,
+                                               unsigned int count,
+                                               unsigned int maxutilization)
+   {
+     list<ProjectionSolution *> variants;
+     unsigned int latency = ps->latency;
 
-     for (unsigned int i = 0; i < parameters; i++) {
-       value_clear (parameter_inst_pecount[i]);
+     while (variants.size() < count && latency > 0) {
+       ProjectionSolution *variant = new ProjectionSolution(*ps);
+
+       try {
+         if (!findScheduleOrientation(variant, latency - 1) ||
+               variant->utilization > maxutilization) {
+           delete variant;
+           break;
+         }
+
+         computeScheduleNetwork(variant);
+
+         // the ports do not depend on the schedule, the peak and the
+         // delay registers do
+         if (iometrics)
+           countIOPeak(variant);
+         if (storagecount)
+           countStorage(variant);
+       }
+       catch (...) {
+         delete variant;
+         for (list<ProjectionSolution *>::iterator i = variants.begin();
+              i != variants.end(); i++) {
+           delete *i;
+         }
+         throw;
+       }
+
+       variants.push_back(variant);
+       latency = variant->latency;
      }
-     free (parameter_inst_pecount);
 
-     pip_matrix_free(domain);
-     pip_matrix_free(context);
+     return variants;
    }
-   
-   // find throughput (block pipelining period) for given projection vector
+
+   //
+   // a solution followed by the other schedules of its projection set by
+   // setScheduleVariants, each a solution of its own.  if the ILPs of the
+   // variants fail, only the solution is kept and the error is reported to
+   // log.
+   //
+   list<ProjectionSolution *> withVariants(ProjectionSolution *ps,
+                                           ostream &log)
+   {
+     list<ProjectionSolution *> solutions;
+
+     if (schedulevariants > 1 && ps->status == ProjectionSolution::OK) {
+       try {
+         solutions = scheduleVariants(ps, schedulevariants - 1,
+                                      maxutilization);
+       }
+       catch (DSEError &err) {
+         log << "Schedule variants of candidate " << ps->candidate
+             << " failed: " << err.what() << endl;
+       }
+     }
+
+     solutions.push_front(ps);
+
+     return solutions;
+   }
+
+   //
+   // complete a solution with a throughput and schedule: networks,
+   // allocation and number of PEs
+   //
+   void completeSolution(ProjectionSolution *ps)
+   {
+     // compute delays induced by schedule
+     computeScheduleNetwork(ps);
+
+     // compute allocation matrix
+     computeAllocation(ps);
+
+     // compute size of interconnection network links
+     computeInterconnectionNetwork(ps);
+
+     // compute number of PEs in this projection
+     countPEs(ps);
+
+     // compute throughput for an instance of the problem
+     // parameter instances are given in the options file
+     ps->computeInstanceBPP();
+
+     // I/O with the host
+     if (iometrics) {
+       countIOPorts(ps);
+       countIOPeak(ps);
+     }
+
+     // delay registers
+     if (storagecount)
+       countStorage(ps);
+   }
+
+   // find throughput (block pipelining period) for given projection vector.
+   // a projection of rank k solves one ILP per direction.
    ProjectionSolution *findThroughput(ublas::vector<int> *pv)
    {
-     PipOptions *options;
      PipQuast   *solution;
-     ProjectionSolution *ps;
 
+     // Projection solution
+     // Solution is in terms of parameters and const
+     ProjectionSolution *ps = newSolution();
 
      //
-     // generate parameterized ILP to compute throughput for a fixed
-     // projection vector
+     // assign projection vector
      //
-     ThroughputILP ilp(domain, context, dimensions, parameters,
-                       pv);
+     for (unsigned int i = 0; i < rank * dimensions; i++) {
+       ps->projection_vector[i] = (*pv)[i];
+     }
 
-     //
-     // solve throughput ILP
-     //
-     // initialize options for PIP solver
-     options = pip_options_init();
+     for (unsigned int dir = 0; dir < rank; dir++) {
+       // integers of the ILP and its QUAST are taken from the arena
+       GMPArena::Scope arena;
 
-     // call solver
-     solution = pip_solve(ilp.getILP(), ilp.getContext(),
-                          ilp.getBigParamPos(), options);
+       //
+       // generate parameterized ILP to compute throughput for a fixed
+       // projection vector
+       //
+       ThroughputILP ilp(screening ? instancedomain : domain, context,
+                         dimensions, parameters, pv, rank, dir, workspace);
 
-     // extract throughput solution for this projection
-     ps = extractThroughputSolution(solution, pv);
+       //
+       // solve throughput ILP
+       //
+       // call solver
+       solution = pip_solve(ilp.getILP(), ilp.getContext(),
+                            ilp.getBigParamPos(), workspace->getOptions());
 
-     // print QUAST of solution
-//     pip_quast_print(stdout, solution, 0);
+       // extract throughput solution for this projection
+       try {
+         extractThroughputSolution(solution, ps, dir);
+       }
+       catch (...) {
+         pip_quast_free(solution);
+         delete ps;
+         throw;
+       }
 
-     // free memory
-     pip_options_free(options);
-     pip_quast_free(solution);
-     pip_close();
+       // print QUAST of solution
+//       pip_quast_print(stdout, solution, 0);
+
+       // free memory
+       pip_quast_free(solution);
+     }
 
      return ps;
    }
@@ -181,70 +362,79 @@ class ProjectionSolver
    // find schedule compatible with projection vector
    void findSchedule(ProjectionSolution *ps)
    {
-     PipOptions *options;
-     PipQuast   *solution;
+     // no solution to the ILP: negate the projection vector and retry.
+     // rank k: try every combination of signs of the directions, flipping
+     // one direction between consecutive attempts (Gray code)
+     for (unsigned int attempt = 0; attempt < (1u << rank); attempt++) {
+       if (attempt > 0) {
+//         cout << "No solution, trying to negate projection vector" << endl;
+
+         // invert projection vector
+         unsigned int dir = 0;
+         while (!(attempt & (1u << dir))) {
+           dir++;
+         }
+         for (unsigned int i = 0; i < dimensions; i++) {
+           ps->projectionElement(dir, i) = -ps->projectionElement(dir, i);
+         }
+       }
+
+       if (findScheduleOrientation(ps))
+         return;
+     }
+
+     throw DSEError("Unable to find schedule for projection vector");
+   }
 
-     // temporary (big num) for manipulation
-     Entier tmp;
-     entier_init (tmp);
+   // find schedule compatible with the projection vector of a solution,
+   // without negating it, with a latency of at most latencybound unless it
+   // is -1.  returns false if there is no schedule.
+   bool findScheduleOrientation(ProjectionSolution *ps, int latencybound = -1)
+   {
+     PipQuast   *solution;
 
+     // integers of the ILP and its QUAST are taken from the arena
+     GMPArena::Scope arena;
 
      //
      // generate ILP to compute schedule compatible with projection vector
      // minimizing array utilization and latency
      //
-     ScheduleILP ilp(dimensions, parameters, dependencies, vertices,
-                     pepipelinestages, ps);
+     ScheduleILP ilp(dimensions, parameters, dependencies,
+                     vertices->getInstanceVertices(),
+                     pepipelinestages, ps, workspace, latencybound);
 
      //
      // solve throughput ILP
      //
-     // initialize options for PIP solver
-     options = pip_options_init();
-
      // call solver
      solution = pip_solve(ilp.getILP(), ilp.getContext(),
-                          ilp.getBigParamPos(), options);
-
-     // extract schedule solution
-     int res = extractScheduleSolution(solution, ps);
-
-     // there was no solution to the ILP.  Negate projection vector and
-     // retry
-     if (res < 0) {
-//       cout << "No solution, trying to negate projection vector" << endl;
-
-       // invert projection vector
-       for (unsigned int i = 0; i < dimensions; i++) {
-         entier_oppose (tmp, ps->projection_vector->p[0][i]);
-         entier_assign (ps->projection_vector->p[0][i], tmp);
-       }
-
-       // regenerate ilp with new projection vector
-       ilp.regenILP(dimensions, parameters, dependencies, vertices,
-                    pepipelinestages, ps);
+                          ilp.getBigParamPos(), workspace->getOptions());
 
-       // call solver
-       solution = pip_solve(ilp.getILP(), ilp.getContext(),
-                            ilp.getBigParamPos(), options);
+     int res;
 
+     try {
        // extract schedule solution
        res = extractScheduleSolution(solution, ps);
-
-       if (res < 0) {
-         cerr << "Unable to find schedule for projection vector" << endl;
-         exit (-1);
-       }
+     }
+     catch (...) {
+       pip_quast_free(solution);
+       throw;
      }
 
      // print QUAST of solution
 //     pip_quast_print(stdout, solution, 0);
 
      // free memory
-     entier_clear (tmp);
-     pip_options_free(options);
      pip_quast_free(solution);
-     pip_close();
+
+     if (res != 0)
+       return false;
+
+     // latency for all parameters of the chamber of the instance
+     vertices->latencyFunction(ps->schedule, ps->latencyCoefficients());
+
+     return true;
    }
 
    //
@@ -260,23 +450,8 @@ class ProjectionSolver
 
      // matrix multiply schedule and dependencies
      // number of dependencies is stored in dependencies->NbRows
-     int prod;
-     for (unsigned int i = 0; i < dependencies->NbRows; i++) {
-       prod = 0;
-       for (unsigned int j = 0; j < dimensions; j++) {
-         prod += VALUE_TO_INT( ps->schedule->p[0][j] ) *
-                   VALUE_TO_INT( dependencies->p[i][j] );
-       }
-
-       // negate delay
-       prod = -prod;
-
-       // find longest delay
-       if (prod > max_delay) max_delay = prod;
-
-       // find sum of delays of all links
-       sum_delays += prod;
-     }
+     kernels.delays(ps->schedule, &dependencyvalues[0], dependencies->NbRows,
+                    max_delay, sum_delays);
 
      ps->network_sum_delays = sum_delays;
      ps->network_max_delay  = max_delay;
@@ -290,32 +465,57 @@ class ProjectionSolver
    // we simply find the nullspace basis of the projection vector
    // which become the n-1 rows of the allocation matrix.
    //
+   // rank k: the allocation is the n-k x n nullspace basis of the k x n
+   // projection matrix.
+   //
    // the allocation matrix with the schedule as the last row is the
    // change of basis matrix.
    //
    // the change of basis matrix must be unimodular (determinant = +1 or -1)
    //
+   // the basis found by int_ker is arbitrary.  with an allocation objective
+   // it is replaced by a basis with shorter links.
+   //
    void computeAllocation(ProjectionSolution *ps)
    {
-     Matrix *allocation;
+     Matrix *kernel;
+
+     // copy projection vector into a polylib matrix
+     for (unsigned int r = 0; r < rank; r++) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         value_set_si (PV->p[r][i], ps->projectionElement(r, i));
+       }
+     }
 
      // compute the integer kernel (nullspace) of the projection vector
-     allocation = int_ker ( ps->projection_vector );
+     kernel = int_ker ( PV );
 
-     if (!allocation) {
-       cerr << "Failed to find nullspace of projection vector" << endl;
-       exit (-1);
+     if (!kernel) {
+       throw DSEError("Failed to find nullspace of projection vector");
      }
 
-     // nullspace must be of dimension n x n-1
-     if (allocation->NbRows != dimensions ||
-           allocation->NbColumns != dimensions-1) {
-       cerr << "Nullspace of projection vector is of invalid dimension" << endl;
-       exit (-1);
+     // nullspace must be of dimension n x n-k
+     if (kernel->NbRows != dimensions ||
+           kernel->NbColumns != dimensions-rank) {
+       Matrix_Free (kernel);
+       throw DSEError("Nullspace of projection vector is of invalid dimension");
+     }
+
+     // transpose the nullspace into the projection solution
+     for (unsigned int i = 0; i < dimensions - rank; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         ps->allocationElement(i, j) = VALUE_TO_INT( kernel->p[j][i] );
+       }
      }
 
-     // transpose the nullspace
-     allocation = Transpose ( allocation );
+     Matrix_Free (kernel);
+
+     // any other basis of the nullspace is an allocation as well, pick one
+     // with short links
+     if (allocationobjective != AllocationOptimizer::NONE) {
+       AllocationOptimizer optimizer(dimensions, rank, dependencies);
+       optimizer.optimize(ps, allocationobjective);
+     }
 
 #if 0
      // add a row to copy schedule
@@ -323,12 +523,9 @@ class ProjectionSolver
      
      // copy schedule to last row
      for (unsigned int i = 0; i < dimensions; i++) {
-       changeofbasis->p[dimensions-1][i] = ps->schedule->p[0][i];
+       value_set_si (changeofbasis->p[dimensions-1][i], ps->schedule[i]);
      }
 #endif
-
-     // assign to projection solution
-     ps->allocation = allocation;
    }
 
    //
@@ -343,29 +540,10 @@ class ProjectionSolver
      int max_length = 0;
      int sum_lengths = 0;
 
-     Matrix *allocation = ps->allocation;
-
      // matrix multiply allocation and dependencies
      // number of dependencies is stored in dependencies->NbRows
-     int prod;
-     for (unsigned int i = 0; i < allocation->NbRows; i++) {
-       for (unsigned int j = 0; j < dependencies->NbRows; j++) {
-         prod = 0;
-         for (unsigned int k = 0; k < allocation->NbColumns; k++) {
-           prod += VALUE_TO_INT( allocation->p[i][k] ) * 
-                     VALUE_TO_INT( dependencies->p[j][k] );
-         }
-
-         // check absolute value
-         prod = abs (prod);
-
-         // find length of the furthest link
-         if (prod > max_length) max_length = prod;
-
-         // find sum of lengths of all links
-         sum_lengths += prod;
-       }
-     }
+     kernels.lengths(ps->allocation, dimensions - rank, &dependencyvalues[0],
+                     dependencies->NbRows, max_length, sum_lengths);
 
      ps->network_max_length  = max_length;
      ps->network_avg_length  = (float) sum_lengths / dependencies->NbRows;
@@ -384,52 +562,22 @@ class ProjectionSolver
    //
    // we then find the number of points in the integer projection of the
    // transformed polyhedron.
+   //
+   // rank k: the allocation is completed with the k projection directions,
+   // which are orthogonal to its rows, and the last k dimensions are
+   // existential.
    // we can alternatively find the number of integer points in the projection
    // of the transformed polyhedron (not enabled by default).
    //
    void countPEs(ProjectionSolution *ps)
    {
-     // dimension of COB matrix = # dimensions in polyhedron + # parameters +
-     //                           one for the constant
-     unsigned int COB_dimensions = dimensions + parameters + 1;
-
-     // Initialize matrix to zero (matrix COB and COB inverse have been
-     // allocated in constructor)
-     for (unsigned int i = 0; i < COB_dimensions; i++) {
-       for (unsigned int j = 0; j < COB_dimensions; j++) {
-         value_set_si (COB->p[i][j], 0);
-       }
-     }
-
-     // copy allocation matrix
-     for (unsigned int i = 0; i < dimensions - 1; i++) {
-       for (unsigned int j = 0; j < dimensions; j++) {
-         value_assign (COB->p[i][j], ps->allocation->p[i][j]);
-       }
-     }
+     changeOfBasis(ps);
 
-     // copy schedule as final dimension which will be the existential
-     // variable
-     for (unsigned int i = 0; i < dimensions; i++) {
-       value_assign (COB->p[dimensions - 1][i], ps->schedule->p[0][i]);
-     }
-     
-     // parameters
-     for (unsigned int i = 0; i < parameters; i++) {
-       value_set_si (COB->p[dimensions + i][dimensions + i], 1);
+     // screening: count the PEs of the parameter instance only
+     if (screening) {
+       countInstancePEs(ps);
+       return;
      }
-     
-     // constant
-     value_set_si (COB->p[dimensions + parameters][dimensions + parameters], 1);
-
-     //
-     // now we need to transform the original polyhedron by applying
-     // PreImage (P, COB_inverse)
-     //
-
-     // first find inverse of COB matrix
-     Matrix_Inverse (COB, COBI);
-//     Matrix_Print ( stdout, P_VALUE_FMT, COBI );
 
      Polyhedron *dom = Constraints2Polyhedron ( (Matrix *) domain, 256);
 
@@ -496,8 +644,8 @@ class ProjectionSolver
      // we use the barvinok library treating the final dimension (time)
      // as an existential variable
      //
-     // we have 1 existential variable and #parameters
-     ps->pe_count = barvinok_enumerate_e (cobdom, 1, parameters, 256);
+     // we have rank existential variables and #parameters
+     ps->pe_count = barvinok_enumerate_e (cobdom, rank, parameters, 256);
 #if 0
      Polyhedron *con = Constraints2Polyhedron ( (Matrix *) context, 256);
      ps->pe_count = barvinok_enumerate_ev (dom, con, 256);
@@ -507,6 +655,15 @@ class ProjectionSolver
      ps->instance_pe_count = (int) compute_evalue (ps->pe_count,
                                                    parameter_inst_pecount);
 
+     // in lazy mode keep only the instance count and a fingerprint of the
+     // parametric count.  the count is recomputed for solutions that are
+     // printed and verified against the fingerprint
+     if (lazypecount) {
+       ps->pe_count_fingerprint = fingerprintPECount (ps->pe_count);
+       evalue_free (ps->pe_count);
+       ps->pe_count = NULL;
+     }
+
 #if 0
      Value *parameter_inst_tmp = (Value * ) malloc (sizeof (Value) * parameters);
      for (unsigned int i = 0; i < parameters; i++) {
@@ -530,48 +687,787 @@ class ProjectionSolver
      Polyhedron_Free (cobdom);
    }
 
-private:
-
-   int extractScheduleUnknowns(
-                       PipNewparm *newparm,
-                       PipVector  *pv,   // unknown's PIP solution
-                       boost::rational<int> *bigparmcoeff
-                      )
+   //
+   // change of basis of a solution (see countPEs) and its inverse.  when
+   // screening, also the inverse for the parameter instance.
+   //
+   void changeOfBasis(ProjectionSolution *ps)
    {
-     int unknown;
+     // dimension of COB matrix = # dimensions in polyhedron + # parameters +
+     //                           one for the constant
+     unsigned int COB_dimensions = dimensions + parameters + 1;
 
-     // constant coefficient
-     if (VALUE_TO_INT( pv->the_deno[1] ) != 1) {
-       cerr << "Schedule solution is not integral" << endl;
-       exit(-1);
-     } else {
-       unknown = VALUE_TO_INT( pv->the_vector[1] );
+     // Initialize matrix to zero (matrix COB and COB inverse have been
+     // allocated in constructor)
+     for (unsigned int i = 0; i < COB_dimensions; i++) {
+       for (unsigned int j = 0; j < COB_dimensions; j++) {
+         value_set_si (COB->p[i][j], 0);
+       }
      }
 
-     // rational for the BIG PARAMETER used internally for the maximization ILP
-     bigparmcoeff->assign(
-               VALUE_TO_INT( pv->the_vector[0] ),
-               VALUE_TO_INT( pv->the_deno[0] )
-           );
+     // copy allocation matrix
+     for (unsigned int i = 0; i < dimensions - rank; i++) {
+       for (unsigned int j = 0; j < dimensions; j++) {
+         value_set_si (COB->p[i][j], ps->allocationElement(i, j));
+       }
+     }
 
-     // we should not have newparm
-     if (newparm) {
-       cerr << "Cannot handle newparm in schedule solution" << endl;
-       exit(-1);
+     if (rank == 1) {
+       // copy schedule as final dimension which will be the existential
+       // variable
+       for (unsigned int i = 0; i < dimensions; i++) {
+         value_set_si (COB->p[dimensions - 1][i], ps->schedule[i]);
+       }
+     } else {
+       // copy projection directions as the existential variables
+       for (unsigned int r = 0; r < rank; r++) {
+         for (unsigned int i = 0; i < dimensions; i++) {
+           value_set_si (COB->p[dimensions - rank + r][i],
+                         ps->projectionElement(r, i));
+         }
+       }
+     }
+     
+     // parameters
+     for (unsigned int i = 0; i < parameters; i++) {
+       value_set_si (COB->p[dimensions + i][dimensions + i], 1);
      }
+     
+     // constant
+     value_set_si (COB->p[dimensions + parameters][dimensions + parameters], 1);
 
-     return unknown;     
+     //
+     // now we need to transform the original polyhedron by applying
+     // PreImage (P, COB_inverse)
+     //
+
+     // first find inverse of COB matrix
+     Matrix_Inverse (COB, COBI);
+//     Matrix_Print ( stdout, P_VALUE_FMT, COBI );
+
+     if (screening)
+       instanceChangeOfBasis();
    }
 
-   // extract schedule and array utilization from the QUAST returned by
-   // the ILP solver
    //
-   // return 0 if solution extracted successfully
-   //       -1 if no solution
-   int extractScheduleSolution(PipQuast *solution, ProjectionSolution *ps)
+   // recompute the parametric PE count of a solution whose count was
+   // dropped in lazy mode or not saved.  a count dropped in lazy mode must
+   // match the fingerprint taken when the solution was first counted.
+   //
+   void restorePECount(ProjectionSolution *ps)
    {
-     //
-     // no solution to schedule ILP, try negating projection vector
+     if (ps->pe_count)
+       return;
+
+     unsigned long long fingerprint = ps->pe_count_fingerprint;
+
+     bool lazy = lazypecount;
+     lazypecount = false;
+     countPEs(ps);
+     if (iometrics)
+       countIOPorts(ps);
+     if (storagecount)
+       countStorage(ps);
+     lazypecount = lazy;
+
+     if (fingerprint != 0 &&
+           fingerprintPECount (ps->pe_count) != fingerprint) {
+       throw DSEError("Recomputed PE count does not match fingerprint");
+     }
+   }
+
+   //
+   // count the delay registers of a solution.  dependency d has a link of
+   // delay -schedule . d into every PE that executes a point x whose value
+   // of d comes from the point x + d of the domain, so d needs that many
+   // registers on each PE of the points of the domain with x + d in the
+   // domain, counted as in countPEs (parametric, or for the instance when
+   // screening).  the storage is the sum over the dependencies.
+   //
+   void countStorage(ProjectionSolution *ps)
+   {
+     if (ps->storage_count) {
+       evalue_free (ps->storage_count);
+       ps->storage_count = NULL;
+     }
+
+     changeOfBasis(ps);
+
+     evalue *storage = evalue_zero();
+
+     Value delay;
+     value_init (delay);
+
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       int d = 0;
+       for (unsigned int j = 0; j < dimensions; j++) {
+         d -= ps->schedule[j] * dependencyvalues[k * dimensions + j];
+       }
+
+       if (d == 0)
+         continue;
+
+       Matrix *constraints = linkConstraints(k, screening);
+       Polyhedron *links = Constraints2Polyhedron (constraints, 256);
+       workspace->releaseMatrix(constraints);
+
+       Polyhedron *coblinks = Polyhedron_Preimage (links,
+                                  screening ? COBIinstance : COBI, 256);
+
+       evalue *count = barvinok_enumerate_e (coblinks, rank,
+                                             screening ? 0 : parameters,
+                                             256);
+       value_set_si (delay, d);
+       evalue_mul (count, delay);
+       eadd (count, storage);
+
+       evalue_free (count);
+       Polyhedron_Free (coblinks);
+       Polyhedron_Free (links);
+     }
+
+     value_clear (delay);
+
+     ps->instance_storage = (int) compute_evalue (storage,
+                                                  parameter_inst_pecount);
+
+     // screened and lazy solutions keep the instance count only
+     if (screening || lazypecount) {
+       evalue_free (storage);
+       storage = NULL;
+     }
+
+     ps->storage_count = storage;
+   }
+
+   //
+   // count the I/O ports of a solution: a PE has a port for every
+   // dependency and facet through which it receives a value from outside
+   // the domain (an input) or sends one out of it (an output).  inputs of
+   // dependency d are the points x with x + d outside the domain, so on the
+   // facets r with c_r . d < 0: each facet gives a slab c_r(x + d) <= -1 of
+   // the domain, whose PEs are counted as in countPEs (parametric, or for
+   // the instance when screening).  outputs are the same with -d.  the
+   // ports are summed over the slabs, so a PE on slabs of several facets or
+   // dependencies counts once for each: this is the number of ports, not
+   // of distinct I/O PEs.  countPEs must have been called for the
+   // allocation of the solution.
+   //
+   void countIOPorts(ProjectionSolution *ps)
+   {
+     if (ps->io_port_count) {
+       evalue_free (ps->io_port_count);
+       ps->io_port_count = NULL;
+     }
+
+     evalue *ports = evalue_zero();
+
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       for (unsigned int r = 0; r < domain->NbRows; r++) {
+         for (int shift = 1; shift >= -1; shift -= 2) {
+           Matrix *constraints = slabConstraints(k, r, shift, screening);
+
+           if (!constraints)
+             continue;
+
+           Polyhedron *slab = Constraints2Polyhedron (constraints, 256);
+           workspace->releaseMatrix(constraints);
+
+           Polyhedron *cobslab = Polyhedron_Preimage (slab,
+                                      screening ? COBIinstance : COBI, 256);
+
+           evalue *count = barvinok_enumerate_e (cobslab, rank,
+                                                 screening ? 0 : parameters,
+                                                 256);
+           eadd (count, ports);
+
+           evalue_free (count);
+           Polyhedron_Free (cobslab);
+           Polyhedron_Free (slab);
+         }
+       }
+     }
+
+     ps->instance_io_port_count = (int) compute_evalue (ports,
+                                                      parameter_inst_pecount);
+
+     // screened and lazy solutions keep the instance count only
+     if (screening || lazypecount) {
+       evalue_free (ports);
+       ports = NULL;
+     }
+
+     ps->io_port_count = ports;
+   }
+
+   //
+   // peak number of I/O values per cycle at the parameter instance.
+   // problems are started every BPP cycles, so the I/O values of the time
+   // steps that are congruent modulo the period P = BPP + 1 move in the
+   // same cycle.  the I/O points of each slab (see countIOPorts) are
+   // counted in closed form per residue class: the points with
+   // schedule . x = P q + c, for a parameter c in [0, P).  q is fixed by x
+   // and c, so this is a plain parametric count.  the peak is the largest
+   // sum over the slabs, over the residues of the time steps of the
+   // instance domain (fewer than P if the schedule is shorter).
+   //
+   void countIOPeak(ProjectionSolution *ps)
+   {
+     if (instancepoints.empty())
+       instancepoints = instanceVertices();
+
+     // time steps of the instance domain
+     double first = 0, last = 0;
+     for (unsigned int v = 0; v < instancepoints.size(); v++) {
+       double t = 0;
+       for (unsigned int i = 0; i < dimensions; i++) {
+         t += ps->schedule[i] * instancepoints[v][i];
+       }
+
+       if (v == 0 || t < first) first = t;
+       if (v == 0 || t > last)  last = t;
+     }
+
+     long tmin = (long) ceil (first), tmax = (long) floor (last);
+     long period = ps->instance_bpp + 1;
+
+     // residues of the time steps
+     long residues = min(period, max(tmax - tmin + 1, 0L));
+
+     vector< double > values(residues, 0.);
+
+     Value residue;
+     value_init (residue);
+
+     for (unsigned int k = 0; k < dependencies->NbRows; k++) {
+       for (unsigned int r = 0; r < domain->NbRows; r++) {
+         for (int shift = 1; shift >= -1; shift -= 2) {
+           Matrix *slab = slabConstraints(k, r, shift, true);
+
+           if (!slab)
+             continue;
+
+           // the slab with the variable q and the parameter c:
+           // schedule . x = P q + c, 0 <= c < P
+           Matrix *constraints = workspace->allocateMatrix(slab->NbRows + 3,
+                                                           dimensions + 4);
+
+           for (unsigned int i = 0; i < slab->NbRows; i++) {
+             for (unsigned int j = 0; j <= dimensions; j++) {
+               value_assign (constraints->p[i][j], slab->p[i][j]);
+             }
+             value_set_si (constraints->p[i][dimensions + 1], 0);
+             value_set_si (constraints->p[i][dimensions + 2], 0);
+             value_assign (constraints->p[i][dimensions + 3],
+                           slab->p[i][dimensions + 1]);
+           }
+
+           unsigned int row = slab->NbRows;
+           for (unsigned int j = 0; j < dimensions + 4; j++) {
+             value_set_si (constraints->p[row][j], 0);
+             value_set_si (constraints->p[row + 1][j], 0);
+             value_set_si (constraints->p[row + 2][j], 0);
+           }
+
+           for (unsigned int j = 0; j < dimensions; j++) {
+             value_set_si (constraints->p[row][1 + j], ps->schedule[j]);
+           }
+           value_set_si (constraints->p[row][dimensions + 1], - period);
+           value_set_si (constraints->p[row][dimensions + 2], -1);
+
+           value_set_si (constraints->p[row + 1][0], 1);
+           value_set_si (constraints->p[row + 1][dimensions + 2], 1);
+
+           value_set_si (constraints->p[row + 2][0], 1);
+           value_set_si (constraints->p[row + 2][dimensions + 2], -1);
+           value_set_si (constraints->p[row + 2][dimensions + 3],
+                         period - 1);
+
+           workspace->releaseMatrix(slab);
+
+           Polyhedron *P = Constraints2Polyhedron (constraints, 256);
+           workspace->releaseMatrix(constraints);
+
+           evalue *count = barvinok_enumerate_e (P, 0, 1, 256);
+
+           for (long t = tmin; t < tmin + residues; t++) {
+             value_set_si (residue, ((t % period) + period) % period);
+             values[t - tmin] += compute_evalue (count, &residue);
+           }
+
+           evalue_free (count);
+           Polyhedron_Free (P);
+         }
+       }
+     }
+
+     value_clear (residue);
+
+     double peak = 0;
+     for (long i = 0; i < residues; i++) {
+       if (values[i] > peak) peak = values[i];
+     }
+
+     ps->io_per_cycle = (unsigned int) (peak + 0.5);
+   }
+
+   //
+   // width of the domain along each dimension (largest minus smallest
+   // coordinate) for the instance of the parameters, rounded down.  points
+   // x1, x2 projected onto one PE by u satisfy x1 - x2 = k u, so k never
+   // exceeds width_i / |u_i|.
+   //
+   vector< int > instanceWidths()
+   {
+     vector< vector< double > > points = instanceVertices();
+
+     vector< int > widths(dimensions, 0);
+     for (unsigned int i = 0; !points.empty() && i < dimensions; i++) {
+       double lo = points[0][i], hi = points[0][i];
+
+       for (unsigned int v = 1; v < points.size(); v++) {
+         if (points[v][i] < lo) lo = points[v][i];
+         if (points[v][i] > hi) hi = points[v][i];
+       }
+
+       widths[i] = (int) floor (hi - lo);
+     }
+
+     return widths;
+   }
+
+   //
+   // vertices of the domain for the instance of the parameters
+   //
+   vector< vector< double > > instanceVertices()
+   {
+     PipMatrix *M = vertices->getInstanceVertices();
+     double denominator = VALUE_TO_INT( M->p[0][dimensions] );
+
+     vector< vector< double > > points(M->NbRows, vector< double >(dimensions));
+
+     for (unsigned int v = 0; v < M->NbRows; v++) {
+       for (unsigned int i = 0; i < dimensions; i++) {
+         points[v][i] = VALUE_TO_INT( M->p[v][i] ) / denominator;
+       }
+     }
+
+     return points;
+   }
+
+   // allocate an empty projection solution for this polyhedron
+   ProjectionSolution *newSolution()
+   {
+     return new ProjectionSolution(dimensions,
+                                   parameters,
+                                   parameterinstantiations,
+                                   parameternames,
+                                   &arena,
+                                   rank
+                                   );
+   }
+
+   // number of projection directions
+   unsigned int getRank()
+   {
+     return rank;
+   }
+
+   // domain constraints and dependencies read from the input files
+   PipMatrix *getDomain()
+   {
+     return domain;
+   }
+
+   PipMatrix *getContext()
+   {
+     return context;
+   }
+
+   PipMatrix *getDependencies()
+   {
+     return dependencies;
+   }
+
+   // release the storage of all solutions allocated by this solver.  all
+   // solutions must have been deleted.
+   void resetArena()
+   {
+     arena.reset();
+   }
+
+   // keep only instance PE counts, dropping parametric counts
+   void setLazyPECount(bool _lazypecount)
+   {
+     lazypecount = _lazypecount;
+   }
+
+   //
+   // screen candidates at the parameter instance: throughput ILPs are
+   // generated from the domain with the parameters replaced by their
+   // instance values, and PEs are counted for the instance only.  screened
+   // solutions rank exactly as parametric ones do, but their BPP is a
+   // constant and they have no parametric PE count, so they must be
+   // evaluated again without screening before they are printed.
+   //
+   void setScreening(bool _screening)
+   {
+     screening = _screening;
+
+     if (screening && !instancedomain)
+       instantiateDomain();
+   }
+
+   // choose allocations with short links (see AllocationOptimizer)
+   void setAllocationObjective(int objective)
+   {
+     allocationobjective = (AllocationOptimizer::Objective) objective;
+   }
+
+   // count the I/O ports and the peak I/O values per cycle of solutions
+   // (see countIOPorts and countIOPeak)
+   void setIOMetrics(bool _iometrics)
+   {
+     iometrics = _iometrics;
+   }
+
+   // count the delay registers of solutions (see countStorage)
+   void setStorageCount(bool _storagecount)
+   {
+     storagecount = _storagecount;
+   }
+
+   // keep up to count schedules of each projection, with a utilization of
+   // at most _maxutilization (see withVariants)
+   void setScheduleVariants(unsigned int count, unsigned int _maxutilization)
+   {
+     schedulevariants = count;
+     maxutilization = _maxutilization;
+   }
+
+private:
+
+   // open an input file for reading
+   FILE *openInput(string filename)
+   {
+     FILE *fp = fopen (filename.c_str(), "r");
+
+     if (!fp) {
+       throw DSEError("Failed to open " + filename);
+     }
+
+     return fp;
+   }
+
+   // free input matrices and temporaries.  members that were never
+   // allocated are NULL.
+   void release()
+   {
+     if (PV)   Matrix_Free (PV);
+     if (COB)  Matrix_Free (COB);
+     if (COBI) Matrix_Free (COBI);
+
+     if (parameter_inst_pecount) {
+       for (unsigned int i = 0; i < parameters; i++) {
+         value_clear (parameter_inst_pecount[i]);
+       }
+       free (parameter_inst_pecount);
+     }
+
+     if (domain)       pip_matrix_free(domain);
+     if (context)      pip_matrix_free(context);
+     if (dependencies) pip_matrix_free(dependencies);
+
+     delete vertices;
+     delete workspace;
+
+     if (instancedomain)     pip_matrix_free(instancedomain);
+     if (instancepolyhedron) Polyhedron_Free(instancepolyhedron);
+     if (COBIinstance)       Matrix_Free (COBIinstance);
+
+     PV = COB = COBI = NULL;
+     parameter_inst_pecount = NULL;
+     domain = context = dependencies = NULL;
+     vertices = NULL;
+     workspace = NULL;
+     instancedomain = NULL;
+     instancepolyhedron = NULL;
+     COBIinstance = NULL;
+   }
+
+   //
+   // domain of the parameter instance, for screening.  the parameters of
+   // each constraint are folded into its constant; the PIP matrix keeps
+   // the parameter columns (as zeros) so that throughput ILPs have the
+   // same shape, the polyhedron has the dimensions only.
+   //
+   void instantiateDomain()
+   {
+     unsigned int constant = dimensions + parameters + 1;
+
+     instancedomain = pip_matrix_alloc(domain->NbRows, domain->NbColumns);
+     Matrix *constraints = Matrix_Alloc(domain->NbRows, dimensions + 2);
+
+     for (unsigned int i = 0; i < domain->NbRows; i++) {
+       long long c = VALUE_TO_INT( domain->p[i][constant] );
+       for (unsigned int j = 0; j < parameters; j++) {
+         c += (long long) VALUE_TO_INT( domain->p[i][1 + dimensions + j] ) *
+                (*parameterinstantiations)[j];
+       }
+
+       for (unsigned int j = 0; j <= dimensions; j++) {
+         entier_assign (instancedomain->p[i][j], domain->p[i][j]);
+         value_assign (constraints->p[i][j], domain->p[i][j]);
+       }
+       for (unsigned int j = 0; j < parameters; j++) {
+         entier_set_si (instancedomain->p[i][1 + dimensions + j], 0);
+       }
+       entier_set_si (instancedomain->p[i][constant], c);
+       value_set_si (constraints->p[i][dimensions + 1], c);
+     }
+
+     instancepolyhedron = Constraints2Polyhedron (constraints, 256);
+     Matrix_Free (constraints);
+
+     COBIinstance = Matrix_Alloc( dimensions + 1, dimensions + 1 );
+   }
+
+   //
+   // count the PEs of a solution for the parameter instance only.  the
+   // change of basis is block diagonal (dimensions, parameters, constant),
+   // so the rows and columns of the dimensions and the constant of its
+   // inverse transform the instance domain.  the count has no parameters.
+   //
+   void countInstancePEs(ProjectionSolution *ps)
+   {
+     Polyhedron *cobdom = Polyhedron_Preimage (instancepolyhedron,
+                                               COBIinstance, 256);
+
+     evalue *count = barvinok_enumerate_e (cobdom, rank, 0, 256);
+
+     ps->instance_pe_count = (int) compute_evalue (count,
+                                                   parameter_inst_pecount);
+     ps->pe_count = NULL;
+     ps->pe_count_fingerprint = 0;
+
+     evalue_free (count);
+     Polyhedron_Free (cobdom);
+   }
+
+   //
+   // constraints of the slab of the domain whose points x have x + shift d
+   // outside the domain across facet r, for dependency d in row k: the
+   // domain and c_r(x + shift d) <= -1.  only facets with
+   // shift c_r . d < 0 have such points; an equality with c_r . d != 0 has
+   // them all.  with instance, the parameters are replaced by their
+   // instance values and the constraints have the dimensions only.
+   // returns NULL if there are no such points.  the matrix is from the
+   // workspace, release it there.
+   //
+   Matrix *slabConstraints(unsigned int k, unsigned int r, int shift,
+                           bool instance)
+   {
+     long long cd = shift * dependencyProduct(r, k);
+
+     bool equality = VALUE_TO_INT( domain->p[r][0] ) == 0;
+
+     if (cd == 0 || (cd > 0 && !equality))
+       return NULL;
+
+     unsigned int rows = domain->NbRows + (equality ? 0 : 1);
+     Matrix *constraints = workspace->allocateMatrix(rows, instance ?
+                                      dimensions + 2 :
+                                      dimensions + parameters + 2);
+
+     for (unsigned int i = 0; i < domain->NbRows; i++) {
+       setConstraint(constraints, i, i, 1, 0, instance);
+     }
+
+     // the negated facet, shifted: -c_r(x) - shift c_r . d - 1 >= 0
+     if (!equality) {
+       setConstraint(constraints, domain->NbRows, r, -1, - cd - 1, instance);
+       value_set_si (constraints->p[domain->NbRows][0], 1);
+     }
+
+     return constraints;
+   }
+
+   //
+   // constraints of the points x of the domain whose value of the
+   // dependency d in row k comes from inside the domain: the domain and
+   // its constraints at x + d.  with instance, and the matrix, as in
+   // slabConstraints.
+   //
+   Matrix *linkConstraints(unsigned int k, bool instance)
+   {
+     Matrix *constraints = workspace->allocateMatrix(2 * domain->NbRows,
+                                      instance ?
+                                      dimensions + 2 :
+                                      dimensions + parameters + 2);
+
+     for (unsigned int i = 0; i < domain->NbRows; i++) {
+       setConstraint(constraints, i, i, 1, 0, instance);
+       setConstraint(constraints, domain->NbRows + i, i, 1,
+                     dependencyProduct(i, k), instance);
+     }
+
+     return constraints;
+   }
+
+   // c_r . d for the constraint in row r of the domain and the dependency
+   // in row k
+   long long dependencyProduct(unsigned int r, unsigned int k)
+   {
+     long long cd = 0;
+     for (unsigned int j = 0; j < dimensions; j++) {
+       cd += (long long) VALUE_TO_INT( domain->p[r][1 + j] ) *
+               VALUE_TO_INT( dependencies->p[k][j] );
+     }
+
+     return cd;
+   }
+
+   //
+   // set row i of constraints to sign times the constraint in row source of
+   // the domain, plus offset in the constant.  with instance, the
+   // parameters are folded into the constant.
+   //
+   void setConstraint(Matrix *constraints, unsigned int i,
+                      unsigned int source, int sign, long long offset,
+                      bool instance)
+   {
+     unsigned int constant = dimensions + parameters + 1;
+
+     long long c = VALUE_TO_INT( domain->p[source][constant] );
+     if (instance) {
+       for (unsigned int j = 0; j < parameters; j++) {
+         c += (long long) VALUE_TO_INT( domain->p[source][1 + dimensions + j] ) *
+                (*parameterinstantiations)[j];
+       }
+     }
+
+     value_set_si (constraints->p[i][0], VALUE_TO_INT( domain->p[source][0] ));
+
+     for (unsigned int j = 1; j <= dimensions; j++) {
+       value_set_si (constraints->p[i][j],
+                     sign * VALUE_TO_INT( domain->p[source][j] ));
+     }
+
+     if (!instance) {
+       for (unsigned int j = 0; j < parameters; j++) {
+         value_set_si (constraints->p[i][1 + dimensions + j],
+                       sign * VALUE_TO_INT( domain->p[source][1 + dimensions + j] ));
+       }
+     }
+
+     value_set_si (constraints->p[i][constraints->NbColumns - 1],
+                   sign * c + offset);
+   }
+
+   // inverse change of basis for the parameter instance, from the rows and
+   // columns of the dimensions and the constant of COBI
+   void instanceChangeOfBasis()
+   {
+     for (unsigned int i = 0; i <= dimensions; i++) {
+       unsigned int row = i < dimensions ? i : dimensions + parameters;
+
+       for (unsigned int j = 0; j <= dimensions; j++) {
+         unsigned int column = j < dimensions ? j : dimensions + parameters;
+
+         value_assign (COBIinstance->p[i][j], COBI->p[row][column]);
+       }
+     }
+   }
+
+   //
+   // compact fingerprint of a parametric PE count.  the count is evaluated
+   // at the parameter instance and at a few shifted instances, and the
+   // values are hashed (64-bit FNV-1a).
+   //
+   unsigned long long fingerprintPECount(evalue *pe_count)
+   {
+     unsigned long long hash = 14695981039346656037ULL;
+
+     Value *params = (Value * ) malloc (sizeof (Value) * (parameters + 1));
+     for (unsigned int i = 0; i < parameters; i++) {
+       value_init (params[i]);
+     }
+
+     for (int shift = 0; shift < 4; shift++) {
+       for (unsigned int i = 0; i < parameters; i++) {
+         entier_set_si ( params[i],
+                         (*parameterinstantiations)[i] + shift );
+       }
+
+       long long count = (long long) compute_evalue (pe_count, params);
+
+       for (unsigned int b = 0; b < sizeof (count); b++) {
+         hash ^= (count >> (8 * b)) & 0xff;
+         hash *= 1099511628211ULL;
+       }
+     }
+
+     for (unsigned int i = 0; i < parameters; i++) {
+       value_clear (params[i]);
+     }
+     free (params);
+
+     return hash;
+   }
+
+   int extractScheduleUnknowns(
+                       PipNewparm *newparm,
+                       PipVector  *pv,   // unknown's PIP solution
+                       boost::rational<int> *bigparmcoeff
+                      )
+   {
+     int unknown;
+
+     // constant coefficient
+     if (VALUE_TO_INT( pv->the_deno[1] ) != 1) {
+       throw DSEError("Schedule solution is not integral");
+     } else {
+       unknown = VALUE_TO_INT( pv->the_vector[1] );
+     }
+
+     // rational for the BIG PARAMETER used internally for the maximization ILP
+     bigparmcoeff->assign(
+               VALUE_TO_INT( pv->the_vector[0] ),
+               VALUE_TO_INT( pv->the_deno[0] )
+           );
+
+     // we should not have newparm
+     if (newparm) {
+       throw DSEError("Cannot handle newparm in schedule solution");
+     }
+
+     return unknown;     
+   }
+
+   // extract schedule and array utilization from the QUAST returned by
+   // the ILP solver
+   //
+   // return 0 if solution extracted successfully
+   //       -1 if no solution
+   int extractScheduleSolution(PipQuast *solution, ProjectionSolution *ps)
+   {
+     //
+     // the only parameter of the schedule ILP is the big parameter, so
+     // conditions are decided by letting it grow without bound
+     //
+     map< int, InstanceValue > newparms;
+
+     while (solution->condition) {
+       if (solution->newparm) {
+         throw DSEError("Cannot handle newparm in schedule solution");
+       }
+
+       InstanceValue c = instanceValue(solution->condition, 0, newparms);
+       solution = c.nonNegative() ? solution->next_then : solution->next_else;
+     }
+
+     //
+     // no solution to schedule ILP, try negating projection vector
      //
      if (solution->list == NULL) {
        return -1;
@@ -581,10 +1477,7 @@ private:
      //
      // extract solution
      //
-     if (solution->condition) {
-       cerr << "Cannot handle conditions" << endl;
-       exit(-1);
-     } else {
+     {
        rational<int> rone(1, 1);
        rational<int> rzero(0, 1);
 
@@ -606,8 +1499,7 @@ private:
 
        // ensure that the BIG PARAMETER has been cancelled out
        if (bigparmcoeff != rzero) {
-         cerr << "Big parameter was not eliminated in schedule ILP\n";
-         exit (-1);
+         throw DSEError("Big parameter was not eliminated in schedule ILP");
        }
 
 
@@ -624,8 +1516,7 @@ private:
 
        // ensure that the BIG PARAMETER has been cancelled out
        if (bigparmcoeff != rzero) {
-         cerr << "Big parameter was not eliminated in schedule ILP\n";
-         exit (-1);
+         throw DSEError("Big parameter was not eliminated in schedule ILP");
        }
 
 
@@ -644,12 +1535,11 @@ private:
                                         &bigparmcoeff
                                        );
 
-         entier_set_si (ps->schedule->p[0][i], sched_element);
+         ps->schedule[i] = sched_element;
 
          // ensure that the BIG PARAMETER has been cancelled out
          if (bigparmcoeff - rone != rzero) {
-           cerr << "Big parameter was not eliminated in schedule ILP\n";
-           exit (-1);
+           throw DSEError("Big parameter was not eliminated in schedule ILP");
          }
        }
      }
@@ -658,10 +1548,10 @@ private:
    }
 
    void extractThroughputUnknowns(
-                       PipNewparm *newparm,
+                       const vector< PipNewparm * > &newparms,
                        PipVector  *pv,   // unknown's PIP solution
                        boost::rational<int> *bigparmcoeff,
-                       ublas::vector< boost::rational<int> > *unknown
+                       boost::rational<int> *unknown
                       )
    {
      // rational for the constant coefficient
@@ -669,7 +1559,7 @@ private:
                VALUE_TO_INT( pv->the_vector[pv->nb_elements - 1] ),
                VALUE_TO_INT( pv->the_deno[pv->nb_elements - 1] )
            );
-     (*unknown)(parameters) = r;
+     unknown[parameters] = r;
 
      // rational for the BIG PARAMETER used internally for the maximization ILP
      bigparmcoeff->assign(
@@ -679,7 +1569,7 @@ private:
 
      // set parameter multipliers
      for (unsigned int i = 0; i < parameters; i++) {
-       (*unknown)(i).assign(
+       unknown[i].assign(
                VALUE_TO_INT( pv->the_vector[i] ),
                VALUE_TO_INT( pv->the_deno[i] )
            );
@@ -687,7 +1577,9 @@ private:
 
      // set multipliers of all new parameters
      int multiplier, divider;
-     while (newparm) {
+     for (unsigned int n = 0; n < newparms.size(); n++) {
+       PipNewparm *newparm = newparms[n];
+
        // multiplier co-efficient at rank new parameter
        multiplier = VALUE_TO_INT( pv->the_vector[newparm->rank] );
 
@@ -701,7 +1593,7 @@ private:
                          VALUE_TO_INT( newparm->vector->the_deno[i] )
                             * divider
                         );
-         (*unknown)(i) += r;
+         unknown[i] += r;
        }
 
        // compute constant coefficient
@@ -712,7 +1604,7 @@ private:
                        VALUE_TO_INT( newparm->vector->the_deno[coeffrank] )
                           * divider
                       );
-       (*unknown)(parameters) += r2;
+       unknown[parameters] += r2;
 
        // compute BIG PARAMETER coefficient
        int bigparmrank = newparm->vector->nb_elements - 2;
@@ -723,126 +1615,320 @@ private:
                           * divider
                       );
        *bigparmcoeff += r1;
-
-       // go to next new parameter
-       newparm = newparm->next;
      }
      
    }
 
-   // extract the BPP, x1, x2 (projection solution) from the QUAST
-   // returned by the ILP solver
-   ProjectionSolution *extractThroughputSolution(PipQuast *solution,
-                                                 ublas::vector<int> *pv)
+   //
+   // value of an affine PIP vector at the parameter instance.  the big
+   // parameter B grows without bound, so the value is kept as b B + r.
+   //
+   struct InstanceValue
    {
-     //
-     // no solution?  don't see how this is possible :(
-     //
-     if (solution->list == NULL) {
-       cerr << "Throughput ILP yielded solution with condition, cannot handle" << endl;
-       pip_quast_print(stdout, solution, 0);
-       exit(-1);
+     boost::rational<int> b;
+     boost::rational<int> r;
+
+     // is the value non-negative for a large enough B?
+     bool nonNegative() const
+     {
+       return b > 0 || (b == 0 && r >= 0);
      }
+   };
 
-     // Projection solution
-     // Solution is in terms of parameters and const
-     ProjectionSolution *ps = new ProjectionSolution(dimensions,
-                                                     parameters,
-                                                     parameterinstantiations,
-                                                     parameternames
-                                                     );
+   //
+   // evaluate a PIP vector at the parameter instance.  elements are the
+   // first nparams parameters, the big parameter, new parameters at their
+   // ranks and the constant.  new parameters are the floor of an affine
+   // expression; the floor is exact when they do not involve B.
+   //
+   InstanceValue instanceValue(PipVector *v, unsigned int nparams,
+                               map< int, InstanceValue > &newparms)
+   {
+     InstanceValue value;
+     int last = v->nb_elements - 1;
+
+     for (int i = 0; i <= last; i++) {
+       boost::rational<int> coeff( VALUE_TO_INT( v->the_vector[i] ),
+                                   VALUE_TO_INT( v->the_deno[i] ) );
+
+       if (coeff == 0)
+         continue;
+
+       if (i == last) {
+         value.r += coeff;
+       } else if (i < (int) nparams) {
+         value.r += coeff * (*parameterinstantiations)[i];
+       } else if (i == (int) nparams) {
+         value.b += coeff;
+       } else {
+         if (!newparms.count(i)) {
+           throw DSEError("Undefined new parameter in PIP solution");
+         }
 
-     //
-     // assign projection vector
-     //
-     for (unsigned int i = 0; i < dimensions; i++) {
-       entier_set_si ( ps->projection_vector->p[0][i], (*pv)[i] );
+         value.b += coeff * newparms[i].b;
+         value.r += coeff * newparms[i].r;
+       }
      }
 
-     //
-     // extract solution
-     //
-     if (solution->condition) {
-       cerr << "Cannot handle conditions" << endl;
-       exit(-1);
-     } else {
-       rational<int> rone(1, 1);
-       rational<int> rzero(0, 1);
+     return value;
+   }
 
-       PipList *pl = solution->list;
-       boost::rational<int> bigparmcoeff;
+   //
+   // define the new parameters of a QUAST node at the parameter instance
+   //
+   void defineNewparms(PipNewparm *newparm, unsigned int nparams,
+                       map< int, InstanceValue > &newparms)
+   {
+     for (; newparm; newparm = newparm->next) {
+       InstanceValue v = instanceValue(newparm->vector, nparams, newparms);
+       int deno = VALUE_TO_INT( newparm->deno );
+
+       v.b /= deno;
+       v.r /= deno;
+
+       // floor
+       if (v.b == 0) {
+         int f = v.r.numerator() / v.r.denominator();
+         if (f * v.r.denominator() > v.r.numerator())
+           f--;
+         v.r = f;
+       }
+
+       newparms[newparm->rank] = v;
+     }
+   }
+
+   //
+   // text of an affine PIP vector over the parameters, without the big
+   // parameter.  new parameters are printed as a floor.
+   //
+   string affineText(PipVector *v, unsigned int nparams,
+                     map< int, PipNewparm * > &definitions)
+   {
+     ostringstream str;
+     int last = v->nb_elements - 1;
+     bool first = true;
+
+     for (int i = 0; i <= last; i++) {
+       boost::rational<int> coeff( VALUE_TO_INT( v->the_vector[i] ),
+                                   VALUE_TO_INT( v->the_deno[i] ) );
+
+       if (i == (int) nparams || (coeff == 0 && (i < last || !first)))
+         continue;
 
+       str << (first ? "" : " + ") << coeff;
+
+       if (i < (int) nparams) {
+         str << (*parameternames)[i];
+       } else if (i < last) {
+         PipNewparm *np = definitions[i];
+         str << "floor((" << affineText(np->vector, nparams, definitions)
+             << ")/" << VALUE_TO_INT( np->deno ) << ")";
+       }
+
+       first = false;
+     }
+
+     return str.str();
+   }
+
+   //
+   // walk a throughput QUAST.  conditions involving the big parameter hold
+   // for a large enough B and are not pieces of the BPP.  every leaf gives a
+   // piece; the leaf of the parameter instance is returned in active with
+   // the new parameters in scope.
+   //
+   void walkThroughput(PipQuast *q, ProjectionSolution *ps,
+                       vector< string > &conditions,
+                       vector< PipNewparm * > &newparms,
+                       map< int, InstanceValue > &values,
+                       bool instance,
+                       vector< string > &pieces,
+                       PipQuast *&active,
+                       vector< PipNewparm * > &activenewparms)
+   {
+     unsigned int scope = newparms.size();
+
+     for (PipNewparm *np = q->newparm; np; np = np->next) {
+       newparms.push_back(np);
+     }
+     defineNewparms(q->newparm, parameters, values);
+
+     if (q->condition) {
+       InstanceValue c = instanceValue(q->condition, parameters, values);
+
+       if (c.b != 0) {
+         walkThroughput(c.b > 0 ? q->next_then : q->next_else, ps,
+                        conditions, newparms, values, instance, pieces,
+                        active, activenewparms);
+       } else {
+         map< int, PipNewparm * > definitions;
+         for (unsigned int i = 0; i < newparms.size(); i++) {
+           definitions[newparms[i]->rank] = newparms[i];
+         }
+
+         string text = affineText(q->condition, parameters, definitions);
+
+         conditions.push_back(text + " >= 0");
+         walkThroughput(q->next_then, ps, conditions, newparms, values,
+                        instance && c.r >= 0, pieces, active,
+                        activenewparms);
+         conditions.back() = text + " < 0";
+         walkThroughput(q->next_else, ps, conditions, newparms, values,
+                        instance && c.r < 0, pieces, active,
+                        activenewparms);
+         conditions.pop_back();
+       }
+     } else {
        //
-       // find solution for k_max from k'
+       // leaf: BPP of this piece from k'
        //
-       extractThroughputUnknowns(
-                      solution->newparm,
-                      pl->vector,
-                      &bigparmcoeff,
-                      ps->bpp
-                     );
+       string region;
+       for (unsigned int i = 0; i < conditions.size(); i++) {
+         region += (i ? " and " : "") + conditions[i];
+       }
+       if (!region.empty())
+         region += ": ";
+
+       if (q->list == NULL) {
+         pieces.push_back(region + "none");
+       } else {
+         vector< boost::rational<int> > bpp(parameters + 1);
+         boost::rational<int> bigparmcoeff;
+
+         extractThroughputUnknowns(newparms, q->list->vector,
+                                   &bigparmcoeff, &bpp[0]);
+
+         if (bigparmcoeff != 1) {
+           pieces.push_back(region + "unbounded");
+         } else {
+           for (unsigned int i = 0; i <= parameters; i++) {
+             bpp[i] = -bpp[i];
+           }
+           pieces.push_back(region + ps->affineString(&bpp[0]));
+         }
+       }
 
-       // negate coefficients
-       for (unsigned int i = 0; i <= parameters; i++) {
-         (*ps->bpp)(i) = -(*ps->bpp)(i);
+       if (instance) {
+         active = q;
+         activenewparms = newparms;
        }
+     }
 
-       // ensure that the BIG PARAMETER has been cancelled out
-       if (rone - bigparmcoeff != rzero) {
-         cerr << "Big parameter was not eliminated in throughput ILP\n";
-         exit (-1);
+     newparms.resize(scope);
+   }
+
+   // extract the BPP, x1, x2 (projection solution) along direction dir
+   // from the QUAST returned by the ILP solver.
+   //
+   // a QUAST with conditions on the parameters gives a piecewise BPP.  the
+   // solution keeps the piece of the parameter instance, which is used to
+   // rank it, and the text of all pieces for printing.
+   void extractThroughputSolution(PipQuast *solution, ProjectionSolution *ps,
+                                  unsigned int dir)
+   {
+     vector< string > conditions, pieces;
+     vector< PipNewparm * > newparms, activenewparms;
+     map< int, InstanceValue > values;
+     PipQuast *active = NULL;
+
+     walkThroughput(solution, ps, conditions, newparms, values, true,
+                    pieces, active, activenewparms);
+
+     //
+     // no solution?  don't see how this is possible :(
+     //
+     if (active == NULL || active->list == NULL) {
+       throw DSEError("Throughput ILP has no solution for the parameter instance");
+     }
+
+     // a single piece is printed as an affine BPP
+     ps->pieces[dir] = "";
+     if (pieces.size() > 1) {
+       for (unsigned int i = 0; i < pieces.size(); i++) {
+         ps->pieces[dir] += (i ? "; " : "") + pieces[i];
        }
+     }
 
+     {
        //
-       // find solution for x1
+       // extract solution
        //
-       for (unsigned int i = 0; i < dimensions; i++) {
-         // advance to next unknown solution in list
-         pl = pl->next;
+       {
+         rational<int> rone(1, 1);
+         rational<int> rzero(0, 1);
 
-         // extract X1[i]
-         bigparmcoeff.assign(0, 1);
+         PipList *pl = active->list;
+         boost::rational<int> bigparmcoeff;
+
+         //
+         // find solution for k_max from k'
+         //
+         boost::rational<int> *bpp = ps->bppCoefficients(dir);
          extractThroughputUnknowns(
-                        solution->newparm,
+                        activenewparms,
                         pl->vector,
                         &bigparmcoeff,
-                        ps->x1[i]
+                        bpp
                        );
 
-         // ensure that the BIG PARAMETER coefficient is zero
-         if (bigparmcoeff != rzero) {
-           cerr << "Big parameter was not eliminated in throughput ILP\n";
-           exit (-1);
+         // negate coefficients
+         for (unsigned int i = 0; i <= parameters; i++) {
+           bpp[i] = -bpp[i];
          }
-       }
 
+         // ensure that the BIG PARAMETER has been cancelled out
+         if (rone - bigparmcoeff != rzero) {
+           throw DSEError("Big parameter was not eliminated in throughput ILP");
+         }
 
-       //
-       // find solution for x2
-       //
-       for (unsigned int i = 0; i < dimensions; i++) {
-         // advance to next unknown solution in list
-         pl = pl->next;
+         //
+         // find solution for x1
+         //
+         for (unsigned int i = 0; i < dimensions; i++) {
+           // advance to next unknown solution in list
+           pl = pl->next;
+
+           // extract X1[i]
+           bigparmcoeff.assign(0, 1);
+           extractThroughputUnknowns(
+                          activenewparms,
+                          pl->vector,
+                          &bigparmcoeff,
+                          ps->x1Coefficients(i, dir)
+                         );
+
+           // ensure that the BIG PARAMETER coefficient is zero
+           if (bigparmcoeff != rzero) {
+             throw DSEError("Big parameter was not eliminated in throughput ILP");
+           }
+         }
 
-         // extract X1[i]
-         bigparmcoeff.assign(0, 1);
-         extractThroughputUnknowns(
-                        solution->newparm,
-                        pl->vector,
-                        &bigparmcoeff,
-                        ps->x2[i]
-                       );
 
-         // ensure that the BIG PARAMETER coefficient is zero
-         if (bigparmcoeff != rzero) {
-           cerr << "Big parameter was not eliminated in throughput ILP\n";
-           exit (-1);
+         //
+         // find solution for x2
+         //
+         for (unsigned int i = 0; i < dimensions; i++) {
+           // advance to next unknown solution in list
+           pl = pl->next;
+
+           // extract X1[i]
+           bigparmcoeff.assign(0, 1);
+           extractThroughputUnknowns(
+                          activenewparms,
+                          pl->vector,
+                          &bigparmcoeff,
+                          ps->x2Coefficients(i, dir)
+                         );
+
+           // ensure that the BIG PARAMETER coefficient is zero
+           if (bigparmcoeff != rzero) {
+             throw DSEError("Big parameter was not eliminated in throughput ILP");
+           }
          }
-       }
 
+       }
      }
-     
-     return ps;
    }
    
   // number of dimensions and parameters in the input polyhedron
@@ -854,14 +1940,46 @@ private:
   // # of pipeline stages.  Min. delay on each dependency link
   unsigned int pepipelinestages;
 
+  // number of projection directions
+  unsigned int rank;
+
+  // drop parametric PE counts once the instance count is known
+  bool lazypecount;
+
+  // solve at the parameter instance only
+  bool screening;
+
+  // count I/O ports and peaks
+  bool iometrics;
+
+  // count delay registers
+  bool storagecount;
+
+  // schedules kept per projection, and their largest utilization
+  unsigned int schedulevariants;
+  unsigned int maxutilization;
+
+  // objective of the allocation optimizer
+  AllocationOptimizer::Objective allocationobjective;
+
   // store polyhedron constraints
   PipMatrix *domain, *context;
   
   // store input dependencies
   PipMatrix *dependencies;
 
-  // store polyhedron vertices
-  PipMatrix *vertices;
+  // input dependencies as ints, row major
+  vector< int > dependencyvalues;
+
+  // polyhedron vertices, affine in the parameters
+  ParametricVertices *vertices;
+
+  // storage for the fixed layout of all projection solutions found by this
+  // solver
+  SolutionArena arena;
+
+  // temporary store for the projection vector, used to compute allocations
+  Matrix *PV;
 
   // temporary store for change of basis matrix and its inverse
   // used for counting number of points (processing elements) in a projected
@@ -872,6 +1990,22 @@ private:
   // for computing number of PEs using the barvinok library
   Value *parameter_inst_pecount;
 
+  // PIP options, pool of ILP matrices and session
+  PipWorkspace *workspace;
+
+  // domain of the parameter instance, as a PIP matrix with the parameter
+  // columns zeroed and as a polyhedron of the dimensions, and the inverse
+  // change of basis of the instance, for screening
+  PipMatrix *instancedomain;
+  Polyhedron *instancepolyhedron;
+  Matrix *COBIinstance;
+
+  // vertices of the domain at the parameter instance, once computed
+  vector< vector< double > > instancepoints;
+
+  // network kernels of the dimension
+  DimensionKernels kernels;
+
 };
 
 #endif // __PROJECTION_SOLVER_H__
@@ -7,7 +7,24 @@
 //
 //  Create ILP to find schedule for a given projection vector.
 //  The schedule is constrained to respect dependencies.
-//  Objective function: minimize array utilization (\lambda u) and latency
+//  Objective function: minimize array utilization (\lambda u), then latency.
+//  PIP minimizes the unknowns lexicographically in column order, so with
+//  q = t the utilization t is minimized first and the latency s second,
+//  whatever their magnitudes.
+//
+//  A bound on the latency (an epsilon constraint s <= bound) finds the
+//  schedule of least utilization among those with a lower latency than a
+//  given schedule: the next point of the utilization/latency Pareto set.
+//
+//  For a projection of rank k the points of a PE differ by c_1 u_1 + ... +
+//  c_k u_k with |c_j| <= e_j, the extent along u_j.  The schedule keeps them
+//  apart with mixed radix strides:  \lambda u_j >= 1 + sum_{i<j} e_i \lambda u_i.
+//  The strides must be linear in \lambda, so the extents of the parameter
+//  instance are used; the schedule is valid for problem sizes up to the
+//  instance.  Utilization is the innermost stride \lambda u_1.
+//
+//  Vertices may be rational: an extra last column holds the denominator
+//  common to all vertices, and the vertex constraints are scaled by it.
 //
 //  Input is the projection vector (projection solution object), dependencies
 //  and vertices in PIP matrix format
@@ -17,20 +34,31 @@
 #   define __SCHEDULE_ILP_H__
 
 #include <cstdio>
+#include <vector>
+using namespace std;
 
 // pip includes
 #include <piplib/piplibMP.h>
 
+// local includes
+#include "pip-workspace.hpp"
+
 class ScheduleILP
 {
 
  public:
 
    // constructor
+   //   workspace    - pool the matrices are taken from, or NULL to allocate
+   //   latencybound - upper bound on the latency, or -1 for none
    ScheduleILP(unsigned int dimensions, unsigned int parameters,
                PipMatrix *dependencies, PipMatrix *vertices,
                unsigned int pepipelinestages,
-               ProjectionSolution *ps)
+               ProjectionSolution *ps,
+               PipWorkspace *_workspace = NULL,
+               int _latencybound = -1) :
+     workspace (_workspace),
+     latencybound (_latencybound)
    {
 //     pip_matrix_print(stdout, dependencies);
 //     pip_matrix_print(stdout, vertices);
@@ -47,8 +75,7 @@ class ScheduleILP
    // destructor
    ~ScheduleILP()
    {
-     pip_matrix_free(scheduleilp);
-     pip_matrix_free(contextilp);
+     releaseMatrices();
    }
    
    // regenerate ilp.  called after negating projection vector
@@ -57,6 +84,8 @@ class ScheduleILP
                  unsigned int pepipelinestages,
                  ProjectionSolution *ps)
    {
+     releaseMatrices();
+
      GenScheduleILP(dimensions, parameters, dependencies, vertices,
                     pepipelinestages, ps);
    }
@@ -84,6 +113,30 @@ private:
    PipMatrix *scheduleilp, *contextilp;
    int bigParamPos;
 
+   PipWorkspace *workspace;
+
+   // upper bound on the latency, or -1
+   int latencybound;
+
+   // zero matrix, from the workspace if there is one
+   PipMatrix *allocate(unsigned int rows, unsigned int columns)
+   {
+     return workspace ? workspace->allocate(rows, columns)
+                      : pip_matrix_alloc(rows, columns);
+   }
+
+   // free the matrices, or return them to the workspace
+   void releaseMatrices()
+   {
+     if (workspace) {
+       workspace->release(scheduleilp);
+       workspace->release(contextilp);
+     } else {
+       pip_matrix_free(scheduleilp);
+       pip_matrix_free(contextilp);
+     }
+   }
+
    void GenScheduleILP(unsigned int dimensions, unsigned int parameters,
                        PipMatrix *dependencies, PipMatrix *vertices,
                        unsigned int pepipelinestages,
@@ -91,6 +144,10 @@ private:
    {
      int no_dependencies = dependencies->NbRows;
      int no_vertices     = vertices->NbRows;
+     unsigned int rank   = ps->rank;
+
+     // first row of dependency constraints, after the mixed radix strides
+     int base = 3 + rank - 1;
 
      // temporary (big num) for manipulation
      Entier tmp, tmp2;
@@ -100,15 +157,20 @@ private:
 
      // allocate memory for schedule ilp constraints
      //  Number of constraints = #dependencies + 
-     //                          (#vertices * #vertices - #vertices) + 3
+     //                          (#vertices * #vertices - #vertices) + 3 +
+     //                          (rank - 1)
      //
-     //  ld <= -1 ; t >= lu ; lu >= 1 ; lv_d <= s ; q >= 2t + s
+     //  ld <= -1 ; t >= lu ; lu >= 1 ; lv_d <= s ; q >= t ;
+     //  lu_j >= 1 + sum e_i lu_i ; s <= bound (with a latency bound)
      //
      //  Number of columns = 1 + dimensions + 5 (q, t, s, const, B)
      //    We are using big parameter B so that l can be negative
-     scheduleilp = pip_matrix_alloc(
+     int bounds = latencybound >= 0 ? 1 : 0;
+
+     scheduleilp = allocate(
                        no_dependencies + 
-                       (no_vertices * no_vertices - no_vertices) + 3,
+                       (no_vertices * no_vertices - no_vertices) + 3 +
+                       rank - 1 + bounds,
                        1 + dimensions + 5
                      );
 
@@ -128,9 +190,8 @@ private:
      // l1 ... ln
      int pv_sum = 0;
      for (unsigned int i = 0; i < dimensions; i++) {
-       entier_oppose (tmp, ps->projection_vector->p[0][i]);
-       entier_assign (scheduleilp->p[0][4+i], tmp);
-       pv_sum += VALUE_TO_INT( ps->projection_vector->p[0][i] );
+       entier_set_si (scheduleilp->p[0][4+i], -ps->projection_vector[i]);
+       pv_sum += ps->projection_vector[i];
      }
 
      entier_set_si (scheduleilp->p[0][4+dimensions], pv_sum);  // u1 + ... + un
@@ -148,7 +209,7 @@ private:
 
      // l1 ... ln
      for (unsigned int i = 0; i < dimensions; i++) {
-       entier_assign (scheduleilp->p[1][4+i], ps->projection_vector->p[0][i]);
+       entier_set_si (scheduleilp->p[1][4+i], ps->projection_vector[i]);
      }
 
      entier_set_si (scheduleilp->p[1][4+dimensions], -pv_sum);  // u1 + ... + un
@@ -156,16 +217,16 @@ private:
 
      //
      // Objective function
-     // constraint: q >= 2048t + s   q - 2048t - s >= 0
+     // constraint: q >= t   q - t >= 0
      //
-     // This is the final objective function to minimize.
-     //  t - array utilization.  modify weight as needed
-     //  s - latency
+     // The unknowns q, t, s are minimized lexicographically:
+     //  t - array utilization
+     //  s - latency, among the schedules of least utilization
      //
      entier_set_si (scheduleilp->p[2][0], 1);     // inequality
      entier_set_si (scheduleilp->p[2][1], 1);     // q
-     entier_set_si (scheduleilp->p[2][2], -2048); // t
-     entier_set_si (scheduleilp->p[2][3], -1);    // s
+     entier_set_si (scheduleilp->p[2][2], -1);    // t
+     entier_set_si (scheduleilp->p[2][3], 0);     // s
 
      // l1 ... ln
      for (unsigned int i = 0; i < dimensions; i++) {
@@ -175,28 +236,62 @@ private:
      entier_set_si (scheduleilp->p[2][4+dimensions], 0);    // u1 + ... + un
      entier_set_si (scheduleilp->p[2][4+dimensions+1], 0);  // const
 
+     //
+     // Mixed radix strides for directions 2 ... k
+     // constraint: lu_j >= 1 + sum_{i<j} e_i lu_i    la - 1 >= 0
+     //             la - 1 - aG >= 0    where a = u_j - sum_{i<j} e_i u_i
+     //
+     vector< int > extents(rank);
+     for (unsigned int j = 0; j < rank; j++) {
+       extents[j] = ps->instanceExtent(j);
+     }
+
+     for (unsigned int j = 1; j < rank; j++) {
+       int row = 2 + j;
+
+       entier_set_si (scheduleilp->p[row][0], 1);  // inequality
+       entier_set_si (scheduleilp->p[row][1], 0);  // q
+       entier_set_si (scheduleilp->p[row][2], 0);  // t
+       entier_set_si (scheduleilp->p[row][3], 0);  // s
+
+       // l1 ... ln
+       int a_sum = 0;
+       for (unsigned int i = 0; i < dimensions; i++) {
+         int a = ps->projectionElement(j, i);
+         for (unsigned int l = 0; l < j; l++) {
+           a -= extents[l] * ps->projectionElement(l, i);
+         }
+
+         entier_set_si (scheduleilp->p[row][4+i], a);
+         a_sum += a;
+       }
+
+       entier_set_si (scheduleilp->p[row][4+dimensions], -a_sum);  // a1 + ... + an
+       entier_set_si (scheduleilp->p[row][4+dimensions+1], -1);    // const
+     }
+
      //
      // Constraints for all dependencies
      //
      // constraint: ld <= -1    -ld -1 >= 0    -ld -1 + dB >= 0
      //
      for (int i = 0; i < no_dependencies; i++) {
-       entier_set_si (scheduleilp->p[3+i][0], 1);   // inequality
-       entier_set_si (scheduleilp->p[3+i][1], 0);   // q
-       entier_set_si (scheduleilp->p[3+i][2], 0);   // t
-       entier_set_si (scheduleilp->p[3+i][3], 0);   // s
+       entier_set_si (scheduleilp->p[base+i][0], 1);   // inequality
+       entier_set_si (scheduleilp->p[base+i][1], 0);   // q
+       entier_set_si (scheduleilp->p[base+i][2], 0);   // t
+       entier_set_si (scheduleilp->p[base+i][3], 0);   // s
 
        // l1 ... ln
        int dep_sum = 0;
        for (unsigned int j = 0; j < dimensions; j++) {
          entier_oppose (tmp, dependencies->p[i][j]);
-         entier_assign (scheduleilp->p[3+i][4+j], tmp);
+         entier_assign (scheduleilp->p[base+i][4+j], tmp);
          dep_sum += VALUE_TO_INT( dependencies->p[i][j] );
        }
 
         // d1 + ... + dn
-       entier_set_si (scheduleilp->p[3+i][4+dimensions], dep_sum);
-       entier_set_si (scheduleilp->p[3+i][4+dimensions+1], - (int) pepipelinestages);    // const
+       entier_set_si (scheduleilp->p[base+i][4+dimensions], dep_sum);
+       entier_set_si (scheduleilp->p[base+i][4+dimensions+1], - (int) pepipelinestages);    // const
      }
 
      //
@@ -205,7 +300,13 @@ private:
      // constraint: lV_d <= s   s - lV_d >= 0    s - lV_d +_ V_dB >= 0
      //             where V_d \in { V - V' | V, V' are vertices }
      //
-     int cpos = 3 + no_dependencies;
+     // rational vertices V = W / D: Ds - lW_d >= 0
+     //
+     int denominator = 1;
+     if (vertices->NbColumns > dimensions)
+       denominator = VALUE_TO_INT( vertices->p[0][dimensions] );
+
+     int cpos = base + no_dependencies;
      for (int i = 0; i < no_vertices; i++) {
        for (int j = 0; j < no_vertices; j++) {
          // for each pair of vertices
@@ -215,7 +316,7 @@ private:
          entier_set_si (scheduleilp->p[cpos][0], 1);   // inequality
          entier_set_si (scheduleilp->p[cpos][1], 0);   // q
          entier_set_si (scheduleilp->p[cpos][2], 0);   // t
-         entier_set_si (scheduleilp->p[cpos][3], 1);   // s
+         entier_set_si (scheduleilp->p[cpos][3], denominator);   // s
 
          // l1 ... ln
          int vert_sum = 0;
@@ -236,6 +337,25 @@ private:
        }
      }
 
+     //
+     // Latency bound
+     // constraint: s <= bound   bound - s >= 0
+     //
+     if (bounds) {
+       entier_set_si (scheduleilp->p[cpos][0], 1);   // inequality
+       entier_set_si (scheduleilp->p[cpos][1], 0);   // q
+       entier_set_si (scheduleilp->p[cpos][2], 0);   // t
+       entier_set_si (scheduleilp->p[cpos][3], -1);  // s
+
+       // l1 ... ln
+       for (unsigned int k = 0; k < dimensions; k++) {
+         entier_set_si (scheduleilp->p[cpos][4+k], 0);
+       }
+
+       entier_set_si (scheduleilp->p[cpos][4+dimensions], 0);  // d1 + ... + dn
+       entier_set_si (scheduleilp->p[cpos][4+dimensions+1], latencybound);
+     }
+
      // column position of big parameter in constraint row
      // first column (equality/inequality?) starts at index 0
      bigParamPos = dimensions + 4;
@@ -244,7 +364,7 @@ private:
      //
      // context: B >= 0
      //
-     contextilp = pip_matrix_alloc(
+     contextilp = allocate(
                        1,
                        3
                      );
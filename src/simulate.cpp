@@ -0,0 +1,222 @@
+//  simulate.cpp
+//
+//  Simulate the systolic array of one projection for an instance of the
+//  parameters, and compare the measured block pipelining period, PE count,
+//  latency and utilization with the analytical values, e.g.
+//
+//    -i input-polyhedrons/bmm/bmm.opt -s 1 --projection "1 1 0"
+//      --instance N=1000
+//
+//  The solution (schedule and allocation) is found by the solver as in
+//  enumerate; --schedule replaces the schedule, in which case the
+//  analytical utilization and latency are those of the solver's schedule.
+//  Parameters not given with --instance keep the instantiations of the
+//  configuration file.
+//
+//  Exits with status 1 if the simulation finds conflicts or dependencies
+//  that arrive before the pipeline stages complete.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+#include <boost/tokenizer.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "dse-error.hpp"
+#include "polyhedron-options.hpp"
+#include "projection-solver.hpp"
+#include "domain-scanner.hpp"
+#include "array-simulator.hpp"
+
+//
+// split a string of integers separated by whitespace
+//
+static vector< int > integers(const string &str)
+{
+  vector< int > v;
+
+  char_separator<char> sep(" \t,");
+  tokenizer< char_separator<char> > tokens(str, sep);
+
+  for (tokenizer< char_separator<char> >::iterator beg=tokens.begin();
+       beg!=tokens.end(); ++beg) {
+    v.push_back( atoi(beg->c_str()) );
+  }
+
+  return v;
+}
+
+int main(int argc, char **argv)
+{
+  string polyhedron;
+  int pepipelinestages = 1;
+  int rank = 1;
+  vector< int > projection;
+  vector< int > schedule;
+  vector< string > instances;
+
+  //
+  // parse command line options
+  //
+  try {
+    // group of config options
+    po::options_description commandline("Simulator Options");
+    // variable map
+    po::variables_map vm;
+
+    commandline.add_options()
+      ("help,?", "This help screen")
+      ("polyhedron,i", po::value<string>(), "Polyhedron configuration file")
+      ("pe-pipeline-stages,s", po::value<int>(), "Number of processor pipeline stages (default 1)")
+      ("rank,r", po::value<int>(), "Number of projection directions (default 1)")
+      ("projection", po::value<string>(), "Projection vector, or the rows of the projection matrix")
+      ("schedule", po::value<string>(), "Schedule to simulate instead of the one found by the solver")
+      ("instance", po::value< vector<string> >(), "Value of a parameter, as NAME=VALUE")
+      ;
+
+    // read command line
+    store(po::parse_command_line(argc, argv, commandline), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+      cout << commandline << "\n";
+      exit(-1);
+    }
+
+    if (vm.count("polyhedron")) {
+      polyhedron = vm["polyhedron"].as<string>();
+    } else {
+      throw "Must specify polyhedron configuration file";
+    }
+
+    if (vm.count("pe-pipeline-stages")) {
+      pepipelinestages = vm["pe-pipeline-stages"].as<int>();
+    }
+
+    if (vm.count("rank")) {
+      rank = vm["rank"].as<int>();
+    }
+
+    if (vm.count("projection")) {
+      projection = integers(vm["projection"].as<string>());
+    } else {
+      throw "Must specify projection vector";
+    }
+
+    if (vm.count("schedule")) {
+      schedule = integers(vm["schedule"].as<string>());
+    }
+
+    if (vm.count("instance")) {
+      instances = vm["instance"].as< vector<string> >();
+    }
+  }
+  catch(std::exception &err)
+  {
+    cerr << "Error parsing options: " << err.what() << endl;
+    exit (-1);
+  }
+  catch(const char *err)
+  {
+    cerr << "Error parsing options: " << err << endl;
+    exit (-1);
+  }
+
+  bool failed = false;
+
+  try {
+    PolyhedronOptions polyopt(polyhedron);
+
+    //
+    // parameter instance
+    //
+    for (unsigned int i = 0; i < instances.size(); i++) {
+      string::size_type eq = instances[i].find('=');
+      unsigned int p = 0;
+
+      while (eq != string::npos && p < polyopt.parameters &&
+               polyopt.parameternames[p] != instances[i].substr(0, eq)) {
+        p++;
+      }
+
+      if (eq == string::npos || p == polyopt.parameters) {
+        throw DSEError("Unknown parameter instance " + instances[i]);
+      }
+
+      polyopt.parameterinstantiations[p] =
+        atoi(instances[i].substr(eq + 1).c_str());
+    }
+
+    if (projection.size() != rank * polyopt.dimensions) {
+      throw DSEError("Projection must have rank x dimensions elements");
+    }
+
+    if (!schedule.empty() && schedule.size() != polyopt.dimensions) {
+      throw DSEError("Schedule must have one element per dimension");
+    }
+
+    ProjectionSolver solver(polyopt.dimensions,
+                            polyopt.parameters,
+                            &polyopt.parameterinstantiations,
+                            &polyopt.parameternames,
+                            pepipelinestages,
+                            polyopt.pipconstraints,
+                            polyopt.dependencies,
+                            rank);
+
+    ublas::vector<int> pv(projection.size());
+    for (unsigned int i = 0; i < projection.size(); i++) {
+      pv(i) = projection[i];
+    }
+
+    ProjectionSolution *ps = solver.evaluate(&pv);
+
+    if (!schedule.empty()) {
+      for (unsigned int i = 0; i < polyopt.dimensions; i++) {
+        ps->schedule[i] = schedule[i];
+      }
+      solver.computeScheduleNetwork(ps);
+    }
+
+    ps->print(cout);
+    cout << endl;
+
+    //
+    // simulate the array for the parameter instance
+    //
+    try {
+      DomainScanner scanner(solver.getDomain(), polyopt.dimensions,
+                            polyopt.parameters,
+                            polyopt.parameterinstantiations);
+
+      ArraySimulator simulator(scanner, solver.getDependencies(), ps,
+                               polyopt.dimensions, pepipelinestages);
+
+      simulator.run();
+      simulator.report(cout);
+
+      failed = simulator.conflictCount() > 0 || simulator.violations() > 0;
+    }
+    catch (...) {
+      delete ps;
+      throw;
+    }
+
+    delete ps;
+  }
+  catch (DSEError &err) {
+    cerr << err.what() << endl;
+    exit (-1);
+  }
+
+  return failed ? 1 : 0;
+}
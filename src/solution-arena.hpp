@@ -0,0 +1,172 @@
+//  solution-arena.hpp
+//
+//  Bump allocator used to store projection solutions.  Storage is carved out
+//  of large blocks and is released all at once when the arena is reset or
+//  destroyed, so individual solutions never go through the heap allocator.
+//
+//  Solutions of a solver come in a few sizes.  Storage returned by a
+//  deleted solution goes on a free list for its size and is handed to the
+//  next allocation of that size, so the arena holds as much as the live
+//  solutions (a Pareto frontier, the solutions within bounds) need, not
+//  every solution since the last reset.
+
+#ifndef __SOLUTION_ARENA_H__
+#   define __SOLUTION_ARENA_H__
+
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <vector>
+using namespace std;
+
+class SolutionArena
+{
+
+ public:
+
+   // constructor
+   SolutionArena(size_t _blocksize = 64 * 1024) :
+     blocksize (_blocksize),
+     current (NULL),
+     remaining (0),
+     allocated (0)
+   {
+   }
+
+   // destructor
+   ~SolutionArena()
+   {
+     release();
+   }
+
+   // allocate a chunk of memory from the arena.  memory is suitably aligned
+   // for any type and is not initialized.
+   void *allocate(size_t bytes)
+   {
+     bytes = rounded(bytes);
+
+     // reuse returned storage of the same size
+     map< size_t, void * >::iterator f = freelists.find(bytes);
+     if (f != freelists.end() && f->second) {
+       void *p = f->second;
+       f->second = *(void **) p;
+       allocated += bytes;
+
+       return p;
+     }
+
+     // start a new block when the current one is exhausted.  large requests
+     // get a block of their own
+     if (bytes > remaining) {
+       size_t size = bytes > blocksize ? bytes : blocksize;
+
+       char *block = (char *) malloc (size);
+       if (!block)
+         throw bad_alloc();
+
+       blocks.push_back(block);
+       current   = block;
+       remaining = size;
+     }
+
+     void *p = current;
+     current   += bytes;
+     remaining -= bytes;
+     allocated += bytes;
+
+     return p;
+   }
+
+   // allocate and value-initialize an array of n objects of type T.
+   // objects must be trivially destructible since the arena never runs
+   // destructors.
+   template <class T>
+   T *allocate(size_t n)
+   {
+     T *p = (T *) allocate(n * sizeof (T));
+
+     for (size_t i = 0; i < n; i++) {
+       new (p + i) T();
+     }
+
+     return p;
+   }
+
+   // return a chunk of the given size to the arena.  the chunk must have
+   // been allocated since the last reset
+   void deallocate(void *p, size_t bytes)
+   {
+     bytes = rounded(bytes);
+
+     if (!p || bytes == 0)
+       return;
+
+     // the free list is threaded through the returned chunks
+     *(void **) p = freelists[bytes];
+     freelists[bytes] = p;
+     allocated -= bytes;
+   }
+
+   // return an array of n objects of type T allocated by allocate<T>()
+   template <class T>
+   void deallocate(T *p, size_t n)
+   {
+     deallocate((void *) p, n * sizeof (T));
+   }
+
+   // release all memory held by the arena.  every pointer handed out by the
+   // arena is invalid after this call.
+   void reset()
+   {
+     release();
+   }
+
+   // number of bytes handed out and not returned since the last reset
+   size_t bytesAllocated()
+   {
+     return allocated;
+   }
+
+private:
+
+   // size of a request rounded up to 16 bytes, enough alignment for any of
+   // the types we store and room for a free list link
+   static size_t rounded(size_t bytes)
+   {
+     const size_t align = 16;
+
+     return (bytes + align - 1) & ~(align - 1);
+   }
+
+   void release()
+   {
+     for (unsigned int i = 0; i < blocks.size(); i++) {
+       free (blocks[i]);
+     }
+     blocks.clear();
+     freelists.clear();
+
+     current   = NULL;
+     remaining = 0;
+     allocated = 0;
+   }
+
+   // size of each block requested from the heap
+   size_t blocksize;
+
+   // blocks owned by the arena and the position within the current block
+   vector< char * > blocks;
+   char  *current;
+   size_t remaining;
+   size_t allocated;
+
+   // returned chunks by size, each holding the next chunk of its size
+   map< size_t, void * > freelists;
+
+   // the arena owns raw memory, do not copy
+   SolutionArena(const SolutionArena &);
+   SolutionArena &operator=(const SolutionArena &);
+
+};
+
+#endif // __SOLUTION_ARENA_H__
@@ -0,0 +1,217 @@
+//  solution-stream.hpp
+//
+//  Stream projection solutions as they are found.  Each finished candidate
+//  is appended to a record file (CSV or JSON lines) as soon as it is
+//  complete, and a snapshot file with the current best solutions is
+//  rewritten periodically.
+
+#ifndef __SOLUTION_STREAM_H__
+#   define __SOLUTION_STREAM_H__
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+using namespace std;
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+#include "solutions.hpp"
+
+class SolutionStream
+{
+
+ public:
+
+   // constructor
+   //   recordfile       - file receiving one record per finished candidate
+   //                      (empty to disable)
+   //   json             - write JSON lines instead of CSV
+   //   snapshotfile     - file rewritten with the current best solutions
+   //                      (empty to disable)
+   //   snapshotinterval - seconds between snapshots
+   //   snapshottop      - number of solutions in a snapshot
+   //   peinefficiency   - processor inefficiency bound applied to snapshots
+   //   append           - append to an existing record file (resumed runs)
+   //   log              - stream receiving progress messages
+   //   io               - solutions have I/O counts
+   //   storage          - solutions have storage counts
+   //   partitioned      - solutions are partitioned onto a device
+   SolutionStream(string _recordfile, bool _json,
+                  string _snapshotfile, int _snapshotinterval,
+                  int _snapshottop, int _peinefficiency,
+                  bool append = false, ostream &_log = cout,
+                  bool _io = false, bool _storage = false,
+                  bool _partitioned = false) :
+     log (&_log),
+     json (_json),
+     io (_io),
+     storage (_storage),
+     partitioned (_partitioned),
+     snapshotfile (_snapshotfile),
+     snapshotinterval (_snapshotinterval),
+     snapshottop (_snapshottop),
+     peinefficiency (_peinefficiency),
+     records (0),
+     start (time(NULL)),
+     lastsnapshot (time(NULL))
+   {
+     if (!_recordfile.empty()) {
+       recordstream.open(_recordfile.c_str(),
+                         ios::out | (append ? ios::app : ios::trunc));
+
+       if (!recordstream) {
+         throw DSEError("Failed to open " + _recordfile);
+       }
+
+       if (!json && !append)
+         printHeader(recordstream);
+     }
+   }
+
+   // destructor
+   ~SolutionStream()
+   {
+   }
+
+   // emit the record of a finished candidate
+   void emit(ProjectionSolution *ps)
+   {
+     if (records == 0) {
+       *log << "First result after " << time(NULL) - start << " seconds"
+            << endl;
+     }
+     records++;
+
+     if (recordstream.is_open()) {
+       printRecord(recordstream, ps);
+       recordstream.flush();
+     }
+   }
+
+   // rewrite the snapshot file if the snapshot interval has elapsed
+   void update(Solutions &projsols)
+   {
+     if (snapshotfile.empty())
+       return;
+
+     if (time(NULL) - lastsnapshot < snapshotinterval)
+       return;
+
+     snapshot(projsols);
+   }
+
+   // rewrite the snapshot file with the current best solutions
+   void snapshot(Solutions &projsols)
+   {
+     if (snapshotfile.empty())
+       return;
+
+     lastsnapshot = time(NULL);
+
+     // rank a copy, the caller's list is left in insertion order
+     Solutions ranked;
+     ranked.assign(projsols.begin(), projsols.end());
+     ranked.Sort();
+
+     list<ProjectionSolution *> selected =
+                      ranked.topSolutions(peinefficiency, snapshottop);
+
+     // ranked does not own its solutions
+     ranked.clear();
+
+     // write to a temporary file and rename it, so readers never see a
+     // partially written snapshot
+     string tmpfile = snapshotfile + ".tmp";
+     ofstream out(tmpfile.c_str(), ios::out | ios::trunc);
+
+     if (!out) {
+       cerr << "Failed to open " << tmpfile << endl;
+       return;
+     }
+
+     if (!json)
+       printHeader(out);
+
+     list<ProjectionSolution *>::iterator i;
+     for (i = selected.begin(); i != selected.end(); i++) {
+       printRecord(out, *i);
+     }
+     out.close();
+
+     if (rename (tmpfile.c_str(), snapshotfile.c_str()) != 0) {
+       cerr << "Failed to write snapshot " << snapshotfile << endl;
+     }
+   }
+
+private:
+
+   // column names, in the order printed by ProjectionSolution::print(),
+   // followed by the candidate status
+   void printHeader(ostream &os)
+   {
+     os << "projection_vector,bpp,pe_count,instance_pe_count,schedule,"
+        << "utilization,network_sum_delays,network_avg_delay,"
+        << "network_max_delay,latency,latency_function,allocation,"
+        << "network_avg_length,network_max_length,";
+     if (io)
+       os << "io_port_count,instance_io_port_count,io_per_cycle,";
+     if (storage)
+       os << "storage_count,instance_storage,";
+     if (partitioned)
+       os << "partition,partition_copies,partition_period,"
+          << "partition_throughput,partition_memory,partition_crossing,";
+     os << "status" << endl;
+   }
+
+   // print a solution as a single line
+   void printRecord(ostream &os, ProjectionSolution *ps)
+   {
+     if (json) {
+       ps->printJSON(os);
+       os << endl;
+       return;
+     }
+
+     ostringstream line;
+     ps->print(line);
+
+     // the parametric PE count may span several lines
+     string str = line.str();
+     for (unsigned int i = 0; i < str.size(); i++) {
+       if (str[i] == '\n')
+         str[i] = ' ';
+     }
+
+     os << str << ", " << ps->statusString() << endl;
+   }
+
+   // progress messages
+   ostream *log;
+
+   // record file, one record per finished candidate
+   ofstream recordstream;
+   bool json;
+
+   // records carry the I/O, storage and partition columns
+   bool io;
+   bool storage;
+   bool partitioned;
+
+   // snapshot of the best solutions so far
+   string snapshotfile;
+   int snapshotinterval;
+   int snapshottop;
+   int peinefficiency;
+
+   // number of records emitted, and times used to schedule snapshots
+   unsigned int records;
+   time_t start;
+   time_t lastsnapshot;
+
+};
+
+#endif // __SOLUTION_STREAM_H__
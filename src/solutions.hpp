@@ -26,35 +26,67 @@ class Solutions : public list<ProjectionSolution *>
    }
 
    // destructor
+   // solutions are owned by the list.  a list that holds borrowed solutions
+   // must be cleared before it is destroyed.
    ~Solutions()
    {
+     for (iterator i = begin(); i != end(); i++) {
+       delete *i;
+     }
    }
 
    // static member function, sort helper
-   // compare two projection solutions; sort by throughput, utilization and
-   // latency
+   // compare two projection solutions; sort by throughput on the device,
+   // throughput, PEs, peak I/O, storage, utilization and latency
    static bool compare_proj_solns (
                                     ProjectionSolution *second,
                                     ProjectionSolution *first
                                   )
    {
+     // failed candidates sort after all solutions
+     if (first->status != second->status)
+       return second->status < first->status;
+
+     // on a device with a fixed number of PEs, by the throughput of the
+     // partitioned array first
+     unsigned long long firstrate =
+               (unsigned long long) first->partition_copies *
+                                    second->partition_period;
+     unsigned long long secondrate =
+               (unsigned long long) second->partition_copies *
+                                    first->partition_period;
+     if (firstrate != secondrate)
+       return secondrate > firstrate;
+
      if (first->instance_bpp < second->instance_bpp)
        return true;
      else if (first->instance_bpp == second->instance_bpp)
        if (first->instance_pe_count > second->instance_pe_count)
          return true;
        else if (first->instance_pe_count == second->instance_pe_count)
-         if (first->utilization > second->utilization)
+         if (first->io_per_cycle > second->io_per_cycle)
            return true;
-         else if (first->utilization == second->utilization)
-           if (first->latency > second->latency)
+         else if (first->io_per_cycle == second->io_per_cycle)
+           if (first->instance_storage > second->instance_storage)
              return true;
-           else if (first->latency == second->latency)
-             if (first->network_max_length > second->network_max_length)
+           else if (first->instance_storage == second->instance_storage)
+             if (first->utilization > second->utilization)
                return true;
-             else if (first->network_max_length == second->network_max_length)
-               if (first->network_avg_length > second->network_avg_length)
+             else if (first->utilization == second->utilization)
+               if (first->latency > second->latency)
                  return true;
+               else if (first->latency == second->latency)
+                 if (first->network_max_length > second->network_max_length)
+                   return true;
+                 else if (first->network_max_length == second->network_max_length)
+                   if (first->network_avg_length > second->network_avg_length)
+                     return true;
+                   else if (first->network_avg_length == second->network_avg_length)
+                     // ties are broken by enumeration order, later
+                     // candidates first, so that the order does not depend
+                     // on the order in which candidates complete
+                     if (first->candidate < second->candidate)
+                       return true;
          
      return false;
    }
@@ -65,19 +97,61 @@ class Solutions : public list<ProjectionSolution *>
      this->sort( Solutions::compare_proj_solns );
    }
 
-   // print projection solutions with a unimodular change of basis
-   void printSolutions(int peinefficiency)
+   // solutions that will be printed, in order: those within the processor
+   // inefficiency bound, at most top of them (all if top is 0).  failed
+   // candidates are never selected.
+   list<ProjectionSolution *> topSolutions(int peinefficiency, int top)
    {
+     list<ProjectionSolution *> selected;
 
      list<ProjectionSolution *>::iterator i;
 
      for (i = begin(); i != end(); i++) {
-       if ((*i)->utilization <= peinefficiency) {
-         (*i)->print();
-         cout << endl;
+       if (top > 0 && (int) selected.size() >= top)
+         break;
+
+       if ((*i)->status == ProjectionSolution::OK &&
+             (*i)->utilization <= peinefficiency) {
+         selected.push_back(*i);
        }
      }
 
+     return selected;
+   }
+
+   // print candidates that failed to produce a solution
+   void printFailures(ostream &os = cout)
+   {
+     bool header = false;
+
+     list<ProjectionSolution *>::iterator i;
+
+     for (i = begin(); i != end(); i++) {
+       if ((*i)->status == ProjectionSolution::OK)
+         continue;
+
+       if (!header) {
+         os << "\n\nFailed candidates\n";
+         header = true;
+       }
+
+       (*i)->printProjectionVector(os);
+       os << (*i)->statusString() << endl;
+     }
+   }
+
+   // print projection solutions with a unimodular change of basis
+   void printSolutions(int peinefficiency, int top = 0, ostream &os = cout)
+   {
+
+     list<ProjectionSolution *> selected = topSolutions(peinefficiency, top);
+     list<ProjectionSolution *>::iterator i;
+
+     for (i = selected.begin(); i != selected.end(); i++) {
+       (*i)->print(os);
+       os << endl;
+     }
+
    }
 
 #if 0
@@ -105,6 +179,10 @@ class Solutions : public list<ProjectionSolution *>
 
  private:
 
+   // solutions are owned, do not copy
+   Solutions(const Solutions &);
+   Solutions &operator=(const Solutions &);
+
 };
 
 #endif // __SOLUTIONS_H__
@@ -0,0 +1,1415 @@
+//  systolic-dse.cpp
+//
+//  Library interface to the design space exploration of projection vectors.
+//  Enumerates projection vectors for a polyhedron, with a goal of finding a
+//  high throughput vector.
+
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+// local includes
+#include "systolic-dse.hpp"
+#include "index-enumerator.hpp"
+#include "solutions.hpp"
+#include "solution-stream.hpp"
+#include "checkpoint.hpp"
+#include "worker-pool.hpp"
+#include "local-search.hpp"
+#include "cost-model.hpp"
+#include "pareto-frontier.hpp"
+#include "array-partitioner.hpp"
+
+//
+// enumeration of the projection vectors of one request.  candidates are
+// taken one at a time and evaluated either in this process or by a worker
+// pool; candidates evaluated by an earlier request are taken from the
+// solution cache.
+//
+// in shell order the enumeration stops once no vector of the remaining
+// shells can reach the BPP of the best solution: a vector u projects at
+// most W / |u|_max + 1 points onto a PE, where W is the largest width of
+// the domain at the parameter instance.  the enumeration also stops when
+// the time budget of the request runs out.
+//
+// in parallel mode candidates wait in a lookahead queue, and an idle
+// worker is handed the queued candidate with the longest predicted
+// evaluation time, so no long candidate is left to run alone at the end.
+//
+// in Pareto mode only the solutions on the frontier of the chosen metrics
+// are kept, and they are the solutions printed.
+//
+// with a PE budget, every solution is partitioned onto a device of that
+// many PEs (see ArrayPartitioner) and solutions are ranked by their
+// throughput on the device.
+//
+// with screening, candidates are evaluated with the parameters fixed at
+// their instance values (see ProjectionSolver::setScreening), which ranks
+// them exactly.  the best are evaluated again parametrically when the
+// enumeration finishes.
+//
+class CandidateEnumeration
+{
+
+ public:
+
+   // constructor.  opens the stream and checkpoint of the request and
+   // resumes from the checkpoint.  progress is written to os.
+   CandidateEnumeration(const CommandLineOptions &_clopt,
+                        PolyhedronOptions &polyopt,
+                        ProjectionSolver *_solver,
+                        map< string, string > *_evaluated,
+                        ostream &_os) :
+     clopt (_clopt),
+     solver (_solver),
+     evaluated (_evaluated),
+     os (_os),
+     pv (polyopt.dimensions, _clopt.magnitudebound, _clopt.rank,
+         _clopt.shells),
+     candidates (0),
+     stream (NULL),
+     checkpoint (NULL),
+     pareto (NULL),
+     partitioner (NULL),
+     started (time (NULL)),
+     stopped (EXHAUSTED),
+     shell (0),
+     width (0),
+     bestbpp (-1)
+   {
+     try {
+       // widest extent of the domain bounds the BPP of the outer shells
+       if (clopt.shells) {
+         vector< int > widths = solver->instanceWidths();
+         width = *max_element(widths.begin(), widths.end());
+
+         os << "Shell search, largest domain width: " << width << endl;
+       }
+
+       // keep the Pareto frontier only
+       if (!clopt.pareto.empty()) {
+         pareto = new ParetoFrontier(clopt.pareto, clopt.peinefficiency);
+
+         os << "Pareto frontier over " << pareto->names() << endl;
+       }
+
+       // partition onto a device with a fixed number of PEs
+       if (clopt.pebudget > 0) {
+         partitioner = new ArrayPartitioner(polyopt.dimensions, clopt.rank,
+                                            solver->getDependencies(),
+                                            solver->instanceVertices(),
+                                            clopt.pebudget);
+
+         os << "Partitioning onto " << clopt.pebudget << " PEs" << endl;
+       }
+
+       //
+       // stream solutions as they are found
+       //
+       if (!clopt.streamfile.empty() || !clopt.snapshotfile.empty()) {
+         stream = new SolutionStream(clopt.streamfile, clopt.streamjson,
+                                     clopt.snapshotfile, clopt.snapshotinterval,
+                                     clopt.snapshottop, clopt.peinefficiency,
+                                     clopt.resume, os, clopt.iometrics,
+                                     clopt.storage, partitioner != NULL);
+       }
+
+       //
+       // checkpoint the enumeration, resuming from an earlier checkpoint
+       //
+       if (!clopt.checkpointfile.empty()) {
+         checkpoint = new Checkpoint(clopt.checkpointfile,
+                                     clopt.checkpointinterval,
+                                     clopt.signature());
+
+         if (clopt.resume) {
+           candidates = checkpoint->load(*solver, projsols);
+           pv.seek(checkpoint->lowWaterMark());
+
+           // the checkpoint holds the frontier, rebuild it
+           if (pareto) {
+             list<ProjectionSolution *> loaded;
+             loaded.swap(projsols);
+
+             for (list<ProjectionSolution *>::iterator i = loaded.begin();
+                  i != loaded.end(); i++) {
+               pareto->insert(projsols, *i);
+             }
+           }
+
+           os << "Resuming from checkpoint: " << candidates
+              << " projection vectors already explored" << endl;
+
+           for (list<ProjectionSolution *>::iterator i = projsols.begin();
+                i != projsols.end(); i++) {
+             if (partitioner)
+               partitioner->partition(*i);
+
+             updateBest(*i);
+           }
+         }
+       }
+     }
+     catch (...) {
+       delete stream;
+       delete checkpoint;
+       delete pareto;
+       delete partitioner;
+       throw;
+     }
+   }
+
+   // destructor.  solutions are freed with the list.
+   ~CandidateEnumeration()
+   {
+     delete stream;
+     delete checkpoint;
+     delete pareto;
+     delete partitioner;
+   }
+
+   // advance to the next candidate that must be evaluated.  positions that
+   // are not candidates are skipped and cached candidates are stored.
+   // returns false when the enumeration is exhausted.
+   bool nextCandidate()
+   {
+     while (!pv.end()) {
+
+       // out of time
+       if (outOfTime())
+         return false;
+
+       //
+       //  Check GCD(projection vector) == 1
+       //
+       //
+       // skip if gcd != 1 or zero vector.  projection matrices must span
+       // a lattice not spanned before.  skipped positions are progress.
+       unsigned long first = pv.position;
+       pv.screen();
+
+       if (checkpoint)
+         checkpoint->markFinished(first, pv.position);
+
+       if (pv.end())
+         break;
+
+       // entering a new shell
+       if (clopt.shells && pv.shell() != shell) {
+         shell = pv.shell();
+
+         // BPP of any vector of this or a later shell
+         int bound = width / shell;
+
+         os << "Shell " << shell << ": best BPP ";
+         if (bestbpp < 0)
+           os << "none";
+         else
+           os << bestbpp + 1;
+         os << ", at most " << bound + 1 << " for this and later shells" << endl;
+
+         if (bound < bestbpp || bound == 0) {
+           stopped = CERTIFIED;
+           return false;
+         }
+       }
+
+       // skip candidates finished before the checkpoint
+       if (checkpoint && checkpoint->isFinished(pv.position)) {
+         pv.incr();
+         continue;
+       }
+
+       // evaluated by an earlier request?
+       if (!cached(&pv.index, pv.position))
+         return true;
+
+       //
+       // increment projection vector
+       //
+       pv.incr();
+     }
+
+     return false;
+   }
+
+   // evaluate the current candidate in this process
+   void evaluate()
+   {
+     evaluate(&pv.index, pv.position);
+
+     pv.incr();
+   }
+
+   // queue candidates for the workers until window candidates are queued
+   // or the enumeration has stopped.  returns false when no candidate is
+   // queued.
+   bool nextQueued(unsigned int window)
+   {
+     while (queued.size() < window && stopped == EXHAUSTED &&
+              nextCandidate()) {
+       queued.push_back(make_pair(pv.position, pv.index));
+
+       pv.incr();
+     }
+
+     // out of time, the queued candidates are not evaluated
+     if (stopped == BUDGET)
+       queued.clear();
+
+     return !queued.empty();
+   }
+
+   // hand the queued candidate with the longest predicted evaluation time
+   // to a worker.  ties go to the earliest candidate.
+   void submit(WorkerPool *workers, unsigned int problem)
+   {
+     list< pair< unsigned long, ublas::vector<int> > >::iterator longest;
+     double cost = -1;
+
+     for (list< pair< unsigned long, ublas::vector<int> > >::iterator
+            i = queued.begin(); i != queued.end(); i++) {
+       double c = costs.predict(i->second);
+
+       if (c > cost) {
+         cost    = c;
+         longest = i;
+       }
+     }
+
+     submit(workers, problem, &longest->second, longest->first);
+
+     queued.erase(longest);
+   }
+
+   // evaluate a projection vector in this process
+   ProjectionSolution *evaluate(ublas::vector<int> *v, unsigned long ordinal)
+   {
+     // find throughput, schedule, allocation and PE count
+     ProjectionSolution *ps = solve(v);
+     ps->candidate = ordinal;
+
+     list<ProjectionSolution *> solutions = solver->withVariants(ps, os);
+
+     cacheSolutions(vectorKey(v), solutions);
+     store(solutions);
+
+     return ps;
+   }
+
+   // hand a projection vector to a worker
+   void submit(WorkerPool *workers, unsigned int problem,
+               ublas::vector<int> *v, unsigned long ordinal)
+   {
+     pending[ordinal] = vectorKey(v);
+     running[ordinal] = *v;
+     workers->submit(problem, v, ordinal);
+   }
+
+   // record the evaluation time of a candidate evaluated by a worker
+   void timed(unsigned long ordinal, double seconds)
+   {
+     map< unsigned long, ublas::vector<int> >::iterator r =
+                                                    running.find(ordinal);
+
+     if (r != running.end()) {
+       costs.observe(r->second, seconds);
+       running.erase(r);
+     }
+   }
+
+   // solution of a projection vector evaluated by an earlier request, or
+   // NULL
+   ProjectionSolution *cached(ublas::vector<int> *v, unsigned long ordinal)
+   {
+     map< string, string >::iterator hit = evaluated->find(vectorKey(v));
+
+     if (hit == evaluated->end())
+       return NULL;
+
+     // the solution, then its schedule variants
+     list<ProjectionSolution *> solutions;
+     istringstream saved(hit->second);
+
+     do {
+       ProjectionSolution *ps = solver->newSolution();
+       ps->load(saved);
+       ps->candidate = ordinal;
+       solutions.push_back(ps);
+
+       saved >> ws;
+     } while (!saved.eof());
+
+     ProjectionSolution *ps = solutions.front();
+     store(solutions);
+
+     return ps;
+   }
+
+   // position of a projection vector in the enumeration order
+   unsigned long positionOf(const ublas::vector<int> &v)
+   {
+     return pv.positionOf(v);
+   }
+
+   // has the time budget run out?
+   bool outOfTime()
+   {
+     if (clopt.timebudget > 0 &&
+           time (NULL) - started >= clopt.timebudget) {
+       stopped = BUDGET;
+       return true;
+     }
+
+     return false;
+   }
+
+   // store the solutions collected from workers.  the solutions of a
+   // candidate, its schedule variants after it, are consecutive
+   void collected(list<ProjectionSolution *> &results)
+   {
+     list<ProjectionSolution *>::iterator i = results.begin();
+
+     while (i != results.end()) {
+       list<ProjectionSolution *> solutions;
+       unsigned long ordinal = (*i)->candidate;
+
+       while (i != results.end() && (*i)->candidate == ordinal) {
+         solutions.push_back(*i++);
+       }
+
+       map< unsigned long, string >::iterator p = pending.find(ordinal);
+
+       if (p != pending.end()) {
+         cacheSolutions(p->second, solutions);
+         pending.erase(p);
+       }
+
+       store(solutions);
+     }
+   }
+
+   // number of candidates explored
+   int explored()
+   {
+     return candidates;
+   }
+
+   // the enumeration has finished: write the final checkpoint and
+   // snapshot, and print the ranked solutions to os
+   void finish()
+   {
+     os << candidates << " projection vectors explored\n";
+
+     printCertificate();
+
+     // final checkpoint
+     if (checkpoint) {
+       checkpoint->save(candidates, projsols);
+     }
+
+     // final snapshot
+     if (stream) {
+       stream->snapshot(projsols);
+     }
+
+
+     //
+     // Sort projection vectors by throughput on the device (if
+     // partitioned), throughput (for an instance of the parameters),
+     // utilization, max network length, sum of network lengths
+     // and latency
+     //
+     projsols.Sort();
+
+     // evaluate the best screened solutions parametrically
+     if (clopt.screentop > 0) {
+       solveFinalists();
+     }
+
+     //
+     // recompute parametric PE counts of the solutions that will be printed
+     // if they were dropped (lazy mode), not saved (resumed checkpoint) or
+     // taken from the cache
+     //
+     list<ProjectionSolution *> selected =
+                       projsols.topSolutions(clopt.peinefficiency, clopt.top);
+
+     for (list<ProjectionSolution *>::iterator i = selected.begin();
+          i != selected.end(); i++) {
+       solver->restorePECount(*i);
+     }
+
+     os << "\n\nPrinting solutions\n";
+     if (pareto) {
+       os << "Pareto frontier over " << pareto->names() << ": "
+          << pareto->size() << " solutions\n";
+     }
+     projsols.printSolutions(clopt.peinefficiency, clopt.top, os);
+     projsols.printFailures(os);
+   }
+
+ private:
+
+   //
+   // store a finished candidate: keep its solutions (the solution and its
+   // schedule variants), stream them and record progress in the checkpoint
+   //
+   void store(list<ProjectionSolution *> &solutions)
+   {
+     unsigned long ordinal = solutions.front()->candidate;
+
+     for (list<ProjectionSolution *>::iterator i = solutions.begin();
+          i != solutions.end(); i++) {
+       if (partitioner)
+         partitioner->partition(*i);
+
+       // emit this solution
+       if (stream) {
+         stream->emit(*i);
+       }
+
+       // drop solutions over the I/O and storage bounds
+       if ((*i)->status == ProjectionSolution::OK &&
+             ((clopt.maxiopercycle > 0 &&
+                 (int) (*i)->io_per_cycle > clopt.maxiopercycle) ||
+              (clopt.maxstorage > 0 &&
+                 (*i)->instance_storage > clopt.maxstorage))) {
+         delete *i;
+         continue;
+       }
+
+       updateBest(*i);
+
+       // store this solution.  in Pareto mode a dominated solution is freed
+       if (pareto)
+         pareto->insert(projsols, *i);
+       else
+         projsols.push_front(*i);
+     }
+
+     // count number of candidate projection vectors explored
+     candidates++;
+
+     // refresh the snapshot of the best solutions
+     if (stream) {
+       stream->update(projsols);
+     }
+
+     // record progress
+     if (checkpoint) {
+       checkpoint->markFinished(ordinal);
+       checkpoint->update(candidates, projsols);
+     }
+   }
+
+   //
+   // phase 2 of screening: evaluate the best screened solutions with the
+   // parameters kept symbolic and put them in place of the screened ones.
+   // a screened solution keeps the orientation its schedule was found
+   // for, so the evaluation finds the same schedule and the same ranking.
+   //
+   void solveFinalists()
+   {
+     list<ProjectionSolution *> finalists =
+                   projsols.topSolutions(clopt.peinefficiency, clopt.screentop);
+
+     os << "Solving " << finalists.size()
+        << " screened solutions parametrically" << endl;
+
+     solver->setScreening(false);
+
+     ublas::vector<int> v(pv.index.size());
+
+     for (list<ProjectionSolution *>::iterator f = finalists.begin();
+          f != finalists.end(); f++) {
+       for (unsigned int i = 0; i < v.size(); i++) {
+         v(i) = (*f)->projection_vector[i];
+       }
+
+       // the parametric ILPs may fail where those of the instance did not
+       ProjectionSolution *ps = solve(&v);
+       ps->candidate = (*f)->candidate;
+
+       // the schedule may be a variant (--schedule-variants), keep it and
+       // its delays, which do not depend on the parameters.  the delay
+       // registers do, and are counted again for a variant
+       if (ps->status == ProjectionSolution::OK) {
+         bool variant = !equal(ps->schedule, ps->schedule + v.size(),
+                               (*f)->schedule);
+
+         ps->assignSchedule(**f);
+         ps->network_sum_delays = (*f)->network_sum_delays;
+         ps->network_max_delay  = (*f)->network_max_delay;
+         ps->network_avg_delay  = (*f)->network_avg_delay;
+         ps->io_per_cycle       = (*f)->io_per_cycle;
+
+         if (variant && clopt.storage)
+           solver->countStorage(ps);
+       }
+
+       if (partitioner)
+         partitioner->partition(ps);
+
+       replace(projsols.begin(), projsols.end(), *f, ps);
+       if (pareto) {
+         pareto->replace(*f, ps);
+       }
+       delete *f;
+     }
+
+     projsols.Sort();
+   }
+
+   //
+   // track the best BPP among solutions within the processor inefficiency
+   // bound
+   //
+   void updateBest(ProjectionSolution *ps)
+   {
+     if (ps->status == ProjectionSolution::OK &&
+           (int) ps->utilization <= clopt.peinefficiency &&
+           (int) ps->instance_bpp > bestbpp) {
+       bestbpp = ps->instance_bpp;
+     }
+   }
+
+   //
+   // state how far the result of a stopped enumeration can be trusted
+   //
+   void printCertificate()
+   {
+     if (stopped == CERTIFIED) {
+       int bound = width / shell;
+
+       os << "Optimality certificate: every projection vector with a component"
+          << " of magnitude " << shell << " or more projects at most "
+          << bound + 1 << " points onto a PE (domain width " << width
+          << " at the parameter instance)";
+
+       if (bound < bestbpp) {
+         os << ", fewer than the best BPP " << bestbpp + 1
+            << "; the best solution is optimal over all projection vectors\n";
+       } else if (bestbpp == 0) {
+         os << "; the best BPP 1 is optimal over all projection vectors, ties"
+            << " with larger vectors are not ranked\n";
+       } else {
+         os << "; no solution was found in the smaller shells\n";
+       }
+     } else if (stopped == BUDGET) {
+       os << "Time budget of " << clopt.timebudget << " seconds exhausted";
+
+       if (clopt.shells && shell > 1) {
+         os << " in shell " << shell << "; the best solution is optimal"
+            << " over projection vectors with components of magnitude less"
+            << " than " << shell << " only\n";
+       } else {
+         os << "; the enumeration is incomplete\n";
+       }
+     }
+   }
+
+   //
+   // remember the solutions of a candidate, with its schedule variants.
+   // failed candidates depend on the limits of the request and screened
+   // candidates lack their parametric solution, so neither is cached.
+   //
+   void cacheSolutions(const string &key,
+                       const list<ProjectionSolution *> &solutions)
+   {
+     if (solutions.front()->status != ProjectionSolution::OK ||
+           clopt.screentop > 0)
+       return;
+
+     ostringstream saved;
+     for (list<ProjectionSolution *>::const_iterator i = solutions.begin();
+          i != solutions.end(); i++) {
+       (*i)->save(saved);
+     }
+
+     (*evaluated)[key] = saved.str();
+   }
+
+   //
+   // evaluate a projection vector in this process.  if its ILPs fail, the
+   // candidate is recorded as failed, as by a worker process, and the
+   // enumeration goes on.
+   //
+   ProjectionSolution *solve(ublas::vector<int> *v)
+   {
+     try {
+       return solver->evaluate(v);
+     }
+     catch (DSEError &err) {
+       ProjectionSolution *ps = solver->newSolution();
+       ps->status = ProjectionSolution::ERROR;
+       for (unsigned int i = 0; i < v->size(); i++) {
+         ps->projection_vector[i] = (*v)(i);
+       }
+
+       return ps;
+     }
+   }
+
+   //
+   // key of a projection vector in the solution cache
+   //
+   static string vectorKey(ublas::vector<int> *index)
+   {
+     ostringstream key;
+
+     for (unsigned int i = 0; i < index->size(); i++) {
+       key << (*index)(i) << " ";
+     }
+
+     return key.str();
+   }
+
+   const CommandLineOptions &clopt;
+   ProjectionSolver *solver;
+
+   // saved solutions of evaluated candidates, keyed by vector
+   map< string, string > *evaluated;
+
+   // progress and results
+   ostream &os;
+
+   // this is the projection vector index
+   IndexEnumerator pv;
+
+   // Projection vector solutions
+   Solutions projsols;
+   int candidates;
+
+   SolutionStream *stream;
+   Checkpoint *checkpoint;
+
+   // Pareto frontier, or NULL
+   ParetoFrontier *pareto;
+
+   // partitioner onto the device, or NULL
+   ArrayPartitioner *partitioner;
+
+   // cache keys of candidates being evaluated by workers
+   map< unsigned long, string > pending;
+
+   // candidates waiting for a worker, and candidates being evaluated by
+   // workers, by ordinal
+   list< pair< unsigned long, ublas::vector<int> > > queued;
+   map< unsigned long, ublas::vector<int> > running;
+
+   // predicted evaluation times
+   CostModel costs;
+
+   // why the enumeration stopped
+   enum Stop {
+     EXHAUSTED,   // all candidates taken
+     CERTIFIED,   // no remaining shell can improve the best solution
+     BUDGET       // time budget exhausted
+   };
+
+   time_t started;
+   Stop stopped;
+
+   // shell order: current shell, largest domain width and best BPP so far
+   int shell;
+   int width;
+   int bestbpp;
+
+};
+
+DSESession::DSESession()
+{
+}
+
+DSESession::~DSESession()
+{
+  clear();
+}
+
+void DSESession::clear()
+{
+  map< string, CachedPolyhedron * >::iterator i;
+
+  for (i = polyhedrons.begin(); i != polyhedrons.end(); i++) {
+    release(i->second);
+  }
+  polyhedrons.clear();
+}
+
+unsigned long DSESession::cachedSolutions()
+{
+  unsigned long count = 0;
+
+  map< string, CachedPolyhedron * >::iterator i;
+  map< string, CachedSolver * >::iterator j;
+
+  for (i = polyhedrons.begin(); i != polyhedrons.end(); i++) {
+    for (j = i->second->solvers.begin(); j != i->second->solvers.end(); j++) {
+      count += j->second->evaluated.size();
+    }
+  }
+
+  return count;
+}
+
+void DSESession::release(CachedPolyhedron *poly)
+{
+  map< string, CachedSolver * >::iterator j;
+
+  for (j = poly->solvers.begin(); j != poly->solvers.end(); j++) {
+    delete j->second->solver;
+    delete j->second;
+  }
+
+  delete poly->polyopt;
+  delete poly;
+}
+
+time_t DSESession::modificationTime(PolyhedronOptions &polyopt,
+                                    const string &config)
+{
+  const string files[] = { config, polyopt.pipconstraints,
+                           polyopt.dependencies };
+
+  time_t latest = 0;
+
+  for (unsigned int i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+    struct stat st;
+
+    if (stat (files[i].c_str(), &st) == 0 && st.st_mtime > latest)
+      latest = st.st_mtime;
+  }
+
+  return latest;
+}
+
+DSESession::CachedPolyhedron *DSESession::polyhedron(const string &config,
+                                                     ostream &os)
+{
+  map< string, CachedPolyhedron * >::iterator i = polyhedrons.find(config);
+
+  if (i != polyhedrons.end()) {
+    CachedPolyhedron *poly = i->second;
+
+    if (modificationTime(*poly->polyopt, config) == poly->modified) {
+      os << "Using cached polyhedron configuration file: " << config << endl;
+      return poly;
+    }
+
+    // configuration changed since it was parsed
+    release(poly);
+    polyhedrons.erase(i);
+  }
+
+  //
+  // parse polyhedron configuration file
+  //
+  os << "Parsing polyhedron configuration file: " << config << endl;
+
+  CachedPolyhedron *poly = new CachedPolyhedron;
+
+  try {
+    poly->polyopt = new PolyhedronOptions(config);
+  }
+  catch (...) {
+    delete poly;
+    throw;
+  }
+
+  poly->modified = modificationTime(*poly->polyopt, config);
+
+  polyhedrons[config] = poly;
+
+  return poly;
+}
+
+DSESession::CachedSolver *DSESession::solver(CachedPolyhedron *poly,
+                                             const CommandLineOptions &clopt,
+                                             ostream &os)
+{
+  int pepipelinestages = clopt.pepipelinestages;
+  int rank = clopt.rank;
+
+  ostringstream key;
+  key << pepipelinestages << " " << rank << " " << clopt.allocation << " "
+      << clopt.iometrics << " " << clopt.storage << " "
+      << clopt.schedulevariants << " " << clopt.peinefficiency;
+
+  map< string, CachedSolver * >::iterator i = poly->solvers.find(key.str());
+
+  if (i != poly->solvers.end())
+    return i->second;
+
+  PolyhedronOptions &polyopt = *poly->polyopt;
+
+  //
+  // read polyhedron constraints in pip format from file
+  //
+  os << "Reading pip polyhedron: " << polyopt.pipconstraints << endl;
+
+  CachedSolver *cs = new CachedSolver;
+  cs->polyopt = poly->polyopt;
+
+  try {
+    cs->solver = new ProjectionSolver(
+                        polyopt.dimensions,
+                        polyopt.parameters,
+                        &polyopt.parameterinstantiations,
+                        &polyopt.parameternames,
+                        pepipelinestages,
+                        polyopt.pipconstraints,
+                        polyopt.dependencies,
+                        rank
+                       );
+  }
+  catch (...) {
+    delete cs;
+    throw;
+  }
+
+  // shorten the links of the allocations
+  cs->solver->setAllocationObjective(
+           AllocationOptimizer::objectiveOf(clopt.allocation));
+
+  // count I/O with the host and delay registers
+  cs->solver->setIOMetrics(clopt.iometrics);
+  cs->solver->setStorageCount(clopt.storage);
+
+  // other schedules of each projection
+  cs->solver->setScheduleVariants(clopt.schedulevariants,
+                                  clopt.peinefficiency);
+
+  poly->solvers[key.str()] = cs;
+
+  return cs;
+}
+
+DSESession::CachedSolver *DSESession::prepare(const CommandLineOptions &clopt,
+                                              ostream &os)
+{
+  CachedPolyhedron *poly = polyhedron(clopt.polyhedron, os);
+  CachedSolver *cs = solver(poly, clopt, os);
+
+  os << "Magnitude bound for the projection vector: " << clopt.magnitudebound << endl;
+  os << "Processor inefficiency (lambda * u): " << clopt.peinefficiency << endl;
+  os << "Minimum processor pipeline stages (lambda * d): " << clopt.pepipelinestages << endl;
+  if (clopt.rank > 1)
+    os << "Projection rank: " << clopt.rank << endl;
+  if (clopt.allocation != "none")
+    os << "Allocation objective: " << clopt.allocation << " link length" << endl;
+
+  return cs;
+}
+
+// candidates queued per worker in parallel mode
+static const unsigned int LOOKAHEAD = 8;
+
+//
+// pass the evaluation times of the candidates finished by workers to the
+// cost models of their enumerations
+//
+static void recordTimings(WorkerPool *workers,
+                          const vector< CandidateEnumeration * > &enumerations)
+{
+  vector< WorkerPool::Timing > timings;
+  workers->takeTimings(timings);
+
+  for (unsigned int i = 0; i < timings.size(); i++) {
+    enumerations[timings[i].problem]->timed(timings[i].candidate,
+                                            timings[i].seconds);
+  }
+}
+
+//
+// store the solutions collected from workers by a local search
+//
+static void collectSearch(CandidateEnumeration &e, LocalSearch &search,
+                          WorkerPool *workers,
+                          map< unsigned long, ublas::vector<int> > &submitted)
+{
+  vector< list<ProjectionSolution *> > results;
+  workers->collect(results, 100);
+
+  e.collected(results[0]);
+
+  for (list<ProjectionSolution *>::iterator i = results[0].begin();
+       i != results[0].end(); i++) {
+    // the schedule may negate the vector of a solution, report the vector
+    // that was proposed
+    map< unsigned long, ublas::vector<int> >::iterator s =
+                                         submitted.find((*i)->candidate);
+
+    if (s != submitted.end()) {
+      search.result(s->second, *i);
+      submitted.erase(s);
+    }
+  }
+
+  recordTimings(workers, vector< CandidateEnumeration * >(1, &e));
+}
+
+//
+// local search over projection vectors.  vectors proposed by the chains
+// are evaluated in this process or by the worker pool, and numbered by
+// their position in the enumeration order.
+//
+static void localSearch(CandidateEnumeration &e,
+                        const CommandLineOptions &clopt,
+                        WorkerPool *workers, unsigned int dimensions,
+                        ostream &os)
+{
+  LocalSearch search((LocalSearch::Method) LocalSearch::methodOf(clopt.search),
+                     dimensions, clopt.magnitudebound, clopt.chains,
+                     clopt.steps, clopt.seed, clopt.peinefficiency);
+
+  os << "Local search (" << clopt.search << "): " << clopt.chains
+     << " chains of " << clopt.steps << " steps, seed " << clopt.seed << endl;
+
+  // vectors being evaluated by workers, by position
+  map< unsigned long, ublas::vector<int> > submitted;
+
+  ublas::vector<int> v(dimensions);
+
+  while (!search.done() && !e.outOfTime()) {
+
+    // wait for an idle worker
+    if (workers && !workers->hasIdleWorker()) {
+      collectSearch(e, search, workers, submitted);
+      continue;
+    }
+
+    if (!search.next(v)) {
+      // every proposal is being evaluated
+      if (workers && workers->busy()) {
+        collectSearch(e, search, workers, submitted);
+        continue;
+      }
+
+      break;
+    }
+
+    unsigned long ordinal = e.positionOf(v);
+    ProjectionSolution *ps = e.cached(&v, ordinal);
+
+    if (!ps) {
+      if (workers) {
+        submitted[ordinal] = v;
+        e.submit(workers, 0, &v, ordinal);
+        continue;
+      }
+
+      ps = e.evaluate(&v, ordinal);
+    }
+
+    search.result(v, ps);
+  }
+
+  // finish evaluations in flight
+  while (workers && workers->busy()) {
+    collectSearch(e, search, workers, submitted);
+  }
+
+  os << "Local search evaluated " << search.evaluatedVectors()
+     << " projection vectors" << endl;
+}
+
+int DSESession::enumerate(const CommandLineOptions &clopt, ostream &log)
+{
+  if (!clopt.batchfile.empty())
+    return batch(clopt, log);
+
+  // write to the output file of the request
+  ofstream output;
+  if (!clopt.outputfile.empty()) {
+    output.open(clopt.outputfile.c_str(), ios::out | ios::trunc);
+
+    if (!output) {
+      throw DSEError("Failed to open " + clopt.outputfile);
+    }
+  }
+
+  ostream &os = clopt.outputfile.empty() ? log : output;
+
+  CachedSolver *cs = prepare(clopt, os);
+  ProjectionSolver &solver = *cs->solver;
+
+  // keep only instance PE counts while exploring
+  solver.setLazyPECount(clopt.lazypecount);
+
+  // rank candidates at the parameter instance
+  solver.setScreening(clopt.screentop > 0);
+  if (clopt.screentop > 0) {
+    os << "Screening at the parameter instance, solving the best "
+       << clopt.screentop << " parametrically" << endl;
+  }
+
+  int candidates;
+
+  // solutions of the request are freed when it completes, release their
+  // storage
+  try {
+    CandidateEnumeration e(clopt, *cs->polyopt, &solver, &cs->evaluated, os);
+
+    //
+    // evaluate candidates in worker processes
+    //
+    WorkerPool *workers = NULL;
+    if (clopt.workers > 0) {
+      os << "Worker processes: " << clopt.workers << endl;
+      if (clopt.countworkers > 0) {
+        os << "Count worker processes: " << clopt.countworkers << endl;
+      }
+      workers = new WorkerPool(vector< ProjectionSolver * >(1, &solver),
+                               clopt.workers, clopt.candidatetimeout,
+                               clopt.candidatememory, clopt.countworkers);
+    }
+
+    try {
+      unsigned int window = LOOKAHEAD * clopt.workers;
+      bool more = false;
+
+      if (clopt.search.empty()) {
+        more = workers ? e.nextQueued(window) : e.nextCandidate();
+      }
+
+      if (!clopt.search.empty()) {
+        localSearch(e, clopt, workers, cs->polyopt->dimensions, os);
+      }
+
+      while (more || (workers && workers->busy())) {
+
+        //
+        // in parallel mode, wait for an idle worker and store results
+        //
+        if (workers && (!more || !workers->hasIdleWorker())) {
+          vector< list<ProjectionSolution *> > results;
+          workers->collect(results, 100);
+
+          e.collected(results[0]);
+
+          recordTimings(workers, vector< CandidateEnumeration * >(1, &e));
+
+          continue;
+        }
+
+        if (workers) {
+          e.submit(workers, 0);
+          more = e.nextQueued(window);
+        } else {
+          e.evaluate();
+          more = e.nextCandidate();
+        }
+      }
+    }
+    catch (...) {
+      delete workers;
+      throw;
+    }
+
+    delete workers;
+
+    e.finish();
+    candidates = e.explored();
+  }
+  catch (...) {
+    solver.resetArena();
+    throw;
+  }
+
+  solver.resetArena();
+
+  return candidates;
+}
+
+//
+// read a batch manifest.  each line holds a polyhedron configuration file
+// (relative to the manifest) followed by options; blank lines and lines
+// starting with # are ignored.
+//
+static void readManifest(const string &manifest,
+                         vector< CommandLineOptions * > &problems,
+                         vector< string > &outputs)
+{
+  ifstream in(manifest.c_str());
+
+  if (!in) {
+    throw DSEError("Failed to open " + manifest);
+  }
+
+  string dir;
+  if (manifest.find('/') != string::npos)
+    dir = manifest.substr(0, manifest.rfind('/') + 1);
+
+  string line;
+  int lineno = 0;
+
+  while (getline(in, line)) {
+    lineno++;
+
+    vector< string > args = po::split_unix(line);
+
+    if (args.empty() || args[0][0] == '#')
+      continue;
+
+    // configuration file
+    string config = args[0];
+    if (config[0] != '/')
+      config = dir + config;
+
+    args[0] = config;
+    args.insert(args.begin(), "-i");
+
+    ostringstream where;
+    where << manifest << ":" << lineno << ": ";
+
+    CommandLineOptions *clopt;
+    try {
+      clopt = new CommandLineOptions(args);
+    }
+    catch (DSEError &err) {
+      throw DSEError(where.str() + err.what());
+    }
+
+    problems.push_back(clopt);
+
+    if (clopt->help || !clopt->batchfile.empty() || clopt->workers > 0) {
+      throw DSEError(where.str() +
+                     "workers and limits are set on the batch command line");
+    }
+
+    if (!clopt->search.empty()) {
+      throw DSEError(where.str() + "local search is not supported in a batch");
+    }
+
+    // default output file: configuration name in the current directory,
+    // with the line number if the name is taken
+    string output = clopt->outputfile;
+
+    if (output.empty()) {
+      string base = config.substr(config.rfind('/') + 1);
+      if (base.rfind('.') != string::npos && base.rfind('.') > 0)
+        base = base.substr(0, base.rfind('.'));
+
+      output = base + ".out";
+
+      if (find(outputs.begin(), outputs.end(), output) != outputs.end()) {
+        ostringstream numbered;
+        numbered << base << "-" << lineno << ".out";
+        output = numbered.str();
+      }
+    }
+
+    outputs.push_back(output);
+  }
+}
+
+//
+// free the problems of a batch.  solutions are freed before their storage;
+// problems may share a solver, so storage is released only when all
+// problems are done.
+//
+static void releaseBatch(vector< CommandLineOptions * > &problems,
+                         vector< ofstream * > &files,
+                         vector< CandidateEnumeration * > &enumerations,
+                         vector< ProjectionSolver * > &solvers)
+{
+  for (unsigned int p = 0; p < enumerations.size(); p++) {
+    delete enumerations[p];
+  }
+
+  for (unsigned int p = 0; p < solvers.size(); p++) {
+    solvers[p]->resetArena();
+  }
+
+  for (unsigned int p = 0; p < files.size(); p++) {
+    delete files[p];
+  }
+
+  for (unsigned int p = 0; p < problems.size(); p++) {
+    delete problems[p];
+  }
+}
+
+int DSESession::batch(const CommandLineOptions &clopt, ostream &log)
+{
+  vector< CommandLineOptions * > problems;
+  vector< string > outputs;
+  vector< ofstream * > files;
+  vector< CandidateEnumeration * > enumerations;
+  vector< ProjectionSolver * > solvers;
+  WorkerPool *workers = NULL;
+
+  int candidates = 0;
+
+  try {
+    readManifest(clopt.batchfile, problems, outputs);
+
+    if (clopt.screentop > 0) {
+      throw DSEError("screening is set on the lines of the batch manifest");
+    }
+
+    log << "Batch of " << problems.size() << " problems: "
+        << clopt.batchfile << endl;
+
+    //
+    // prepare every problem.  solvers are created before worker processes
+    // are forked so that workers can evaluate candidates of all problems
+    //
+    for (unsigned int p = 0; p < problems.size(); p++) {
+      files.push_back(new ofstream(outputs[p].c_str(), ios::out | ios::trunc));
+
+      if (!*files[p]) {
+        throw DSEError("Failed to open " + outputs[p]);
+      }
+
+      CachedSolver *cs = prepare(*problems[p], *files[p]);
+      solvers.push_back(cs->solver);
+
+      enumerations.push_back(new CandidateEnumeration(*problems[p],
+                                                      *cs->polyopt,
+                                                      cs->solver,
+                                                      &cs->evaluated,
+                                                      *files[p]));
+    }
+
+    // problems may share a solver.  parametric PE counts are recomputed
+    // for printed solutions, so lazy counting does not change results
+    for (unsigned int p = 0; p < problems.size(); p++) {
+      if (problems[p]->lazypecount || clopt.lazypecount)
+        solvers[p]->setLazyPECount(true);
+    }
+
+    // screening changes the solutions kept, so problems sharing a solver
+    // must agree on it
+    for (unsigned int p = 0; p < problems.size(); p++) {
+      for (unsigned int q = 0; q < p; q++) {
+        if (solvers[q] == solvers[p] &&
+              (problems[q]->screentop > 0) != (problems[p]->screentop > 0)) {
+          throw DSEError(problems[p]->polyhedron +
+                         ": problems sharing a polyhedron and solver options"
+                         " must all screen or none");
+        }
+      }
+
+      solvers[p]->setScreening(problems[p]->screentop > 0);
+    }
+
+    //
+    // one pool of worker processes shared by all problems
+    //
+    if (clopt.workers > 0) {
+      log << "Worker processes: " << clopt.workers << endl;
+      if (clopt.countworkers > 0) {
+        log << "Count worker processes: " << clopt.countworkers << endl;
+      }
+      workers = new WorkerPool(solvers, clopt.workers,
+                               clopt.candidatetimeout, clopt.candidatememory,
+                               clopt.countworkers);
+    }
+
+    //
+    // fair scheduling: candidates are taken from the problems in round
+    // robin order, one candidate per problem per turn
+    //
+    unsigned int window = LOOKAHEAD * clopt.workers;
+
+    vector< bool > more(problems.size());
+    for (unsigned int p = 0; p < problems.size(); p++) {
+      more[p] = workers ? enumerations[p]->nextQueued(window)
+                        : enumerations[p]->nextCandidate();
+    }
+
+    unsigned int turn = 0;
+
+    for (;;) {
+      // next problem with a candidate, in round robin order
+      int next = -1;
+      for (unsigned int k = 0; k < problems.size(); k++) {
+        unsigned int p = (turn + k) % problems.size();
+
+        if (more[p]) {
+          next = p;
+          break;
+        }
+      }
+
+      if (next < 0 && !(workers && workers->busy()))
+        break;
+
+      //
+      // in parallel mode, wait for an idle worker and store results
+      //
+      if (workers && (next < 0 || !workers->hasIdleWorker())) {
+        vector< list<ProjectionSolution *> > results;
+        workers->collect(results, 100);
+
+        for (unsigned int p = 0; p < results.size(); p++) {
+          enumerations[p]->collected(results[p]);
+        }
+
+        recordTimings(workers, enumerations);
+
+        continue;
+      }
+
+      if (workers) {
+        enumerations[next]->submit(workers, next);
+        more[next] = enumerations[next]->nextQueued(window);
+      } else {
+        enumerations[next]->evaluate();
+        more[next] = enumerations[next]->nextCandidate();
+      }
+      turn = next + 1;
+    }
+
+    delete workers;
+    workers = NULL;
+
+    //
+    // write the ranked solutions of every problem to its output file
+    //
+    for (unsigned int p = 0; p < problems.size(); p++) {
+      enumerations[p]->finish();
+      candidates += enumerations[p]->explored();
+
+      log << problems[p]->polyhedron << ": "
+          << enumerations[p]->explored() << " projection vectors explored, "
+          << "solutions written to " << outputs[p] << endl;
+    }
+  }
+  catch (...) {
+    delete workers;
+    releaseBatch(problems, files, enumerations, solvers);
+    throw;
+  }
+
+  releaseBatch(problems, files, enumerations, solvers);
+
+  return candidates;
+}
+
+int dse_enumerate(DSESession &session, const vector< string > &args,
+                  ostream &os, string &error)
+{
+  try {
+    CommandLineOptions clopt(args);
+
+    if (clopt.help) {
+      os << clopt.usage << "\n";
+      return 0;
+    }
+
+    session.enumerate(clopt, os);
+  }
+  catch (DSEError &err) {
+    error = err.what();
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+//  systolic-dse.hpp
+//
+//  Library interface (libsystolic-dse) to the design space exploration of
+//  projection vectors.
+//
+//  A DSESession answers enumeration requests, which take the same options
+//  as the enumerate program.  The session keeps parsed polyhedron
+//  configurations, their solvers and the solutions of all projection
+//  vectors already evaluated, so repeated requests on a polyhedron skip file
+//  parsing and evaluate only candidates not seen before.  Cached
+//  configurations are reloaded when one of their files changes.
+//
+//  Errors are thrown as DSEError and leave the session usable.  PIP and
+//  barvinok keep global state, so requests must not run concurrently in
+//  several threads of a process.
+
+#ifndef __SYSTOLIC_DSE_H__
+#   define __SYSTOLIC_DSE_H__
+
+#include <ctime>
+#include <map>
+#include <utility>
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// local includes
+#include "dse-error.hpp"
+#include "commandline-options.hpp"
+#include "polyhedron-options.hpp"
+#include "projection-solver.hpp"
+
+class DSESession
+{
+
+ public:
+
+   // constructor
+   DSESession();
+
+   // destructor
+   ~DSESession();
+
+   // run an enumeration request.  progress messages and the ranked
+   // solutions are written to os, or to the output file of the request.
+   // a batch request runs every problem of its manifest.  returns the
+   // number of candidate projection vectors explored.  throws DSEError.
+   int enumerate(const CommandLineOptions &clopt, ostream &os);
+
+   // run every problem of a batch manifest in one worker pool, with
+   // candidates scheduled round robin across problems.  the ranked
+   // solutions of each problem are written to its own output file and a
+   // summary to log.  returns the total number of candidates explored.
+   int batch(const CommandLineOptions &clopt, ostream &log);
+
+   // drop all cached polyhedrons, solvers and solutions
+   void clear();
+
+   // number of evaluated candidates held in the cache
+   unsigned long cachedSolutions();
+
+ private:
+
+   // solver for a polyhedron and the options that shape its solutions, with
+   // the saved solutions of every candidate it has evaluated (keyed by
+   // vector)
+   struct CachedSolver
+   {
+     PolyhedronOptions *polyopt;
+     ProjectionSolver *solver;
+     map< string, string > evaluated;
+   };
+
+   // parsed polyhedron configuration and its solvers, keyed by the number
+   // of pipeline stages, the projection rank, the allocation objective and
+   // whether I/O and storage are counted
+   struct CachedPolyhedron
+   {
+     PolyhedronOptions *polyopt;
+     time_t modified;
+     map< string, CachedSolver * > solvers;
+   };
+
+   // find or load a polyhedron configuration
+   CachedPolyhedron *polyhedron(const string &config, ostream &os);
+
+   // find or create the solver of a request
+   CachedSolver *solver(CachedPolyhedron *poly,
+                        const CommandLineOptions &clopt, ostream &os);
+
+   // find the solver of a request and print its options
+   CachedSolver *prepare(const CommandLineOptions &clopt, ostream &os);
+
+   // latest modification time of a configuration and its input files
+   time_t modificationTime(PolyhedronOptions &polyopt, const string &config);
+
+   // free a cached polyhedron and its solvers
+   void release(CachedPolyhedron *poly);
+
+   // cached polyhedrons, keyed by configuration file
+   map< string, CachedPolyhedron * > polyhedrons;
+
+   // the session owns solvers, do not copy
+   DSESession(const DSESession &);
+   DSESession &operator=(const DSESession &);
+
+};
+
+//
+// run an enumeration request given as program arguments (without the
+// program name).  returns 0 on success, or -1 with the message in error.
+//
+int dse_enumerate(DSESession &session, const vector< string > &args,
+                  ostream &os, string &error);
+
+#endif // __SYSTOLIC_DSE_H__
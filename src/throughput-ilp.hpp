@@ -8,6 +8,11 @@
 //  Create ILP to find k_max, the maximum number of points projected onto any
 //  processing element by projection vector u.
 //
+//  For a projection of rank k with directions u_1..u_k, points x1, x2 are
+//  projected onto the same processing element when x1 - x2 = c_1 u_1 + ... +
+//  c_k u_k.  The ILP maximizes the coefficient c_d of one direction d, the
+//  extent of the projection along u_d; the other coefficients are free.
+//
 //  Input is an input polyhedron Ax <= b in PIP matrix format
 //  Output is the ILP in PIP matrix format
 
@@ -19,21 +24,35 @@
 // pip includes
 #include <piplib/piplibMP.h>
 
+// local includes
+#include "pip-workspace.hpp"
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
 class ThroughputILP
 {
 
  public:
 
    // constructor
+   //   pv        - projection matrix, k x n row major
+   //   rank      - number of projection directions k
+   //   direction - direction whose extent is maximized
+   //   workspace - pool the matrices are taken from, or NULL to allocate
    ThroughputILP(PipMatrix *polyhedron, PipMatrix *context,
                  unsigned int dimensions, unsigned int parameters,
-                 ublas::vector<int> *pv)
+                 ublas::vector<int> *pv, unsigned int rank = 1,
+                 unsigned int direction = 0,
+                 PipWorkspace *_workspace = NULL) :
+     workspace (_workspace)
    {
 //     pip_matrix_print(stdout, polyhedron);
 //     pip_matrix_print(stdout, context);
 
      // generate throughput ilp
-     GenThroughputILP(polyhedron, context, dimensions, parameters, pv);
+     GenThroughputILP(polyhedron, context, dimensions, parameters, pv,
+                      rank, direction);
 
 //     cout << endl << "Projection vector: " << *pv << endl;
 //     pip_matrix_print(stdout, throughputilp);
@@ -45,8 +64,13 @@ class ThroughputILP
    // destructor
    ~ThroughputILP()
    {
-     pip_matrix_free(contextilp);
-     pip_matrix_free(throughputilp);
+     if (workspace) {
+       workspace->release(contextilp);
+       workspace->release(throughputilp);
+     } else {
+       pip_matrix_free(contextilp);
+       pip_matrix_free(throughputilp);
+     }
    }
    
    // get throughput ilp
@@ -72,24 +96,41 @@ private:
    PipMatrix *throughputilp, *contextilp;
    int bigParamPos;
 
+   PipWorkspace *workspace;
+
+   // zero matrix, from the workspace if there is one
+   PipMatrix *allocate(unsigned int rows, unsigned int columns)
+   {
+     return workspace ? workspace->allocate(rows, columns)
+                      : pip_matrix_alloc(rows, columns);
+   }
+
    void GenThroughputILP(PipMatrix *polyhedron, PipMatrix *context,
                          unsigned int dimensions, unsigned int parameters,
-                         ublas::vector<int> *pv)
+                         ublas::vector<int> *pv, unsigned int rank,
+                         unsigned int direction)
    {
      int no_constraints = polyhedron->NbRows;
 
+     // coefficients of the other directions
+     unsigned int others = rank - 1;
+
      // allocate memory for throughput ilp constraints
      //  Number of constraints = #orig_constraints * 2 + dimensions
      //        A x1 <= b; A x2 <= b; x1 - x2 = ku
      //
      //  Number of columns = 1 + dimensions * 2 + parameters + 3 (const, B, k')
-     throughputilp = pip_matrix_alloc(
+     //                      + coefficients of the other directions
+     throughputilp = allocate(
                        no_constraints * 2 + dimensions,
-                       1 + dimensions * 2 + parameters + 3
+                       1 + dimensions * 2 + others + parameters + 3
                      );
 
      // format of columns is as follows
-     //       equality?  k'  i1  ... k1 i2 ... k2 N1 ... N3 B const 
+     //       equality?  k'  i1  ... k1 i2 ... k2 c1'' ... N1 ... N3 B const 
+     //
+     // the coefficients c'' of the other directions follow x2 so that the
+     // solution lists k', x1 and x2 first
 
      // copy polyhedron constraints: A x1 <= b
      for (int i = 0; i < no_constraints; i++) {
@@ -112,18 +153,23 @@ private:
          entier_set_si (throughputilp->p[i][j+dimensions+1], 0);
        }
 
+       // set coefficients of the other directions to zero
+       for (unsigned int j = 1; j <= others; j++) {
+         entier_set_si (throughputilp->p[i][j+2*dimensions+1], 0);
+       }
+
        // set parameters
        for (unsigned int j = 1; j <= parameters; j++) {
          entier_assign (
-                        throughputilp->p[i][j+2*dimensions+1],
+                        throughputilp->p[i][j+2*dimensions+others+1],
                         polyhedron->p[i][j+dimensions]
                         );
        }
 
        // set B, const column
-       entier_set_si (throughputilp->p[i][dimensions*2+parameters+2], 0);
+       entier_set_si (throughputilp->p[i][dimensions*2+others+parameters+2], 0);
        entier_assign (
-                      throughputilp->p[i][dimensions*2+parameters+3],
+                      throughputilp->p[i][dimensions*2+others+parameters+3],
                       polyhedron->p[i][dimensions+parameters+1]
                       );
      }
@@ -152,18 +198,23 @@ private:
                         );
        }
 
+       // set coefficients of the other directions to zero
+       for (unsigned int j = 1; j <= others; j++) {
+         entier_set_si (throughputilp->p[i][j+2*dimensions+1], 0);
+       }
+
        // set parameters
        for (unsigned int j = 1; j <= parameters; j++) {
          entier_assign (
-                        throughputilp->p[i][j+2*dimensions+1],
+                        throughputilp->p[i][j+2*dimensions+others+1],
                         polyhedron->p[i-no_constraints][j+dimensions]
                         );
        }
 
        // set B, const column
-       entier_set_si (throughputilp->p[i][dimensions*2+parameters+2], 0);
+       entier_set_si (throughputilp->p[i][dimensions*2+others+parameters+2], 0);
        entier_assign (
-                      throughputilp->p[i][dimensions*2+parameters+3],
+                      throughputilp->p[i][dimensions*2+others+parameters+3],
                       polyhedron->p[i-no_constraints][dimensions+parameters+1]
                       );
      }
@@ -172,14 +223,19 @@ private:
      // to maximize k, we use k' = B - k where B is a big parameter and minimize
      // k'.  We specify k' as the first unknown to minimize it
      //
+     // rank k: x1 - x2 = k u_d + sum c_j u_j over the other directions, with
+     // the free coefficients c_j = c_j'' - B
+     //
      for (unsigned int i = 0; i < dimensions; i++) {
+        int u = (*pv)(direction * dimensions + i);
+
         // equality
         entier_set_si (throughputilp->p[i+no_constraints*2][0], 0);
 
         // set k' column = projection_vector[]
         entier_set_si (
                        throughputilp->p[i+no_constraints*2][1],
-                       (*pv)(i)
+                       u
                        );
 
         // zero dimensions (unknowns) for A x1 <= b and A x2 <= b to zero
@@ -194,29 +250,44 @@ private:
                        -1
                        );
 
+        // set -c'' for the other directions, and collect their B terms
+        int bigparam = -u;
+        for (unsigned int j = 0, c = 1; j < rank; j++) {
+          if (j == direction)
+            continue;
+
+          int uj = (*pv)(j * dimensions + i);
+          entier_set_si (
+                         throughputilp->p[i+no_constraints*2][c+2*dimensions+1],
+                         -uj
+                         );
+          bigparam += uj;
+          c++;
+        }
+
         // set parameters to zero
         for (unsigned int j = 1; j <= parameters; j++) {
           entier_set_si (
-                         throughputilp->p[i+no_constraints*2][j+2*dimensions+1],
-                         0
-                         );
+                  throughputilp->p[i+no_constraints*2][j+2*dimensions+others+1],
+                  0
+                  );
         }
 
         // set B, const column
         entier_set_si (
-              throughputilp->p[i+no_constraints*2][dimensions*2+parameters+2],
-              -1 * (*pv)(i)
-              );
+       throughputilp->p[i+no_constraints*2][dimensions*2+others+parameters+2],
+       bigparam
+       );
 
         entier_set_si (
-              throughputilp->p[i+no_constraints*2][dimensions*2+parameters+3],
-              0
-              );
+       throughputilp->p[i+no_constraints*2][dimensions*2+others+parameters+3],
+       0
+       );
      }
     
      // column position of big parameter in constraint row
      // first column (equality/inequality?) starts at index 0
-     bigParamPos = dimensions*2 + parameters + 2;
+     bigParamPos = dimensions*2 + others + parameters + 2;
 
      //
      //  generate context for parameters
@@ -225,7 +296,7 @@ private:
      //  Number of constraints = #orig_constraints
      //
      //  Number of columns = original_columns + 1 (for new parameter B)
-     contextilp = pip_matrix_alloc(
+     contextilp = allocate(
                        context->NbRows,
                        context->NbColumns + 1
                      );
@@ -0,0 +1,709 @@
+//  worker-pool.hpp
+//
+//  Evaluate projection vectors in a pool of forked worker processes.
+//
+//  PIP and barvinok keep global state and may abort on unexpected solver
+//  output, so candidates are isolated in worker processes.  Each
+//  worker evaluates one candidate at a time and is killed if the candidate
+//  exceeds its wall clock or resident memory limit.  Candidates that time
+//  out, crash or run out of memory are returned as solutions with a failed
+//  status, and the worker is replaced.  The wall clock time of every
+//  finished candidate is recorded for the cost model of the enumeration.
+//
+//  Workers are forked after the solvers of all problems are created, so a
+//  pool can evaluate candidates of several problems (batch mode).
+//
+//  With count workers, the evaluation of a candidate is split into the
+//  stages of CandidateStages.  The ILPs run in the PIP workers and the PE
+//  counts in the count workers, so a few expensive candidates still keep
+//  every worker busy.  The limits then apply to each stage.
+//
+//  Protocol, one line per message over pipes:
+//    parent -> worker:  problem ordinal stage n u_1 ... u_n length
+//                       <length bytes of saved partial solutions>
+//    worker -> parent:  ordinal count
+//                       <count lines, ProjectionSolution::save()>
+//                       END
+//  The ordinal of a stage is the id of its task.  A finished candidate
+//  (EVALUATE or COUNT) returns its solution followed by its schedule
+//  variants.
+
+#ifndef __WORKER_POOL_H__
+#   define __WORKER_POOL_H__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <list>
+using namespace std;
+
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+#include <boost/numeric/ublas/vector.hpp>
+namespace ublas = boost::numeric::ublas;
+
+// local includes
+#include "dse-error.hpp"
+#include "projection-solution.hpp"
+#include "projection-solver.hpp"
+#include "candidate-stages.hpp"
+
+class WorkerPool
+{
+
+ public:
+
+   // constructor
+   //   solvers      - solver of each problem, used by the workers and to
+   //                  allocate results
+   //   workers      - number of worker processes (PIP workers with count
+   //                  workers)
+   //   timeout      - wall clock limit per candidate in seconds (0: none)
+   //   memorylimit  - resident memory limit per candidate in MB (0: none)
+   //   countworkers - number of worker processes counting PEs (0: whole
+   //                  candidates in every worker)
+   WorkerPool(const vector< ProjectionSolver * > &_solvers,
+              unsigned int _workers, int _timeout, long _memorylimit,
+              unsigned int _countworkers = 0) :
+     solvers (_solvers),
+     timeout (_timeout),
+     memorylimit (_memorylimit),
+     pool (_workers + _countworkers),
+     stages (NULL)
+   {
+     // a worker may die while we write to it
+     signal (SIGPIPE, SIG_IGN);
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       pool[i].pid      = 0;
+       pool[i].busy     = false;
+       pool[i].counting = i >= _workers;
+     }
+
+     if (_countworkers > 0) {
+       stages = new CandidateStages(solvers,
+                                    COUNT_QUEUE_PER_WORKER * _countworkers);
+     }
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       spawn(i);
+     }
+   }
+
+   // destructor
+   ~WorkerPool()
+   {
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       // workers exit when their input is closed
+       close (pool[i].tochild);
+       close (pool[i].fromchild);
+
+       if (pool[i].busy)
+         kill (pool[i].pid, SIGKILL);
+
+       waitpid (pool[i].pid, NULL, 0);
+     }
+
+     delete stages;
+   }
+
+   // is there an idle worker for a candidate?  with count workers, an idle
+   // PIP worker while no task waits for a worker and the COUNT queue has
+   // room.
+   bool hasIdleWorker()
+   {
+     if (stages && !stages->accepting())
+       return false;
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (!pool[i].busy && !pool[i].counting)
+         return true;
+     }
+
+     return false;
+   }
+
+   // is any candidate being evaluated?
+   bool busy()
+   {
+     if (stages && stages->busy())
+       return true;
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (pool[i].busy)
+         return true;
+     }
+
+     return false;
+   }
+
+   // hand a candidate of a problem to an idle worker.  there must be an
+   // idle worker.
+   void submit(unsigned int problem, ublas::vector<int> *pv,
+               unsigned long ordinal)
+   {
+     if (stages) {
+       stages->add(problem, pv, ordinal);
+       dispatch();
+       return;
+     }
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (pool[i].busy)
+         continue;
+
+       vector< int > index(pv->size());
+       for (unsigned int j = 0; j < pv->size(); j++) {
+         index[j] = (*pv)(j);
+       }
+
+       send(pool[i], problem, ordinal, CandidateStages::EVALUATE, index,
+            string());
+       return;
+     }
+
+     throw DSEError("No idle worker for candidate");
+   }
+
+   // evaluation time of a finished candidate
+   struct Timing
+   {
+     unsigned int problem;
+     unsigned long candidate;
+     double seconds;
+   };
+
+   // move the times of the candidates finished since the last call to
+   // timings
+   void takeTimings(vector< Timing > &timings)
+   {
+     timings.clear();
+     timings.swap(finished);
+   }
+
+   // wait up to waitms milliseconds for candidates to finish, and enforce
+   // limits.  solutions of finished candidates (including failed ones) are
+   // appended to the results of their problem.
+   void collect(vector< list<ProjectionSolution *> > &results, int waitms)
+   {
+     results.resize(solvers.size());
+
+     if (stages)
+       dispatch();
+
+     vector<struct pollfd> fds;
+     vector<unsigned int> owner;
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (!pool[i].busy)
+         continue;
+
+       struct pollfd pfd;
+       pfd.fd      = pool[i].fromchild;
+       pfd.events  = POLLIN;
+       pfd.revents = 0;
+
+       fds.push_back(pfd);
+       owner.push_back(i);
+     }
+
+     if (fds.empty())
+       return;
+
+     int ready = poll (&fds[0], fds.size(), waitms);
+
+     if (ready < 0 && errno != EINTR) {
+       throw DSEError("Failed to poll worker processes");
+     }
+
+     for (unsigned int k = 0; ready > 0 && k < fds.size(); k++) {
+       if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+         continue;
+
+       Worker &w = pool[owner[k]];
+
+       char chunk[4096];
+       ssize_t n = read (w.fromchild, chunk, sizeof (chunk));
+
+       if (n > 0) {
+         w.buffer.append(chunk, n);
+
+         // complete result?
+         if (w.buffer.size() >= 4 &&
+               w.buffer.compare(w.buffer.size() - 4, 4, "END\n") == 0) {
+           parseResult(w, results);
+           w.busy = false;
+         }
+       } else if (n == 0 || errno != EINTR) {
+         // worker died
+         fail(owner[k], exitStatus(w.pid), results);
+       }
+     }
+
+     // enforce limits on the remaining busy workers
+     struct timeval now;
+     gettimeofday (&now, NULL);
+
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (!pool[i].busy)
+         continue;
+
+       double elapsed = (now.tv_sec - pool[i].start.tv_sec) +
+                        (now.tv_usec - pool[i].start.tv_usec) / 1e6;
+
+       if (timeout > 0 && elapsed > timeout) {
+         kill (pool[i].pid, SIGKILL);
+         waitpid (pool[i].pid, NULL, 0);
+         fail(i, ProjectionSolution::TIMEOUT, results);
+       } else if (memorylimit > 0 &&
+                    residentMB(pool[i].pid) > memorylimit) {
+         kill (pool[i].pid, SIGKILL);
+         waitpid (pool[i].pid, NULL, 0);
+         fail(i, ProjectionSolution::MEMORY, results);
+       }
+     }
+
+     // hand the tasks that became ready to idle workers
+     if (stages)
+       dispatch();
+   }
+
+private:
+
+   struct Worker
+   {
+     pid_t pid;
+     int tochild;
+     int fromchild;
+
+     // counts PEs of candidate stages
+     bool counting;
+
+     // candidate being evaluated
+     bool busy;
+     unsigned int problem;
+     unsigned long candidate;
+     vector<int> index;
+     struct timeval start;
+
+     // partial result read from the worker
+     string buffer;
+   };
+
+   // fork a worker into slot i
+   void spawn(unsigned int i)
+   {
+     int down[2], up[2];
+
+     if (pipe (down) < 0 || pipe (up) < 0) {
+       throw DSEError("Failed to create pipes for worker process");
+     }
+
+     // do not duplicate buffered output in the child
+     cout.flush();
+     fflush (stdout);
+
+     pid_t pid = fork();
+
+     if (pid < 0) {
+       throw DSEError("Failed to fork worker process");
+     }
+
+     if (pid == 0) {
+       // worker: close the parent's ends and other workers' pipes
+       close (down[1]);
+       close (up[0]);
+
+       for (unsigned int j = 0; j < pool.size(); j++) {
+         if (j != i && pool[j].pid > 0) {
+           close (pool[j].tochild);
+           close (pool[j].fromchild);
+         }
+       }
+
+       // no exception may unwind into the parent's code in the worker
+       // (bad_alloc under the memory limit, boost errors).  the candidate
+       // is reported as failed when the worker exits
+       try {
+         serve(down[0], up[1]);
+       }
+       catch (std::exception &err) {
+         cerr << err.what() << endl;
+         _exit (1);
+       }
+       catch (...) {
+         _exit (1);
+       }
+       _exit (0);
+     }
+
+     close (down[0]);
+     close (up[1]);
+
+     pool[i].pid       = pid;
+     pool[i].tochild   = down[1];
+     pool[i].fromchild = up[0];
+     pool[i].busy      = false;
+   }
+
+   // hand a task to a worker
+   void send(Worker &w, unsigned int problem, unsigned long ordinal,
+             CandidateStages::Stage stage, const vector< int > &index,
+             const string &payload)
+   {
+     w.busy      = true;
+     w.problem   = problem;
+     w.candidate = ordinal;
+     w.index     = index;
+     w.buffer.clear();
+     gettimeofday (&w.start, NULL);
+
+     ostringstream msg;
+     msg << problem << " " << ordinal << " " << (int) stage << " "
+         << index.size();
+     for (unsigned int j = 0; j < index.size(); j++) {
+       msg << " " << index[j];
+     }
+     msg << " " << payload.size() << "\n" << payload;
+
+     // a worker that died while idle is noticed when collecting
+     writeAll (w.tochild, msg.str());
+   }
+
+   // hand ready tasks of candidate stages to idle workers
+   void dispatch()
+   {
+     for (unsigned int i = 0; i < pool.size(); i++) {
+       if (pool[i].busy)
+         continue;
+
+       CandidateStages::Task task;
+       if (!stages->next(pool[i].counting, task))
+         continue;
+
+       send(pool[i], task.problem, task.id, task.stage, task.index,
+            task.payload);
+     }
+   }
+
+   // worker main loop: evaluate candidates until input is closed
+   void serve(int in, int out)
+   {
+     FILE *fin = fdopen (in, "r");
+     char line[4096];
+
+     while (fgets (line, sizeof (line), fin)) {
+       istringstream msg(line);
+
+       unsigned int problem, n;
+       unsigned long ordinal;
+       int stage;
+       size_t length;
+       msg >> problem >> ordinal >> stage >> n;
+
+       ublas::vector<int> pv(n);
+       for (unsigned int j = 0; j < n; j++) {
+         msg >> pv(j);
+       }
+
+       msg >> length;
+
+       string payload(length, ' ');
+       if (length > 0 && fread (&payload[0], 1, length, fin) != length) {
+         throw DSEError("Truncated task for worker process");
+       }
+
+       ProjectionSolver *solver = solvers[problem];
+
+       ProjectionSolution *ps = evaluateStage(solver,
+                                       (CandidateStages::Stage) stage,
+                                       &pv, payload);
+
+       // a finished candidate is followed by its schedule variants, found
+       // here under the limits of the worker
+       list<ProjectionSolution *> solutions;
+       if (ps) {
+         ps->candidate = ordinal;
+
+         if (stage == CandidateStages::EVALUATE ||
+               stage == CandidateStages::COUNT)
+           solutions = solver->withVariants(ps, cerr);
+         else
+           solutions.push_back(ps);
+       }
+
+       ostringstream result;
+       result << ordinal << " " << solutions.size() << "\n";
+       for (list<ProjectionSolution *>::iterator i = solutions.begin();
+            i != solutions.end(); i++) {
+         (*i)->candidate = ordinal;
+         (*i)->save(result);
+         delete *i;
+       }
+       result << "END\n";
+
+       solver->resetArena();
+
+       if (!writeAll (out, result.str()))
+         break;
+     }
+
+     fclose (fin);
+   }
+
+   //
+   // evaluate a stage of a candidate in a worker.  returns the solution, or
+   // NULL if an orientation has no schedule
+   //
+   ProjectionSolution *evaluateStage(ProjectionSolver *solver,
+                                     CandidateStages::Stage stage,
+                                     ublas::vector<int> *pv,
+                                     const string &payload)
+   {
+     istringstream saved(payload);
+     ProjectionSolution *ps = NULL;
+
+     switch (stage) {
+       case CandidateStages::EVALUATE:
+         return solver->evaluate(pv);
+
+       case CandidateStages::THROUGHPUT:
+         return solver->findThroughput(pv);
+
+       case CandidateStages::SCHEDULE:
+         // the throughput, for rank k > 1
+         ps = solver->newSolution();
+         if (!payload.empty() && !ps->load(saved)) {
+           delete ps;
+           throw DSEError("Malformed task for worker process");
+         }
+
+         for (unsigned int i = 0; i < pv->size(); i++) {
+           ps->projection_vector[i] = (*pv)(i);
+         }
+
+         try {
+           if (!solver->findScheduleOrientation(ps)) {
+             delete ps;
+             return NULL;
+           }
+         }
+         catch (...) {
+           delete ps;
+           throw;
+         }
+         return ps;
+
+       case CandidateStages::COUNT:
+         {
+           // the throughput, then the schedule
+           ProjectionSolution *schedule = solver->newSolution();
+           ps = solver->newSolution();
+
+           if (!ps->load(saved) || !schedule->load(saved)) {
+             delete ps;
+             delete schedule;
+             throw DSEError("Malformed task for worker process");
+           }
+
+           ps->assignSchedule(*schedule);
+           delete schedule;
+
+           try {
+             solver->completeSolution(ps);
+           }
+           catch (...) {
+             delete ps;
+             throw;
+           }
+           return ps;
+         }
+     }
+
+     throw DSEError("Unknown stage for worker process");
+   }
+
+   // parse a complete result from a worker
+   void parseResult(Worker &w, vector< list<ProjectionSolution *> > &results)
+   {
+     if (stages) {
+       // saved solution between the first line and END
+       size_t first = w.buffer.find('\n') + 1;
+       string saved = w.buffer.substr(first, w.buffer.size() - 4 - first);
+
+       CandidateStages::Finished done;
+       if (stages->finished(w.candidate, saved, elapsedTime(w), results,
+                            done)) {
+         record(done);
+       }
+
+       w.buffer.clear();
+       return;
+     }
+
+     istringstream msg(w.buffer);
+
+     unsigned long ordinal;
+     int count;
+     msg >> ordinal >> count;
+
+     for (int i = 0; i < count; i++) {
+       ProjectionSolution *ps = solvers[w.problem]->newSolution();
+
+       if (!ps->load(msg)) {
+         delete ps;
+         throw DSEError("Malformed result from worker process");
+       }
+
+       results[w.problem].push_back(ps);
+     }
+
+     record(w);
+
+     w.buffer.clear();
+   }
+
+   // record the candidate of worker i as failed, and replace the worker
+   void fail(unsigned int i, ProjectionSolution::Status status,
+             vector< list<ProjectionSolution *> > &results)
+   {
+     Worker &w = pool[i];
+
+     if (stages) {
+       CandidateStages::Finished done;
+       if (stages->failed(w.candidate, status, elapsedTime(w), results,
+                          done)) {
+         record(done);
+       }
+     } else {
+       ProjectionSolution *ps = solvers[w.problem]->newSolution();
+       ps->candidate = w.candidate;
+       ps->status    = status;
+       for (unsigned int j = 0; j < w.index.size(); j++) {
+         ps->projection_vector[j] = w.index[j];
+       }
+       results[w.problem].push_back(ps);
+       record(w);
+     }
+
+     close (w.tochild);
+     close (w.fromchild);
+     w.busy = false;
+
+     spawn(i);
+   }
+
+   // seconds since a worker was handed its candidate or task
+   static double elapsedTime(const Worker &w)
+   {
+     struct timeval now;
+     gettimeofday (&now, NULL);
+
+     return (now.tv_sec - w.start.tv_sec) +
+            (now.tv_usec - w.start.tv_usec) / 1e6;
+   }
+
+   // record the time taken by the candidate of a worker
+   void record(const Worker &w)
+   {
+     Timing t;
+     t.problem   = w.problem;
+     t.candidate = w.candidate;
+     t.seconds   = elapsedTime(w);
+
+     finished.push_back(t);
+   }
+
+   // record the total time of the stages of a finished candidate
+   void record(const CandidateStages::Finished &done)
+   {
+     Timing t;
+     t.problem   = done.problem;
+     t.candidate = done.ordinal;
+     t.seconds   = done.seconds;
+
+     finished.push_back(t);
+   }
+
+   // reap a worker that closed its output and classify how it died
+   ProjectionSolution::Status exitStatus(pid_t pid)
+   {
+     int status = 0;
+     waitpid (pid, &status, 0);
+
+     if (WIFSIGNALED (status))
+       return ProjectionSolution::CRASHED;
+
+     return ProjectionSolution::ERROR;
+   }
+
+   // resident memory of a process in MB
+   long residentMB(pid_t pid)
+   {
+     char path[64];
+     snprintf (path, sizeof (path), "/proc/%d/statm", (int) pid);
+
+     FILE *fp = fopen (path, "r");
+     if (!fp)
+       return 0;
+
+     long size = 0, resident = 0;
+     if (fscanf (fp, "%ld %ld", &size, &resident) != 2)
+       resident = 0;
+     fclose (fp);
+
+     return resident * (sysconf (_SC_PAGESIZE) / 1024) / 1024;
+   }
+
+   // write a whole message to a pipe
+   static bool writeAll(int fd, const string &msg)
+   {
+     const char *p = msg.data();
+     size_t left = msg.size();
+
+     while (left > 0) {
+       ssize_t n = write (fd, p, left);
+
+       if (n < 0) {
+         if (errno == EINTR)
+           continue;
+         return false;
+       }
+
+       p    += n;
+       left -= n;
+     }
+
+     return true;
+   }
+
+   // solver of each problem
+   vector< ProjectionSolver * > solvers;
+
+   // limits per candidate
+   int timeout;
+   long memorylimit;
+
+   vector<Worker> pool;
+
+   // stages of candidates, with count workers
+   CandidateStages *stages;
+
+   // COUNT tasks that may wait per count worker
+   static const unsigned int COUNT_QUEUE_PER_WORKER = 2;
+
+   // times of finished candidates not yet taken
+   vector< Timing > finished;
+
+};
+
+#endif // __WORKER_POOL_H__